@@ -128,6 +128,10 @@ InitGl(struct EglInfo *eglInfo)
 	glAttachShader(program, vert);
 	glLinkProgram(program);
 
+	/* attached shaders are only flagged for deletion, a later relink still works */
+	glDeleteShader(frag);
+	glDeleteShader(vert);
+
 	glGetProgramiv(program, GL_LINK_STATUS, &status);
 	if (!status) {
 		char log[1000];
@@ -5,6 +5,11 @@
 #include <math.h>
 #include <assert.h>
 #include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <linux/input.h>
 
@@ -26,14 +31,77 @@ static struct wl_callback *g_callback = NULL;
 static int g_width = 250;
 static int g_height = 250;
 
+/*
+ * Benchmark mode: a baseline of the driver alone, without the toolkit.
+ * Any of the options below makes it draw continuously instead of waiting
+ * for frame callbacks, then print fps, CPU time per frame and the time
+ * spent in eglSwapBuffers() after the given duration, and exit.
+ *
+ *   SimpleEgl [--duration SEC] [--warmup FRAMES] [--size WxH]
+ *             [--draws N] [--vertices N | --primitives N] [--fill N]
+ *             [--blend] [--vbo] [--swap-interval N]
+ */
+struct BenchOptions {
+	bool enabled;
+	double duration;		/* seconds measured after the warmup */
+	int warmup;				/* frames not measured */
+	int draws;				/* draw calls per frame */
+	int vertices;			/* vertices per draw, GL_TRIANGLES */
+	int fill;				/* full-screen quads per frame */
+	bool blend;
+	bool vbo;				/* buffer objects instead of client arrays */
+	int swapInterval;
+};
+
+struct BenchStats {
+	int frame;				/* including the warmup */
+	int frames;				/* measured */
+	double start;
+	double lastEnd;
+	double cpu;
+	double submit;
+	double swap;
+	double maxFrame;
+};
+
+static struct BenchOptions g_bench = {
+	false, 10.0, 60, 1, 3, 0, false, false, 1
+};
+static struct BenchStats g_stats;
+
+static struct display *g_display = NULL;
+static int g_eventFd = -1;
+static struct task g_benchTask;
+
+static GLfloat *g_meshVerts = NULL;
+static GLfloat *g_meshColors = NULL;
+static GLuint g_buffers[2] = { 0, 0 };
+
+static const GLfloat g_fillVerts[6][2] = {
+	{ -1, -1 }, {  1, -1 }, { -1,  1 },
+	{ -1,  1 }, {  1, -1 }, {  1,  1 }
+};
+static const GLfloat g_fillColors[6][4] = {
+	{ 0.2, 0.4, 0.8, 0.5 }, { 0.2, 0.4, 0.8, 0.5 }, { 0.2, 0.4, 0.8, 0.5 },
+	{ 0.2, 0.4, 0.8, 0.5 }, { 0.2, 0.4, 0.8, 0.5 }, { 0.2, 0.4, 0.8, 0.5 }
+};
+
 static void
 redraw(void *data, struct wl_callback *callback, uint32_t time);
 
+static void
+bench_start(void);
+
 static void
 configure_callback(void *data, struct wl_callback *callback, uint32_t  time)
 {
 	wl_callback_destroy(callback);
 
+	if (g_bench.enabled) {
+		bench_start();
+		return;
+	}
+
 	if (g_callback == NULL)
 		redraw(data, NULL, time);
 }
@@ -83,6 +151,293 @@ static const struct wl_callback_listener frame_listener = {
 	redraw
 };
 
+static double
+now(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* small triangles in a grid over the whole viewport, one draw streams all vertices */
+static void
+bench_create_mesh(void)
+{
+	int triangles = g_bench.vertices / 3;
+	int n = 1;
+	int i;
+
+	while (n * n < triangles)
+		n++;
+
+	g_meshVerts = malloc(sizeof(GLfloat) * 2 * triangles * 3);
+	g_meshColors = malloc(sizeof(GLfloat) * 4 * triangles * 3);
+	assert(g_meshVerts && g_meshColors);
+
+	for (i = 0; i < triangles; i++) {
+		GLfloat size = 2.0f / n;
+		GLfloat x = -1.0f + (i % n) * size;
+		GLfloat y = -1.0f + (i / n) * size;
+		GLfloat *v = &g_meshVerts[i * 6];
+		GLfloat *c = &g_meshColors[i * 12];
+		int k;
+
+		v[0] = x;			v[1] = y;
+		v[2] = x + size;	v[3] = y;
+		v[4] = x;			v[5] = y + size;
+
+		for (k = 0; k < 3; k++) {
+			c[k * 4 + 0] = (GLfloat)(i % 7) / 6.0f;
+			c[k * 4 + 1] = (GLfloat)(i % 5) / 4.0f;
+			c[k * 4 + 2] = (GLfloat)(i % 3) / 2.0f;
+			c[k * 4 + 3] = 0.5f;
+		}
+	}
+
+	if (!g_bench.vbo)
+		return;
+
+	/* vertices and colors share one buffer, the fill quad goes at the end */
+	glGenBuffers(2, g_buffers);
+
+	glBindBuffer(GL_ARRAY_BUFFER, g_buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * triangles * 3 + sizeof(g_fillVerts), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * 2 * triangles * 3, g_meshVerts);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * triangles * 3, sizeof(g_fillVerts), g_fillVerts);
+
+	glBindBuffer(GL_ARRAY_BUFFER, g_buffers[1]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * triangles * 3 + sizeof(g_fillColors), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * 4 * triangles * 3, g_meshColors);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * triangles * 3, sizeof(g_fillColors), g_fillColors);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void
+bench_destroy_mesh(void)
+{
+	if (g_buffers[0])
+		glDeleteBuffers(2, g_buffers);
+
+	free(g_meshVerts);
+	free(g_meshColors);
+}
+
+static void
+bench_bind(const void *verts, const void *colors, size_t offset)
+{
+	if (g_bench.vbo) {
+		glBindBuffer(GL_ARRAY_BUFFER, g_buffers[0]);
+		glVertexAttribPointer(eglInfo.pos, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(offset * 2 * sizeof(GLfloat)));
+		glBindBuffer(GL_ARRAY_BUFFER, g_buffers[1]);
+		glVertexAttribPointer(eglInfo.col, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(offset * 4 * sizeof(GLfloat)));
+	} else {
+		glVertexAttribPointer(eglInfo.pos, 2, GL_FLOAT, GL_FALSE, 0, verts);
+		glVertexAttribPointer(eglInfo.col, 4, GL_FLOAT, GL_FALSE, 0, colors);
+	}
+}
+
+static void
+bench_report(void)
+{
+	double elapsed = g_stats.lastEnd - g_stats.start;
+	double frames = g_stats.frames ? g_stats.frames : 1;
+	double fps = (elapsed > 0.0) ? g_stats.frames / elapsed : 0.0;
+	int triangles = g_bench.vertices / 3;
+
+	printf("SimpleEgl bench: %dx%d, %d draws x %d vertices, %d fill quads, blend %s, %s, swap interval %d\n",
+		   g_width, g_height, g_bench.draws, triangles * 3, g_bench.fill,
+		   g_bench.blend ? "on" : "off", g_bench.vbo ? "VBO" : "client arrays", g_bench.swapInterval);
+	printf("  frames      %d in %.2f s\n", g_stats.frames, elapsed);
+	printf("  fps         %.1f\n", fps);
+	printf("  frame       %.3f ms avg, %.3f ms max\n", elapsed * 1000.0 / frames, g_stats.maxFrame * 1000.0);
+	printf("  cpu         %.3f ms/frame\n", g_stats.cpu * 1000.0 / frames);
+	printf("  submit      %.3f ms/frame\n", g_stats.submit * 1000.0 / frames);
+	printf("  swap wait   %.3f ms/frame\n", g_stats.swap * 1000.0 / frames);
+	printf("  triangles   %.2f M/s\n", fps * g_bench.draws * triangles / 1e6);
+	printf("  fill        %.2f Mpixels/s\n", fps * g_bench.fill * g_width * g_height / 1e6);
+}
+
+static void
+bench_frame(void)
+{
+	static const GLfloat identity[4][4] = {
+		{ 1, 0, 0, 0 },
+		{ 0, 1, 0, 0 },
+		{ 0, 0, 1, 0 },
+		{ 0, 0, 0, 1 }
+	};
+	int triangles = g_bench.vertices / 3;
+	double start, cpuStart, submitted, end;
+	int i;
+
+	start = now(CLOCK_MONOTONIC);
+	cpuStart = now(CLOCK_PROCESS_CPUTIME_ID);
+
+	glViewport(0, 0, g_width, g_height);
+
+	glClearColor(0.0, 0.0, 0.0, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glUniformMatrix4fv(eglInfo.rotUniform, 1, GL_FALSE, (const GLfloat *) identity);
+
+	glEnableVertexAttribArray(eglInfo.pos);
+	glEnableVertexAttribArray(eglInfo.col);
+
+	if (triangles > 0) {
+		bench_bind(g_meshVerts, g_meshColors, 0);
+
+		for (i = 0; i < g_bench.draws; i++)
+			glDrawArrays(GL_TRIANGLES, 0, triangles * 3);
+	}
+
+	if (g_bench.fill > 0) {
+		bench_bind(g_fillVerts, g_fillColors, triangles * 3);
+
+		for (i = 0; i < g_bench.fill; i++)
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+	glDisableVertexAttribArray(eglInfo.pos);
+	glDisableVertexAttribArray(eglInfo.col);
+
+	submitted = now(CLOCK_MONOTONIC);
+
+	eglSwapBuffers(eglInfo.eglDpy, eglInfo.eglSurface);
+
+	end = now(CLOCK_MONOTONIC);
+
+	/* warmup frames include the driver's shader compiles and buffer allocations, not counted */
+	if (++g_stats.frame <= g_bench.warmup) {
+		g_stats.start = end;
+		g_stats.lastEnd = end;
+		return;
+	}
+
+	g_stats.frames++;
+	g_stats.cpu += now(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+	g_stats.submit += submitted - start;
+	g_stats.swap += end - submitted;
+
+	if (end - g_stats.lastEnd > g_stats.maxFrame)
+		g_stats.maxFrame = end - g_stats.lastEnd;
+	g_stats.lastEnd = end;
+
+	if (end - g_stats.start >= g_bench.duration) {
+		bench_report();
+		display_exit(g_display);
+	}
+}
+
+static void
+bench_kick(void)
+{
+	uint64_t one = 1;
+
+	if (write(g_eventFd, &one, sizeof(one)) != sizeof(one))
+		fprintf(stderr, "SimpleEgl: cannot schedule the next frame\n");
+}
+
+/* every frame writes the eventfd, so the event loop runs once before the next one */
+static void
+bench_task(struct task *task, uint32_t events)
+{
+	uint64_t count;
+
+	if (read(g_eventFd, &count, sizeof(count)) != sizeof(count))
+		return;
+
+	bench_frame();
+	bench_kick();
+}
+
+static void
+bench_start(void)
+{
+	memset(&g_stats, 0, sizeof(g_stats));
+	g_stats.start = now(CLOCK_MONOTONIC);
+	g_stats.lastEnd = g_stats.start;
+
+	eglSwapInterval(eglInfo.eglDpy, g_bench.swapInterval);
+
+	if (g_bench.blend) {
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_BLEND);
+	}
+
+	bench_create_mesh();
+
+	g_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	assert(g_eventFd >= 0);
+
+	g_benchTask.run = bench_task;
+	display_watch_fd(g_display, g_eventFd, EPOLLIN, &g_benchTask);
+
+	bench_kick();
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+		"usage: SimpleEgl [--duration SEC] [--warmup FRAMES] [--size WxH]\n"
+		"                 [--draws N] [--vertices N | --primitives N] [--fill N]\n"
+		"                 [--blend] [--vbo] [--swap-interval N]\n");
+}
+
+static bool
+parse_options(int argc, char **argv)
+{
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--blend") == 0) {
+			g_bench.blend = true;
+		} else if (strcmp(arg, "--vbo") == 0) {
+			g_bench.vbo = true;
+		} else if (!value) {
+			return false;
+		} else if (strcmp(arg, "--duration") == 0) {
+			g_bench.duration = atof(value);
+			i++;
+		} else if (strcmp(arg, "--warmup") == 0) {
+			g_bench.warmup = atoi(value);
+			i++;
+		} else if (strcmp(arg, "--size") == 0) {
+			if (sscanf(value, "%dx%d", &g_width, &g_height) != 2)
+				return false;
+			i++;
+		} else if (strcmp(arg, "--draws") == 0) {
+			g_bench.draws = atoi(value);
+			i++;
+		} else if (strcmp(arg, "--vertices") == 0) {
+			g_bench.vertices = atoi(value) / 3 * 3;
+			i++;
+		} else if (strcmp(arg, "--primitives") == 0) {
+			g_bench.vertices = atoi(value) * 3;
+			i++;
+		} else if (strcmp(arg, "--fill") == 0) {
+			g_bench.fill = atoi(value);
+			i++;
+		} else if (strcmp(arg, "--swap-interval") == 0) {
+			g_bench.swapInterval = atoi(value);
+			i++;
+		} else {
+			return false;
+		}
+
+		g_bench.enabled = true;
+	}
+
+	return (g_width > 0) && (g_height > 0) && (g_bench.duration > 0.0) &&
+		(g_bench.draws >= 0) && (g_bench.vertices >= 0) && (g_bench.fill >= 0);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -93,6 +448,15 @@ main(int argc, char **argv)
 	display = display_create(&argc, argv);
 	assert(display);
 
+	/* display_create() removes its own options from argv */
+	if (!parse_options(argc, argv)) {
+		usage();
+		display_destroy(display);
+		return 1;
+	}
+
+	g_display = display;
+
 	window = window_create(display);
 	window_set_user_data(window, window);
 
@@ -102,10 +466,17 @@ main(int argc, char **argv)
 	create_surface(window);
 	InitGl(&eglInfo);
 
-	window_schedule_resize(window, 250, 250);
+	window_schedule_resize(window, g_width, g_height);
 
 	display_run(display);
 
+	if (g_bench.enabled) {
+		display_unwatch_fd(display, g_eventFd);
+		close(g_eventFd);
+
+		bench_destroy_mesh();
+	}
+
 	DestroySurface(&eglInfo);
 
 	widget_destroy(widget);
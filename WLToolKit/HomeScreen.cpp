@@ -1,15 +1,39 @@
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <cairo.h>
+}
+
 #include "Source/WLToolKit.hpp"
 #include "HomeScreen.hpp"
 
-#define NUM_ICONS	4
+#define NUM_APPS	200
+
+#define GRID_X			20
+#define GRID_Y			80
+#define GRID_WIDTH		(WINDOW_WIDTH - GRID_X * 2)
+#define GRID_HEIGHT		(WINDOW_HEIGHT - GRID_Y)
+#define CELL_WIDTH		190
+#define CELL_HEIGHT		150
+
+#define LABEL_FONT		"sans-serif"
+#define LABEL_SIZE		16
+#define LABEL_SPACING	6
+#define LABEL_COLOR		0xffffffff
+
+#define CLOCK_WIDTH		160
+#define CLOCK_HEIGHT	40
 
 using namespace WLToolKit;
 
 class Background;
-class Icon;
+class StatusClock;
+class AppList;
 
 class MyWindow : public WindowEGL {
 public:
@@ -17,15 +41,29 @@ public:
 	virtual ~MyWindow();
 
 	virtual void Render();
+	virtual void OnResize(int width, int height);
 
 	virtual void OnClick(uint32_t button, int x, int y);
+	virtual void OnRelease(uint32_t button, int x, int y);
+	virtual void OnPointerMotion(int x, int y);
 	virtual void OnTouchDown(int x, int y);
+	virtual void OnTouchMotion(int x, int y);
+	virtual void OnTouchUp();
+
+	TextRenderer *GetTextRenderer() { return m_text; }
+	Font *GetLabelFont() { return m_labelFont; }
 
 protected:
 	Display *m_display;
 
+	Font *m_labelFont;
+	TextRenderer *m_text;
+
 	Background *m_bg;
-	Icon *m_icons[NUM_ICONS];
+	StatusClock *m_clock;
+
+	AppList *m_apps;
+	GridView *m_grid;
 };
 
 /* ------------------------------------
@@ -37,6 +75,9 @@ public:
 	Background(MyWindow *window)
 	: m_window(window) {
 		m_texture = new Texture("bg.png");
+
+		/** covers the whole window and is the bottom layer, nothing to blend with */
+		m_texture->SetOpaque(true);
 	}
 
 	virtual ~Background() {
@@ -52,6 +93,65 @@ protected:
 	Texture *m_texture;
 };
 
+/* ------------------------------------
+	StatusClock
+-------------------------------------*/
+
+class StatusClock {
+public:
+	StatusClock(MyWindow *window, int x, int y)
+	: m_window(window), m_x(x), m_y(y), m_lastTime(0) {
+		m_texture = new DynamicTexture(CLOCK_WIDTH, CLOCK_HEIGHT);
+	}
+
+	virtual ~StatusClock() {
+		delete m_texture;
+	}
+
+	virtual void Draw() {
+		time_t now = time(NULL);
+
+		/** repaint once a second, only the clock area is uploaded again */
+		if (now != m_lastTime) {
+			char text[16];
+			struct tm tm;
+
+			localtime_r(&now, &tm);
+			strftime(text, sizeof(text), "%H:%M:%S", &tm);
+
+			cairo_t *cr = m_texture->BeginPaint();
+
+			cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+			cairo_paint(cr);
+			cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+			cairo_select_font_face(cr, LABEL_FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+			cairo_set_font_size(cr, CLOCK_HEIGHT * 0.7);
+			cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 1.0);
+			cairo_move_to(cr, 4, CLOCK_HEIGHT * 0.8);
+			cairo_show_text(cr, text);
+
+			m_texture->EndPaint(cr);
+
+			m_lastTime = now;
+		}
+
+		m_texture->Draw(m_window, m_x, m_y);
+	}
+
+	void Move(int x, int y) {
+		m_x = x;
+		m_y = y;
+	}
+
+protected:
+	MyWindow *m_window;
+	int m_x, m_y;
+	time_t m_lastTime;
+
+	DynamicTexture *m_texture;
+};
+
 /* ------------------------------------
 	Animation
 -------------------------------------*/
@@ -106,52 +206,118 @@ protected:
 };
 
 /* ------------------------------------
-	Icon
+	AppCell
 -------------------------------------*/
 
-class Icon {
+class AppCell : public GridCell {
 public:
-	Icon(MyWindow *window, const char *iconPath, int x, int y)
-	: m_window(window), m_x(x), m_y(y), m_bSelected(false) {
-		m_texture = new Texture(iconPath);
-		m_width = m_texture->GetWidth();
-		m_height = m_texture->GetHeight();
+	AppCell(MyWindow *window, AppList *apps)
+	: m_window(window), m_apps(apps), m_index(-1) {
+		m_texture = new Texture();
 	}
 
-	virtual ~Icon() {
+	virtual ~AppCell() {
 		delete m_texture;
 	}
 
-	virtual void Draw() {
-		if (m_bSelected) {
-			m_texture->Draw(m_window, m_x, m_y, 1.3);
+	virtual void Bind(int index);
+
+	virtual void Unbind() {
+		m_index = -1;
+	}
+
+	virtual void Draw(WindowEGL *window, int x, int y, int width, int height);
+
+protected:
+	MyWindow *m_window;
+	AppList *m_apps;
+	int m_index;
+
+	/** kept across binds, only reloaded when the icon path changes */
+	std::string m_iconPath;
+	Texture *m_texture;
+};
+
+/* ------------------------------------
+	AppList
+-------------------------------------*/
+
+class AppList : public GridDataSource {
+public:
+	AppList(MyWindow *window)
+	: m_window(window), m_selected(-1) {
+		char label[32];
+
+		for (int i = 0; i < NUM_APPS; i++) {
+			snprintf(label, sizeof(label), "App %d", i + 1);
+
+			m_labels.push_back(label);
+			m_iconPaths.push_back("icon.png");
 		}
-		else
-			m_texture->Draw(m_window, m_x, m_y);
 	}
 
-	virtual void OnClick(int x, int y) {
-		if (((m_x <= x) && (x <= (m_x + m_width))) && 
-			((m_y <= y) && (y <= (m_y + m_height)))) {
+	virtual ~AppList() {
+	}
+
+	virtual int GetItemCount() {
+		return (int)m_labels.size();
+	}
+
+	virtual GridCell* CreateCell() {
+		return new AppCell(m_window, this);
+	}
+
+	virtual void OnItemSelected(int index) {
 #if 1
-			fprintf(stderr, "Icon: Clicked\n");
+		fprintf(stderr, "Icon: Clicked: %s\n", GetLabel(index));
 #endif
 
-			m_bSelected = true;
-		} else {
-			m_bSelected = false;
-		}
+		m_selected = index;
+	}
+
+	virtual void OnFlush() {
+		m_window->GetTextRenderer()->Flush();
 	}
 
+	const char *GetLabel(int index) { return m_labels[index].c_str(); }
+	const char *GetIconPath(int index) { return m_iconPaths[index].c_str(); }
+	int GetSelected() { return m_selected; }
+
 protected:
 	MyWindow *m_window;
-	int m_x, m_y;
-	int m_width, m_height;
-	bool m_bSelected;
+	int m_selected;
 
-	Texture *m_texture;
+	std::vector<std::string> m_labels;
+	std::vector<std::string> m_iconPaths;
 };
 
+void
+AppCell::Bind(int index)
+{
+	m_index = index;
+
+	const char *path = m_apps->GetIconPath(index);
+	if (m_iconPath != path) {
+		m_texture->Load(path);
+		m_iconPath = path;
+	}
+}
+
+void
+AppCell::Draw(WindowEGL *window, int x, int y, int width, int height)
+{
+	int iconX = x + (width - m_texture->GetWidth()) / 2;
+
+	if (m_apps->GetSelected() == m_index)
+		m_texture->Draw(window, iconX, y, 1.3);
+	else
+		m_texture->Draw(window, iconX, y);
+
+	/** queued, flushed with the other labels while the grid clip is set */
+	m_window->GetTextRenderer()->DrawTextCentered(m_window->GetLabelFont(), m_apps->GetLabel(m_index),
+		x + width / 2, y + m_texture->GetHeight() + LABEL_SPACING, LABEL_COLOR);
+}
+
 /* ------------------------------------
 	HomeScreen
 -------------------------------------*/
@@ -163,6 +329,9 @@ struct HomeScreenImpl {
 
 HomeScreen::HomeScreen(struct display* display)
 {
+	StartupTrace::Start();
+	StartupTrace::Scope scope("HomeScreen");
+
 	m_pImpl = new HomeScreenImpl;
 
 	m_pImpl->display = new Display(display);
@@ -180,31 +349,45 @@ HomeScreen::~HomeScreen()
 -------------------------------------*/
 
 MyWindow::MyWindow(Display* display, int width, int height)
-: WindowEGL(display, width, height)
+: WindowEGL(display, width, height, true)
 {
+	StartupTrace::Scope scope("MyWindow content");
+
+	m_labelFont = new Font(LABEL_FONT, LABEL_SIZE);
+	m_text = new TextRenderer(this);
+
 	m_bg = new Background(this);
+	m_clock = new StatusClock(this, WINDOW_WIDTH - CLOCK_WIDTH - 20, 20);
+
+	m_apps = new AppList(this);
 
-	m_icons[0] = new Icon(this, "icon.png", 60, 180);
-	m_icons[1] = new Icon(this, "icon.png", 240, 180);
-	m_icons[2] = new Icon(this, "icon.png", 420, 180);
-	m_icons[3] = new Icon(this, "icon.png", 610, 180);
+	/** only the rows on screen (and one either side) hold cells and textures */
+	m_grid = new GridView(this, GRID_X, GRID_Y, GRID_WIDTH, GRID_HEIGHT);
+	m_grid->SetCellSize(CELL_WIDTH, CELL_HEIGHT);
+	m_grid->SetPrefetchRows(1);
+	m_grid->SetDataSource(m_apps);
 }
 
 MyWindow::~MyWindow()
 {
-	for (int i = 0; i < NUM_ICONS; i++) {
-		delete m_icons[i];
-	}
+	delete m_grid;
+	delete m_apps;
+	delete m_clock;
 	delete m_bg;
+
+	delete m_text;
+	delete m_labelFont;
 }
 
 void
 MyWindow::Render()
 {
 	m_bg->Draw();
+	m_clock->Draw();
+
+	m_grid->Draw();
 
-	for (int i = 0; i < NUM_ICONS; i++)
-		m_icons[i]->Draw();
+	m_text->Flush();
 }
 
 void
@@ -214,8 +397,19 @@ MyWindow::OnClick(uint32_t button, int x, int y)
 	fprintf(stderr, "HomeScreen: OnClick: (%f, %f)\n", x, y);
 #endif
 
-	for (int i = 0; i < NUM_ICONS; i++)
-		m_icons[i]->OnClick(x, y);
+	m_grid->OnPress(x, y);
+}
+
+void
+MyWindow::OnRelease(uint32_t button, int x, int y)
+{
+	m_grid->OnRelease();
+}
+
+void
+MyWindow::OnPointerMotion(int x, int y)
+{
+	m_grid->OnMotion(x, y);
 }
 
 void
@@ -225,7 +419,26 @@ MyWindow::OnTouchDown(int x, int y)
 	fprintf(stderr, "HomeScreen: OnTouchDown: (%f, %f)\n", x, y);
 #endif
 
-	for (int i = 0; i < NUM_ICONS; i++)
-		m_icons[i]->OnClick(x, y);
+	m_grid->OnPress(x, y);
+}
+
+void
+MyWindow::OnTouchMotion(int x, int y)
+{
+	m_grid->OnMotion(x, y);
+}
+
+void
+MyWindow::OnTouchUp()
+{
+	m_grid->OnRelease();
+}
+
+void
+MyWindow::OnResize(int width, int height)
+{
+	/** same margins as at WINDOW_WIDTH x WINDOW_HEIGHT */
+	m_clock->Move(width - CLOCK_WIDTH - 20, 20);
+	m_grid->SetGeometry(GRID_X, GRID_Y, width - GRID_X * 2, height - GRID_Y);
 }
 
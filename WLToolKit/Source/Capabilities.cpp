@@ -0,0 +1,296 @@
+#include "Common.hpp"
+#include "Capabilities.hpp"
+
+namespace WLToolKit {
+
+const Capabilities* Capabilities::s_current = NULL;
+
+static const char* s_names[Capabilities::kNumCapabilities] = {
+	"gles3",
+	"npot",
+	"bgra8888",
+	"unpack_subimage",
+	"etc1",
+	"etc2",
+	"program_binary",
+	"debug",
+	"read_bgra",
+	"create_context",
+	"buffer_age",
+	"swap_with_damage",
+	"surfaceless_context",
+	"platform_surfaceless"
+};
+
+struct Extension {
+	const char* name;
+	Capabilities::Capability capability;
+	const char* proc;		/** resolved when the extension is found, NULL for none */
+};
+
+static const Extension s_clientExtensions[] = {
+	{ "EGL_MESA_platform_surfaceless",		Capabilities::kPlatformSurfaceless,	NULL }
+};
+
+static const Extension s_eglExtensions[] = {
+	{ "EGL_KHR_surfaceless_context",		Capabilities::kSurfacelessContext,	NULL },
+	{ "EGL_KHR_create_context",				Capabilities::kCreateContext,	NULL },
+	{ "EGL_EXT_buffer_age",					Capabilities::kBufferAge,		NULL },
+	{ "EGL_KHR_swap_buffers_with_damage",	Capabilities::kSwapWithDamage,	"eglSwapBuffersWithDamageKHR" },
+	{ "EGL_EXT_swap_buffers_with_damage",	Capabilities::kSwapWithDamage,	"eglSwapBuffersWithDamageEXT" }
+};
+
+static const Extension s_glExtensions[] = {
+	{ "GL_OES_texture_npot",					Capabilities::kNPOT,			NULL },
+	{ "GL_EXT_texture_format_BGRA8888",			Capabilities::kBGRA8888,		NULL },
+	{ "GL_EXT_unpack_subimage",					Capabilities::kUnpackSubimage,	NULL },
+	{ "GL_OES_compressed_ETC1_RGB8_texture",	Capabilities::kETC1,			NULL },
+	{ "GL_OES_get_program_binary",				Capabilities::kProgramBinary,	"glGetProgramBinaryOES" },
+	{ "GL_KHR_debug",							Capabilities::kDebug,			"glDebugMessageCallbackKHR" },
+	{ "GL_EXT_read_format_bgra",				Capabilities::kReadBGRA,		NULL }
+};
+
+#define NUM_ELEMENTS(a)	(sizeof(a) / sizeof((a)[0]))
+
+/**
+ * One pass over a space separated extension string, each token is looked up
+ * in table. Returns the capabilities found, procs[capability] gets the entry
+ * point of the first matching extension that has one.
+ */
+static uint32_t
+ParseExtensions(const char* extensions, const Extension* table, size_t count, void** procs)
+{
+	uint32_t bits = 0;
+
+	if (!extensions)
+		return 0;
+
+	const char* p = extensions;
+
+	while (*p) {
+		while (*p == ' ')
+			p++;
+
+		const char* end = p;
+		while (*end && (*end != ' '))
+			end++;
+
+		size_t length = end - p;
+
+		for (size_t i = 0; i < count; i++) {
+			if ((strlen(table[i].name) != length) || (strncmp(table[i].name, p, length) != 0))
+				continue;
+
+			bits |= 1u << table[i].capability;
+
+			if (table[i].proc && !procs[table[i].capability])
+				procs[table[i].capability] = (void*)eglGetProcAddress(table[i].proc);
+		}
+
+		p = end;
+	}
+
+	return bits;
+}
+
+static bool
+IsVerbose()
+{
+	const char* env = getenv("WLTK_CAPS");
+
+	return env && (env[0] != '\0') && (env[0] != '0');
+}
+
+Capabilities::Capabilities()
+: m_bits(0), m_disabled(0), m_bGLProbed(false), m_maxTextureSize(0),
+  m_getPlatformDisplay(NULL), m_swapBuffersWithDamage(NULL), m_getProgramBinary(NULL), m_programBinary(NULL), m_debugMessageCallback(NULL)
+{
+	ParseDisabled();
+}
+
+Capabilities::~Capabilities()
+{
+	/** the Display owning this is going away, textures released later must not read it */
+	if (s_current == this)
+		s_current = NULL;
+}
+
+void
+Capabilities::ParseDisabled()
+{
+	const char* gles = getenv("WLTK_GLES");
+	if (gles && (atoi(gles) == 2))
+		m_disabled |= 1u << kGLES3;
+
+	const char* env = getenv("WLTK_CAPS_DISABLE");
+	if (!env)
+		return;
+
+	const char* p = env;
+
+	while (*p) {
+		const char* end = p;
+		while (*end && (*end != ','))
+			end++;
+
+		size_t length = end - p;
+
+		bool bFound = (length == 0);
+
+		/** every fast path; a headless Display cannot do without its platform */
+		if ((length == 3) && (strncmp(p, "all", 3) == 0)) {
+			m_disabled |= ~(1u << kPlatformSurfaceless);
+			bFound = true;
+		}
+
+		for (int i = 0; i < kNumCapabilities; i++) {
+			if ((strlen(s_names[i]) == length) && (strncmp(s_names[i], p, length) == 0)) {
+				m_disabled |= 1u << i;
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+			fprintf(stderr, "[WLToolKit] ERR: unknown capability '%.*s' in WLTK_CAPS_DISABLE\n", (int)length, p);
+
+		p = (*end == ',') ? end + 1 : end;
+	}
+}
+
+void
+Capabilities::Set(Capability capability, bool bSupported)
+{
+	if (bSupported && !IsDisabled(capability))
+		m_bits |= 1u << capability;
+	else
+		m_bits &= ~(1u << capability);
+}
+
+void
+Capabilities::ProbeClient()
+{
+	void* procs[kNumCapabilities];
+	memset(procs, 0, sizeof(procs));
+
+	/** NULL without EGL_EXT_client_extensions */
+	uint32_t found = ParseExtensions(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS),
+		s_clientExtensions, NUM_ELEMENTS(s_clientExtensions), procs);
+
+	if (found & (1u << kPlatformSurfaceless))
+		m_getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	Set(kPlatformSurfaceless, m_getPlatformDisplay != NULL);
+	if (!Has(kPlatformSurfaceless))
+		m_getPlatformDisplay = NULL;
+}
+
+void
+Capabilities::ProbeEGL(EGLDisplay dpy)
+{
+	void* procs[kNumCapabilities];
+	memset(procs, 0, sizeof(procs));
+
+	uint32_t found = ParseExtensions(eglQueryString(dpy, EGL_EXTENSIONS),
+		s_eglExtensions, NUM_ELEMENTS(s_eglExtensions), procs);
+
+	m_swapBuffersWithDamage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)procs[kSwapWithDamage];
+
+	Set(kSurfacelessContext, (found & (1u << kSurfacelessContext)) != 0);
+	Set(kCreateContext, (found & (1u << kCreateContext)) != 0);
+	Set(kBufferAge, (found & (1u << kBufferAge)) != 0);
+	Set(kSwapWithDamage, m_swapBuffersWithDamage != NULL);
+
+	if (!Has(kSwapWithDamage))
+		m_swapBuffersWithDamage = NULL;
+
+	if (IsVerbose())
+		Dump(stderr);
+}
+
+void
+Capabilities::ProbeGL()
+{
+	if (m_bGLProbed)
+		return;
+
+	m_bGLProbed = true;
+
+	void* procs[kNumCapabilities];
+	memset(procs, 0, sizeof(procs));
+
+	uint32_t found = ParseExtensions((const char*)glGetString(GL_EXTENSIONS),
+		s_glExtensions, NUM_ELEMENTS(s_glExtensions), procs);
+
+	/** "OpenGL ES N.M ..." */
+	const char* version = (const char*)glGetString(GL_VERSION);
+	bool bGLES3 = version && (strncmp(version, "OpenGL ES ", 10) == 0) && (version[10] >= '3');
+
+	Set(kGLES3, bGLES3);
+
+	/** core in ES3 */
+	Set(kNPOT, bGLES3 || (found & (1u << kNPOT)));
+	Set(kUnpackSubimage, bGLES3 || (found & (1u << kUnpackSubimage)));
+	Set(kETC2, bGLES3);
+
+	Set(kBGRA8888, (found & (1u << kBGRA8888)) != 0);
+	Set(kETC1, (found & (1u << kETC1)) != 0);
+	Set(kReadBGRA, (found & (1u << kReadBGRA)) != 0);
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTextureSize);
+
+	m_getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)procs[kProgramBinary];
+	m_programBinary = m_getProgramBinary ? (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES") : NULL;
+	Set(kProgramBinary, m_getProgramBinary && m_programBinary);
+	if (!Has(kProgramBinary)) {
+		m_getProgramBinary = NULL;
+		m_programBinary = NULL;
+	}
+
+	m_debugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKKHRPROC)procs[kDebug];
+	Set(kDebug, m_debugMessageCallback != NULL);
+	if (!Has(kDebug))
+		m_debugMessageCallback = NULL;
+
+	s_current = this;
+
+	if (IsVerbose())
+		Dump(stderr);
+}
+
+const char*
+Capabilities::GetName(Capability capability)
+{
+	if ((capability < 0) || (capability >= kNumCapabilities))
+		return "unknown";
+
+	return s_names[capability];
+}
+
+void
+Capabilities::Dump(FILE* fp) const
+{
+	fprintf(fp, "[WLToolKit] capabilities:");
+
+	for (int i = 0; i < kNumCapabilities; i++) {
+		if (Has((Capability)i))
+			fprintf(fp, " %s", s_names[i]);
+	}
+
+	if (m_disabled) {
+		fprintf(fp, " (disabled:");
+
+		for (int i = 0; i < kNumCapabilities; i++) {
+			if (IsDisabled((Capability)i))
+				fprintf(fp, " %s", s_names[i]);
+		}
+
+		fprintf(fp, ")");
+	}
+
+	if (m_bGLProbed)
+		fprintf(fp, " max_texture_size=%d", m_maxTextureSize);
+
+	fprintf(fp, "\n");
+}
+
+} // End-of-namespace WLToolKit
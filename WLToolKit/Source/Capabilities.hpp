@@ -0,0 +1,121 @@
+#ifndef WL_TOOLKIT_CAPABILITIES_HPP
+#define WL_TOOLKIT_CAPABILITIES_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+
+extern "C" {
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+}
+
+namespace WLToolKit {
+
+/**
+ * EGL and GL features probed once per Display.
+ *
+ * The extension strings are parsed into a bitset and the entry points are
+ * resolved with eglGetProcAddress at probe time, so code choosing between a
+ * fast path and a fallback only tests a bit. The EGL half is probed when the
+ * Display initializes EGL, the GL half with the first current context.
+ *
+ * WLTK_CAPS_DISABLE takes a comma separated list of names (see GetName()),
+ * or "all" (everything but the headless platform), and clears them whatever
+ * the driver says, for A/B runs.
+ * WLTK_GLES=2 is the same as disabling "gles3". WLTK_CAPS=1 prints the
+ * result of each probe.
+ */
+class Capabilities {
+public:
+	enum Capability {
+		/** GL */
+		kGLES3,				/** the context is OpenGL ES 3.0 or later */
+		kNPOT,				/** full non power of two textures, mipmaps and repeat */
+		kBGRA8888,			/** GL_BGRA_EXT textures, cairo's byte order */
+		kUnpackSubimage,	/** GL_UNPACK_ROW_LENGTH, uploads straight from a strided image */
+		kETC1,
+		kETC2,
+		kProgramBinary,
+		kDebug,				/** KHR_debug message callback */
+		kReadBGRA,			/** glReadPixels() into GL_BGRA_EXT */
+
+		/** EGL */
+		kCreateContext,		/** EGL_KHR_create_context, debug contexts */
+		kBufferAge,
+		kSwapWithDamage,
+		kSurfacelessContext,	/** eglMakeCurrent() without a surface */
+		kPlatformSurfaceless,	/** client extension: an EGLDisplay without any window system */
+
+		kNumCapabilities
+	};
+
+	Capabilities();
+
+	/** Stops being GetCurrent() */
+	~Capabilities();
+
+	/** Client extensions, before there is an EGLDisplay; headless Displays need them */
+	void ProbeClient();
+
+	/** eglInitialize() was called on dpy */
+	void ProbeEGL(EGLDisplay dpy);
+
+	/** Needs a current context; only the first call probes */
+	void ProbeGL();
+
+	bool IsGLProbed() const { return m_bGLProbed; }
+
+	bool Has(Capability capability) const {
+		return (m_bits & (1u << capability)) != 0;
+	}
+
+	/** Disabled by the environment, tested before a capability is even tried */
+	bool IsDisabled(Capability capability) const {
+		return (m_disabled & (1u << capability)) != 0;
+	}
+
+	static const char* GetName(Capability capability);
+
+	/** GL_MAX_TEXTURE_SIZE, 0 until ProbeGL() */
+	int GetMaxTextureSize() const { return m_maxTextureSize; }
+
+	void Dump(FILE* fp) const;
+
+	/** NULL unless the matching capability is set */
+	PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay() const { return m_getPlatformDisplay; }
+	PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC GetSwapBuffersWithDamage() const { return m_swapBuffersWithDamage; }
+	PFNGLGETPROGRAMBINARYOESPROC GetProgramBinary() const { return m_getProgramBinary; }
+	PFNGLPROGRAMBINARYOESPROC GetProgramBinaryLoader() const { return m_programBinary; }
+	PFNGLDEBUGMESSAGECALLBACKKHRPROC GetDebugMessageCallback() const { return m_debugMessageCallback; }
+
+	/**
+	 * The capabilities of the Display that probed GL last, for code that
+	 * has no window at hand (textures). NULL before any context exists,
+	 * and again once that Display is destroyed.
+	 */
+	static const Capabilities* GetCurrent() { return s_current; }
+
+protected:
+	void Set(Capability capability, bool bSupported);
+	void ParseDisabled();
+
+protected:
+	uint32_t m_bits;
+	uint32_t m_disabled;
+	bool m_bGLProbed;
+	GLint m_maxTextureSize;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC m_getPlatformDisplay;
+	PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC m_swapBuffersWithDamage;
+	PFNGLGETPROGRAMBINARYOESPROC m_getProgramBinary;
+	PFNGLPROGRAMBINARYOESPROC m_programBinary;
+	PFNGLDEBUGMESSAGECALLBACKKHRPROC m_debugMessageCallback;
+
+	static const Capabilities* s_current;
+}; // End-of-class Capabilities
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_CAPABILITIES_HPP */
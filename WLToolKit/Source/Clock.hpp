@@ -0,0 +1,31 @@
+#ifndef WL_TOOLKIT_CLOCK_HPP
+#define WL_TOOLKIT_CLOCK_HPP
+
+#include <stdint.h>
+#include <time.h>
+
+namespace WLToolKit {
+
+namespace Clock {
+
+/** CLOCK_MONOTONIC in nanoseconds */
+static inline uint64_t
+NowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t
+NowUs()
+{
+	return NowNs() / 1000ULL;
+}
+
+} // End-of-namespace Clock
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_CLOCK_HPP */
@@ -12,8 +12,17 @@ extern "C" {
 #include <wayland-client.h>
 #include <wayland-egl.h>
 
+/** generated by wayland-scanner, see Makefile.am */
+#include "presentation-time-client-protocol.h"
+
 /** OpenGL ES 2.0 */
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+/** OpenGL ES 3.0, only used when the context turns out to support it */
+#if defined(WLTK_HAVE_GLES3)
+#include <GLES3/gl3.h>
+#endif
 
 /** EGL */
 #include <EGL/egl.h>
@@ -26,4 +35,7 @@ extern "C" {
 #include "window.h"
 }
 
+/** GL call tracing, a no-op unless built with WLTK_ENABLE_GL_TRACE */
+#include "GLTraceWrap.hpp"
+
 #endif /* WL_TOOLKIT_COMMON_HPP */
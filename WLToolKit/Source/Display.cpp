@@ -1,38 +1,187 @@
+#include <time.h>
+
 #include "Common.hpp"
 #include "Display.hpp"
+#include "Resampler.hpp"
+#include "ResourceRegistry.hpp"
 
 namespace WLToolKit {
 
+static void _GlobalHandler(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version);
+static void _GlobalRemoveHandler(void* data, struct wl_registry* registry, uint32_t name);
+static void _ClockIdHandler(void* data, struct wp_presentation* presentation, uint32_t clockId);
+
+static const struct wl_registry_listener registryListener = {
+	_GlobalHandler,
+	_GlobalRemoveHandler
+};
+
+static const struct wp_presentation_listener presentationListener = {
+	_ClockIdHandler
+};
+
 Display::Display(struct display* display)
-: m_display(display), m_isOwner(false)
+: m_display(display), m_isOwner(false), m_eglDisplay(EGL_NO_DISPLAY), m_bEGLInitialized(false)
 {
 	assert(m_display);
+
+	InitRegistry();
 }
 
 Display::Display(int* argc, char** argv)
-: m_isOwner(true)
+: m_isOwner(true), m_eglDisplay(EGL_NO_DISPLAY), m_bEGLInitialized(false)
 {
 	m_display = display_create(argc, argv);
 	assert(m_display);
+
+	InitRegistry();
+}
+
+Display::Display()
+: m_display(NULL), m_isOwner(false), m_registry(NULL), m_presentation(NULL), m_presentationClock(CLOCK_MONOTONIC),
+  m_eglDisplay(EGL_NO_DISPLAY), m_bEGLInitialized(false)
+{
 }
 
 Display::~Display()
 {
+	if (m_bEGLInitialized) {
+		eglTerminate(m_eglDisplay);
+		eglReleaseThread();
+	}
+
+	if (m_presentation)
+		wp_presentation_destroy(m_presentation);
+	if (m_registry)
+		wl_registry_destroy(m_registry);
+
 	if (m_isOwner)
 		display_destroy(m_display);
+
+	/** windows and textures are gone by now, whatever is still registered leaked */
+	ResampleCache::Clear();
+	ResourceRegistry::OnTeardown();
+}
+
+void
+Display::InitRegistry()
+{
+	m_presentation = NULL;
+	m_presentationClock = CLOCK_MONOTONIC;
+
+	/** the globals arrive with the next dispatch, no roundtrip here */
+	m_registry = wl_display_get_registry(GetWlDisplay());
+	wl_registry_add_listener(m_registry, &registryListener, this);
+}
+
+EGLDisplay
+Display::GetEGLDisplay()
+{
+	if (!m_bEGLInitialized && !InitEGL())
+		return EGL_NO_DISPLAY;
+
+	return m_eglDisplay;
+}
+
+bool
+Display::InitEGL()
+{
+	EGLint major, minor;
+
+	if (IsHeadless()) {
+		m_capabilities.ProbeClient();
+
+		/** without the platform the default display is tried, pbuffers stand in for windows */
+		if (m_capabilities.Has(Capabilities::kPlatformSurfaceless))
+			m_eglDisplay = m_capabilities.GetPlatformDisplay()(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		else
+			m_eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	} else {
+		m_eglDisplay = eglGetDisplay((EGLNativeDisplayType)GetWlDisplay());
+	}
+
+	if (m_eglDisplay == EGL_NO_DISPLAY) {
+		fprintf(stderr, "[WLToolKit] ERR: eglGetDisplay failed\n");
+		return false;
+	}
+
+	if (eglInitialize(m_eglDisplay, &major, &minor) != EGL_TRUE) {
+		fprintf(stderr, "[WLToolKit] ERR: eglInitialize failed\n");
+		m_eglDisplay = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	m_bEGLInitialized = true;
+
+	if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
+		fprintf(stderr, "[WLToolKit] ERR: eglBindAPI failed\n");
+		return false;
+	}
+
+	m_capabilities.ProbeEGL(m_eglDisplay);
+
+	return true;
+}
+
+void
+Display::OnGlobal(struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version)
+{
+	if (strcmp(interface, "wp_presentation") == 0) {
+		m_presentation = (struct wp_presentation*)wl_registry_bind(registry, name, &wp_presentation_interface, 1);
+		wp_presentation_add_listener(m_presentation, &presentationListener, this);
+	}
+}
+
+void
+Display::OnPresentationClock(uint32_t clockId)
+{
+	m_presentationClock = clockId;
 }
 
 void
 Display::Run()
 {
+	/** a headless Display has no events, its windows draw when asked to */
 	if (m_isOwner)
 		display_run(m_display);
 }
 
+void
+Display::Exit()
+{
+	if (m_display)
+		display_exit(m_display);
+}
+
 struct wl_display*
 Display::GetWlDisplay()
 {
-	return display_get_display(m_display);
+	return m_display ? display_get_display(m_display) : NULL;
+}
+
+static void
+_GlobalHandler(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version)
+{
+	if (data) {
+		Display* self = (Display*)data;
+
+		self->OnGlobal(registry, name, interface, version);
+	}
+}
+
+static void
+_GlobalRemoveHandler(void* data, struct wl_registry* registry, uint32_t name)
+{
+}
+
+static void
+_ClockIdHandler(void* data, struct wp_presentation* presentation, uint32_t clockId)
+{
+	if (data) {
+		Display* self = (Display*)data;
+
+		self->OnPresentationClock(clockId);
+	}
 }
 
 } // End-of-namespace WLToolKit
@@ -1,8 +1,14 @@
 #ifndef WL_TOOLKIT_DISPLAY_HPP
 #define WL_TOOLKIT_DISPLAY_HPP
 
+#include <stdint.h>
+
+#include "Capabilities.hpp"
+
 struct display;
 struct wl_display;
+struct wl_registry;
+struct wp_presentation;
 
 namespace WLToolKit {
 
@@ -10,16 +16,61 @@ class Display {
 public:
 	Display(struct display* display);
 	Display(int* argc, char** argv);
+
+	/**
+	 * Headless: no compositor connection at all. EGL comes from the Mesa
+	 * surfaceless platform, or the default display with pbuffers, and every
+	 * WindowEGL renders offscreen, see WindowEGL::RenderFrame().
+	 */
+	Display();
+
 	virtual ~Display();
 
+	bool IsHeadless() { return m_display == NULL; }
+
 	void Run();
+	void Exit();
 
+	/** NULL when headless */
 	struct display* GetDisplay() { return m_display; }
 	struct wl_display* GetWlDisplay();
 
+	/** NULL until the compositor advertised wp_presentation */
+	struct wp_presentation* GetPresentation() { return m_presentation; }
+	uint32_t GetPresentationClock() { return m_presentationClock; }
+
+	/**
+	 * Initialized by the first call, shared by every window and terminated
+	 * with the Display. EGL_NO_DISPLAY when EGL is not usable.
+	 */
+	EGLDisplay GetEGLDisplay();
+
+	/** EGL half probed by GetEGLDisplay(), GL half by the first WindowEGL */
+	Capabilities& GetCapabilities() { return m_capabilities; }
+
+	/** Used by the registry and wp_presentation listeners */
+	void OnGlobal(struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version);
+	void OnPresentationClock(uint32_t clockId);
+
+protected:
+	void InitRegistry();
+	bool InitEGL();
+
 protected:
 	struct display *m_display;
 	bool m_isOwner;
+
+	/**
+	 * A registry of our own; toytoolkit has a single global handler and the
+	 * desktop-shell integration already owns it.
+	 */
+	struct wl_registry *m_registry;
+	struct wp_presentation *m_presentation;
+	uint32_t m_presentationClock;
+
+	EGLDisplay m_eglDisplay;
+	bool m_bEGLInitialized;
+	Capabilities m_capabilities;
 }; // End-of-class Display
 
 } // End-of-namespace WLToolKit
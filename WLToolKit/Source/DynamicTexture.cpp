@@ -0,0 +1,382 @@
+
+#include <vector>
+
+#include "Common.hpp"
+#include "Capabilities.hpp"
+#include "TextureImpl.hpp"
+#include "DynamicTexture.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+#define MAX_DIRTY_RECTS		8
+
+struct DirtyRect {
+	int x, y, width, height;
+};
+
+struct DynamicTextureImpl {
+	DynamicTextureImpl() : surface(NULL), lastUploadBytes(0), format(GL_RGBA), bRowLength(false), nextPBO(0), bPBO(false) {
+		pbo[0] = pbo[1] = 0;
+	}
+
+	cairo_surface_t *surface;
+
+	std::vector<DirtyRect> dirty;
+	size_t lastUploadBytes;
+
+	/** staging for the GLES2 path */
+	std::vector<unsigned char> staging;
+
+	/** GL_BGRA_EXT takes cairo's bytes as they are, GL_UNPACK_ROW_LENGTH then reads them in place */
+	GLenum format;
+	bool bRowLength;
+
+	/** GLES3: two unpack buffers used in turn so the CPU never waits on the previous upload */
+	GLuint pbo[2];
+	int nextPBO;
+	bool bPBO;
+};
+
+static bool
+HasCapability(Capabilities::Capability capability)
+{
+	const Capabilities *caps = Capabilities::GetCurrent();
+
+	return caps && caps->Has(capability);
+}
+
+/** cairo ARGB32 is BGRA in memory, GLES2 only takes RGBA unless GL_EXT_texture_format_BGRA8888 */
+static void
+CopyRect(unsigned char *dst, const unsigned char *src, int stride, const DirtyRect &rect, GLenum format)
+{
+	if (format == GL_BGRA_EXT) {
+		for (int y = 0; y < rect.height; y++, dst += rect.width * 4)
+			memcpy(dst, src + (rect.y + y) * stride + rect.x * 4, rect.width * 4);
+		return;
+	}
+
+	for (int y = 0; y < rect.height; y++) {
+		const unsigned char *s = src + (rect.y + y) * stride + rect.x * 4;
+
+		for (int x = 0; x < rect.width; x++, s += 4, dst += 4) {
+			dst[0] = s[2];
+			dst[1] = s[1];
+			dst[2] = s[0];
+			dst[3] = s[3];
+		}
+	}
+}
+
+DynamicTexture::DynamicTexture(int width, int height)
+: Texture()
+{
+	m_pDynImpl = new DynamicTextureImpl;
+
+	m_pDynImpl->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(m_pDynImpl->surface) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "[WLToolKit] ERR: cannot create %dx%d surface\n", width, height);
+		return;
+	}
+
+	ResourceRegistry::Track(ResourceRegistry::kPixels, (uintptr_t)m_pDynImpl->surface,
+		cairo_image_surface_get_stride(m_pDynImpl->surface) * height, "DynamicTexture");
+
+	m_pImpl->width = width;
+	m_pImpl->height = height;
+	m_pImpl->stride = cairo_image_surface_get_stride(m_pDynImpl->surface);
+
+	if (HasCapability(Capabilities::kBGRA8888)) {
+		m_pDynImpl->format = GL_BGRA_EXT;
+		m_pDynImpl->bRowLength = HasCapability(Capabilities::kUnpackSubimage);
+	}
+
+	glGenTextures(1, &m_pImpl->texture);
+	glBindTexture(GL_TEXTURE_2D, m_pImpl->texture);
+
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	/** storage only, the content arrives through the first Update() */
+	glTexImage2D(GL_TEXTURE_2D, 0, m_pDynImpl->format, width, height, 0, m_pDynImpl->format, GL_UNSIGNED_BYTE, NULL);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	ResourceRegistry::Track(ResourceRegistry::kTexture, m_pImpl->texture, width * height * 4, "DynamicTexture");
+
+#if defined(WLTK_HAVE_GLES3)
+	if (HasCapability(Capabilities::kGLES3)) {
+		glGenBuffers(2, m_pDynImpl->pbo);
+		m_pDynImpl->bPBO = true;
+
+		/** sized by the first upload through each of them */
+		ResourceRegistry::Track(ResourceRegistry::kBuffer, m_pDynImpl->pbo[0], 0, "DynamicTexture PBO");
+		ResourceRegistry::Track(ResourceRegistry::kBuffer, m_pDynImpl->pbo[1], 0, "DynamicTexture PBO");
+	}
+#endif
+
+	m_pImpl->bLoaded = true;
+
+	/** a new cairo image surface is cleared, the texture has undefined content */
+	Invalidate(0, 0, width, height);
+}
+
+DynamicTexture::~DynamicTexture()
+{
+	if (m_pImpl->bLoaded) {
+		ResourceRegistry::Untrack(ResourceRegistry::kTexture, m_pImpl->texture);
+		glDeleteTextures(1, &m_pImpl->texture);
+		m_pImpl->texture = 0;
+		m_pImpl->bLoaded = false;
+	}
+
+	if (m_pDynImpl->bPBO) {
+		ResourceRegistry::Untrack(ResourceRegistry::kBuffer, m_pDynImpl->pbo[0]);
+		ResourceRegistry::Untrack(ResourceRegistry::kBuffer, m_pDynImpl->pbo[1]);
+		glDeleteBuffers(2, m_pDynImpl->pbo);
+	}
+
+	if (m_pDynImpl->surface) {
+		ResourceRegistry::Untrack(ResourceRegistry::kPixels, (uintptr_t)m_pDynImpl->surface);
+		cairo_surface_destroy(m_pDynImpl->surface);
+	}
+
+	delete m_pDynImpl;
+}
+
+cairo_t *
+DynamicTexture::BeginPaint(int x, int y, int width, int height)
+{
+	cairo_t *cr = cairo_create(m_pDynImpl->surface);
+
+	cairo_rectangle(cr, x, y, width, height);
+	cairo_clip(cr);
+
+	Invalidate(x, y, width, height);
+
+	return cr;
+}
+
+cairo_t *
+DynamicTexture::BeginPaint()
+{
+	return BeginPaint(0, 0, m_pImpl->width, m_pImpl->height);
+}
+
+void
+DynamicTexture::EndPaint(cairo_t *cr)
+{
+	cairo_destroy(cr);
+}
+
+void
+DynamicTexture::Invalidate(int x, int y, int width, int height)
+{
+	/** clip to the surface */
+	if (x < 0) {
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		height += y;
+		y = 0;
+	}
+	if (x + width > m_pImpl->width)
+		width = m_pImpl->width - x;
+	if (y + height > m_pImpl->height)
+		height = m_pImpl->height - y;
+	if ((width <= 0) || (height <= 0))
+		return;
+
+	DirtyRect rect = { x, y, width, height };
+	std::vector<DirtyRect> &dirty = m_pDynImpl->dirty;
+
+	/** merge with an existing rectangle when the union wastes little */
+	for (size_t i = 0; i < dirty.size(); i++) {
+		DirtyRect &d = dirty[i];
+
+		int x0 = (d.x < rect.x) ? d.x : rect.x;
+		int y0 = (d.y < rect.y) ? d.y : rect.y;
+		int x1 = (d.x + d.width > rect.x + rect.width) ? d.x + d.width : rect.x + rect.width;
+		int y1 = (d.y + d.height > rect.y + rect.height) ? d.y + d.height : rect.y + rect.height;
+
+		long unionArea = (long)(x1 - x0) * (y1 - y0);
+		long area = (long)d.width * d.height + (long)rect.width * rect.height;
+
+		if (unionArea * 3 <= area * 4) {
+			DirtyRect merged = { x0, y0, x1 - x0, y1 - y0 };
+			dirty.erase(dirty.begin() + i);
+
+			Invalidate(merged.x, merged.y, merged.width, merged.height);
+			return;
+		}
+	}
+
+	dirty.push_back(rect);
+
+	/** too many small rectangles cost more in calls than in bandwidth */
+	if (dirty.size() > MAX_DIRTY_RECTS) {
+		DirtyRect bounds = dirty[0];
+
+		for (size_t i = 1; i < dirty.size(); i++) {
+			int x1 = bounds.x + bounds.width;
+			int y1 = bounds.y + bounds.height;
+
+			if (dirty[i].x < bounds.x)
+				bounds.x = dirty[i].x;
+			if (dirty[i].y < bounds.y)
+				bounds.y = dirty[i].y;
+			if (dirty[i].x + dirty[i].width > x1)
+				x1 = dirty[i].x + dirty[i].width;
+			if (dirty[i].y + dirty[i].height > y1)
+				y1 = dirty[i].y + dirty[i].height;
+
+			bounds.width = x1 - bounds.x;
+			bounds.height = y1 - bounds.y;
+		}
+
+		dirty.clear();
+		dirty.push_back(bounds);
+	}
+}
+
+cairo_surface_t *
+DynamicTexture::GetSurface()
+{
+	return m_pDynImpl->surface;
+}
+
+void
+DynamicTexture::Update()
+{
+	std::vector<DirtyRect> &dirty = m_pDynImpl->dirty;
+
+	m_pDynImpl->lastUploadBytes = 0;
+
+	if (!IsLoaded() || dirty.empty())
+		return;
+
+	cairo_surface_flush(m_pDynImpl->surface);
+
+	const unsigned char *data = cairo_image_surface_get_data(m_pDynImpl->surface);
+	int stride = m_pImpl->stride;
+
+	size_t total = 0;
+	for (size_t i = 0; i < dirty.size(); i++)
+		total += (size_t)dirty[i].width * dirty[i].height * 4;
+
+	glBindTexture(GL_TEXTURE_2D, m_pImpl->texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+#if defined(WLTK_HAVE_GLES3)
+	if (m_pDynImpl->bPBO) {
+		GLuint pbo = m_pDynImpl->pbo[m_pDynImpl->nextPBO];
+		m_pDynImpl->nextPBO ^= 1;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+
+		/** orphan the old storage instead of waiting for the GPU to finish reading it */
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, total, NULL, GL_STREAM_DRAW);
+		ResourceRegistry::Resize(ResourceRegistry::kBuffer, pbo, total);
+
+		unsigned char *dst = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+		if (dst) {
+			size_t offset = 0;
+			for (size_t i = 0; i < dirty.size(); i++) {
+				CopyRect(dst + offset, data, stride, dirty[i], m_pDynImpl->format);
+				offset += (size_t)dirty[i].width * dirty[i].height * 4;
+			}
+
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			offset = 0;
+			for (size_t i = 0; i < dirty.size(); i++) {
+				const DirtyRect &rect = dirty[i];
+
+				glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height,
+					m_pDynImpl->format, GL_UNSIGNED_BYTE, (const void *)offset);
+				offset += (size_t)rect.width * rect.height * 4;
+			}
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+
+			m_pDynImpl->lastUploadBytes = total;
+			dirty.clear();
+			return;
+		}
+
+		/** mapping failed, fall back to a client memory upload */
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+#endif
+
+	/** no staging copy at all: GL reads the rectangles straight out of the cairo surface */
+	if (m_pDynImpl->bRowLength) {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / 4);
+
+		for (size_t i = 0; i < dirty.size(); i++) {
+			const DirtyRect &rect = dirty[i];
+
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height,
+				m_pDynImpl->format, GL_UNSIGNED_BYTE, data + rect.y * stride + rect.x * 4);
+		}
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		m_pDynImpl->lastUploadBytes = total;
+		dirty.clear();
+		return;
+	}
+
+	for (size_t i = 0; i < dirty.size(); i++) {
+		const DirtyRect &rect = dirty[i];
+
+		m_pDynImpl->staging.resize((size_t)rect.width * rect.height * 4);
+		CopyRect(&m_pDynImpl->staging[0], data, stride, rect, m_pDynImpl->format);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height,
+			m_pDynImpl->format, GL_UNSIGNED_BYTE, &m_pDynImpl->staging[0]);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_pDynImpl->lastUploadBytes = total;
+	dirty.clear();
+}
+
+size_t
+DynamicTexture::GetLastUploadBytes()
+{
+	return m_pDynImpl->lastUploadBytes;
+}
+
+void
+DynamicTexture::Draw(WindowEGL *window, int x, int y)
+{
+	Update();
+
+	Texture::Draw(window, x, y);
+}
+
+void
+DynamicTexture::Draw(WindowEGL *window, int x, int y, float scale)
+{
+	Update();
+
+	Texture::Draw(window, x, y, scale);
+}
+
+void
+DynamicTexture::Draw(WindowEGL *window, int x, int y, float scale, uint32_t color)
+{
+	Update();
+
+	Texture::Draw(window, x, y, scale, color);
+}
+
+} // End-of-namespace WLToolKit
+
@@ -0,0 +1,54 @@
+#ifndef WL_TOOLKIT_DYNAMIC_TEXTURE_HPP
+#define WL_TOOLKIT_DYNAMIC_TEXTURE_HPP
+
+#include "Texture.hpp"
+
+typedef struct _cairo cairo_t;
+typedef struct _cairo_surface cairo_surface_t;
+
+namespace WLToolKit {
+
+struct DynamicTextureImpl;
+
+/**
+ * A texture backed by a persistent cairo image surface.
+ *
+ * Drawing goes through BeginPaint()/EndPaint(), which clip cairo to the
+ * given rectangle and remember it as dirty. Before the next draw only the
+ * dirty rectangles are uploaded with glTexSubImage2D, through a pixel
+ * unpack buffer when the context is GLES3. With GL_EXT_texture_format_BGRA8888
+ * cairo's pixels go up unswizzled, and read in place when the unpack row
+ * length can be set too (see Capabilities).
+ */
+class DynamicTexture : public Texture {
+public:
+	DynamicTexture(int width, int height);
+	virtual ~DynamicTexture();
+
+	/** cairo context clipped to the rectangle, which is marked dirty */
+	cairo_t *BeginPaint(int x, int y, int width, int height);
+	cairo_t *BeginPaint();
+	void EndPaint(cairo_t *cr);
+
+	/** For code that draws into GetSurface() directly */
+	void Invalidate(int x, int y, int width, int height);
+
+	cairo_surface_t *GetSurface();
+
+	/** Uploads the dirty rectangles, Draw() calls it */
+	void Update();
+
+	/** Bytes sent to GL by the last Update() */
+	size_t GetLastUploadBytes();
+
+	virtual void Draw(WindowEGL *window, int x, int y);
+	virtual void Draw(WindowEGL *window, int x, int y, float scale);
+	virtual void Draw(WindowEGL *window, int x, int y, float scale, uint32_t color);
+
+protected:
+	struct DynamicTextureImpl *m_pDynImpl;
+}; // End-of-class DynamicTexture
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_DYNAMIC_TEXTURE_HPP */
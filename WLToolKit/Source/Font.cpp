@@ -0,0 +1,472 @@
+
+#include <math.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+#include "Shader.hpp"
+#include "Pipeline.hpp"
+#include "WindowEGL.hpp"
+#include "Renderer.hpp"
+#include "FrameArena.hpp"
+#include "Font.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+#define ATLAS_SIZE		512
+#define GLYPH_PADDING	1		/** empty texels around each glyph against filtering bleed */
+#define MAX_RUNS		1024	/** shaped runs kept per font */
+
+static unsigned int s_nextFontId = 1;
+
+/* ------------------------------------
+	Font
+-------------------------------------*/
+
+struct GlyphRun {
+	std::vector<cairo_glyph_t> glyphs;	/** positions relative to the baseline origin */
+	int width;
+};
+
+struct FontImpl {
+	FontImpl() : id(s_nextFontId++), scaledFont(NULL) {}
+
+	unsigned int id;
+	cairo_scaled_font_t *scaledFont;
+	cairo_font_extents_t extents;
+
+	std::map<std::string, GlyphRun> runs;
+};
+
+Font::Font(const char *family, float size, bool bold)
+{
+	m_pImpl = new FontImpl;
+
+	cairo_font_face_t *face = cairo_toy_font_face_create(family, CAIRO_FONT_SLANT_NORMAL,
+		bold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+
+	cairo_matrix_t fontMatrix, ctm;
+	cairo_matrix_init_scale(&fontMatrix, size, size);
+	cairo_matrix_init_identity(&ctm);
+
+	cairo_font_options_t *options = cairo_font_options_create();
+	cairo_font_options_set_antialias(options, CAIRO_ANTIALIAS_GRAY);
+
+	m_pImpl->scaledFont = cairo_scaled_font_create(face, &fontMatrix, &ctm, options);
+
+	cairo_font_options_destroy(options);
+	cairo_font_face_destroy(face);
+
+	if (cairo_scaled_font_status(m_pImpl->scaledFont) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "[WLToolKit] ERR: cannot create font '%s' %.1f\n", family, size);
+		cairo_scaled_font_destroy(m_pImpl->scaledFont);
+		m_pImpl->scaledFont = NULL;
+		memset(&m_pImpl->extents, 0, sizeof(m_pImpl->extents));
+		return;
+	}
+
+	cairo_scaled_font_extents(m_pImpl->scaledFont, &m_pImpl->extents);
+}
+
+Font::~Font()
+{
+	if (m_pImpl->scaledFont)
+		cairo_scaled_font_destroy(m_pImpl->scaledFont);
+
+	delete m_pImpl;
+}
+
+bool
+Font::IsLoaded()
+{
+	return m_pImpl->scaledFont != NULL;
+}
+
+int
+Font::GetAscent()
+{
+	return (int)(m_pImpl->extents.ascent + 0.5);
+}
+
+int
+Font::GetDescent()
+{
+	return (int)(m_pImpl->extents.descent + 0.5);
+}
+
+int
+Font::GetLineHeight()
+{
+	return (int)(m_pImpl->extents.height + 0.5);
+}
+
+static const GlyphRun*
+GetRun(FontImpl *font, const char *text)
+{
+	std::map<std::string, GlyphRun>::iterator it = font->runs.find(text);
+	if (it != font->runs.end())
+		return &it->second;
+
+	if (font->runs.size() >= MAX_RUNS)
+		font->runs.clear();
+
+	GlyphRun &run = font->runs[text];
+	run.width = 0;
+
+	cairo_glyph_t *glyphs = NULL;
+	int numGlyphs = 0;
+
+	cairo_status_t status = cairo_scaled_font_text_to_glyphs(font->scaledFont, 0, 0, text, -1,
+		&glyphs, &numGlyphs, NULL, NULL, NULL);
+	if (status != CAIRO_STATUS_SUCCESS)
+		return &run;
+
+	run.glyphs.assign(glyphs, glyphs + numGlyphs);
+
+	if (numGlyphs > 0) {
+		cairo_text_extents_t extents;
+		cairo_scaled_font_glyph_extents(font->scaledFont, glyphs, numGlyphs, &extents);
+		run.width = (int)(extents.x_advance + 0.5);
+	}
+
+	cairo_glyph_free(glyphs);
+
+	return &run;
+}
+
+int
+Font::MeasureText(const char *text)
+{
+	if (!IsLoaded())
+		return 0;
+
+	return GetRun(m_pImpl, text)->width;
+}
+
+/* ------------------------------------
+	TextRenderer
+-------------------------------------*/
+
+struct AtlasGlyph {
+	bool bEmpty;			/** whitespace, nothing to draw */
+	int left, top;			/** offset of the bitmap from the pen position */
+	int width, height;
+	GLfloat u0, v0, u1, v1;
+};
+
+struct AtlasShelf {
+	int y, height, x;
+};
+
+struct TextVertex {
+	GLfloat x, y;
+	GLfloat u, v;
+	GLubyte r, g, b, a;
+};
+
+typedef std::pair<unsigned int, unsigned long> GlyphKey;	/** font id, glyph index */
+
+struct TextRendererImpl {
+	TextRendererImpl(WindowEGL *window)
+	: window(window), program(0), atlas(0), uniformAtlas(-1), atlasBottom(0), vertices(window->GetFrameArena()) {}
+
+	WindowEGL *window;
+
+	GLuint program;
+	GLuint atlas;
+	GLint uniformAtlas;
+
+	std::vector<AtlasShelf> shelves;
+	int atlasBottom;
+	std::map<GlyphKey, AtlasGlyph> glyphs;
+
+	FrameVector<TextVertex> vertices;
+	std::vector<unsigned char> scratch;
+};
+
+static bool
+AllocateInAtlas(TextRendererImpl *impl, int width, int height, int *x, int *y)
+{
+	AtlasShelf *best = NULL;
+
+	/** the lowest shelf that fits, ignoring ones that would waste more than a third */
+	for (size_t i = 0; i < impl->shelves.size(); i++) {
+		AtlasShelf &shelf = impl->shelves[i];
+
+		if ((shelf.height < height) || (shelf.height * 2 > height * 3))
+			continue;
+		if (shelf.x + width > ATLAS_SIZE)
+			continue;
+		if (!best || (shelf.height < best->height))
+			best = &shelf;
+	}
+
+	if (!best) {
+		if ((impl->atlasBottom + ((height + 3) & ~3) > ATLAS_SIZE) || (width > ATLAS_SIZE))
+			return false;
+
+		AtlasShelf shelf;
+		shelf.y = impl->atlasBottom;
+		shelf.height = (height + 3) & ~3;	/** a little slack so similar glyphs share it */
+		shelf.x = 0;
+
+		impl->shelves.push_back(shelf);
+		impl->atlasBottom += shelf.height;
+
+		best = &impl->shelves.back();
+	}
+
+	*x = best->x;
+	*y = best->y;
+	best->x += width;
+
+	return true;
+}
+
+static void
+ResetAtlas(TextRendererImpl *impl)
+{
+	impl->shelves.clear();
+	impl->glyphs.clear();
+	impl->atlasBottom = 0;
+}
+
+/** Returns NULL when the atlas is full */
+static const AtlasGlyph*
+GetGlyph(TextRendererImpl *impl, FontImpl *font, unsigned long index)
+{
+	GlyphKey key(font->id, index);
+
+	std::map<GlyphKey, AtlasGlyph>::iterator it = impl->glyphs.find(key);
+	if (it != impl->glyphs.end())
+		return &it->second;
+
+	cairo_glyph_t glyph = { index, 0.0, 0.0 };
+	cairo_text_extents_t extents;
+	cairo_scaled_font_glyph_extents(font->scaledFont, &glyph, 1, &extents);
+
+	AtlasGlyph entry;
+	memset(&entry, 0, sizeof(entry));
+
+	int width = (int)(extents.width + 2.0);
+	int height = (int)(extents.height + 2.0);
+
+	if ((extents.width <= 0.0) || (extents.height <= 0.0)) {
+		entry.bEmpty = true;
+		return &(impl->glyphs[key] = entry);
+	}
+
+	int x, y;
+	if (!AllocateInAtlas(impl, width + GLYPH_PADDING * 2, height + GLYPH_PADDING * 2, &x, &y))
+		return NULL;
+
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_A8, width, height);
+	cairo_t *cr = cairo_create(surface);
+
+	glyph.x = -extents.x_bearing + 1.0;
+	glyph.y = -extents.y_bearing + 1.0;
+
+	cairo_set_scaled_font(cr, font->scaledFont);
+	cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 1.0);
+	cairo_show_glyphs(cr, &glyph, 1);
+	cairo_destroy(cr);
+
+	cairo_surface_flush(surface);
+
+	unsigned char *data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+
+	glBindTexture(GL_TEXTURE_2D, impl->atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+#if defined(WLTK_HAVE_GLES3)
+	if (impl->window->IsGLES3()) {
+		/** cairo pads A8 rows to 4 bytes, let GL skip the padding */
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x + GLYPH_PADDING, y + GLYPH_PADDING, width, height,
+			GL_ALPHA, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	} else
+#endif
+	{
+		/** GLES2 has no GL_UNPACK_ROW_LENGTH, repack rows tightly */
+		impl->scratch.resize(width * height);
+		for (int row = 0; row < height; row++)
+			memcpy(&impl->scratch[row * width], data + row * stride, width);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x + GLYPH_PADDING, y + GLYPH_PADDING, width, height,
+			GL_ALPHA, GL_UNSIGNED_BYTE, &impl->scratch[0]);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	cairo_surface_destroy(surface);
+
+	entry.bEmpty = false;
+	entry.left = (int)floor(extents.x_bearing) - 1;
+	entry.top = (int)floor(extents.y_bearing) - 1;
+	entry.width = width;
+	entry.height = height;
+	entry.u0 = (GLfloat)(x + GLYPH_PADDING) / ATLAS_SIZE;
+	entry.v0 = (GLfloat)(y + GLYPH_PADDING) / ATLAS_SIZE;
+	entry.u1 = (GLfloat)(x + GLYPH_PADDING + width) / ATLAS_SIZE;
+	entry.v1 = (GLfloat)(y + GLYPH_PADDING + height) / ATLAS_SIZE;
+
+	return &(impl->glyphs[key] = entry);
+}
+
+TextRenderer::TextRenderer(WindowEGL *window)
+{
+	m_pImpl = new TextRendererImpl(window);
+
+	m_pImpl->program = CreateCoverageProgram();
+	if (!m_pImpl->program)
+		return;
+
+	m_pImpl->uniformAtlas = glGetUniformLocation(m_pImpl->program, "atlas");
+
+	glGenTextures(1, &m_pImpl->atlas);
+	glBindTexture(GL_TEXTURE_2D, m_pImpl->atlas);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	/** allocated once, glyphs arrive later through glTexSubImage2D */
+	std::vector<unsigned char> empty(ATLAS_SIZE * ATLAS_SIZE, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_SIZE, ATLAS_SIZE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &empty[0]);
+	ResourceRegistry::Track(ResourceRegistry::kTexture, m_pImpl->atlas, ATLAS_SIZE * ATLAS_SIZE, "TextRenderer atlas");
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+TextRenderer::~TextRenderer()
+{
+	if (m_pImpl->atlas) {
+		ResourceRegistry::Untrack(ResourceRegistry::kTexture, m_pImpl->atlas);
+		glDeleteTextures(1, &m_pImpl->atlas);
+	}
+	if (m_pImpl->program)
+		DeleteProgram(m_pImpl->program);
+
+	delete m_pImpl;
+}
+
+void
+TextRenderer::DrawText(Font *font, const char *text, int x, int y, uint32_t color)
+{
+	if (!m_pImpl->program || !font || !font->IsLoaded() || !text)
+		return;
+
+	FontImpl *fontImpl = font->m_pImpl;
+	const GlyphRun *run = GetRun(fontImpl, text);
+
+	float width = m_pImpl->window->GetWidth();
+	float height = m_pImpl->window->GetHeight();
+	int baseline = y + font->GetAscent();
+
+	GLubyte a = (color >> 24) & 0xff;
+	GLubyte r = (color >> 16) & 0xff;
+	GLubyte g = (color >> 8) & 0xff;
+	GLubyte b = color & 0xff;
+
+	for (size_t i = 0; i < run->glyphs.size(); i++) {
+		const AtlasGlyph *glyph = GetGlyph(m_pImpl, fontImpl, run->glyphs[i].index);
+
+		if (!glyph) {
+			/** atlas full: draw what refers to it, start over and retry once */
+			Flush();
+			ResetAtlas(m_pImpl);
+			glyph = GetGlyph(m_pImpl, fontImpl, run->glyphs[i].index);
+			if (!glyph)
+				continue;
+		}
+
+		if (glyph->bEmpty)
+			continue;
+
+		float gx = x + (int)(run->glyphs[i].x + 0.5) + glyph->left;
+		float gy = baseline + (int)(run->glyphs[i].y + 0.5) + glyph->top;
+
+		GLfloat left = (gx / width) * 2.0f - 1.0f;
+		GLfloat right = ((gx + glyph->width) / width) * 2.0f - 1.0f;
+		GLfloat top = 1.0f - (gy / height) * 2.0f;
+		GLfloat bottom = 1.0f - ((gy + glyph->height) / height) * 2.0f;
+
+		TextVertex corners[4] = {
+			{ left,  top,    glyph->u0, glyph->v0, r, g, b, a },
+			{ left,  bottom, glyph->u0, glyph->v1, r, g, b, a },
+			{ right, top,    glyph->u1, glyph->v0, r, g, b, a },
+			{ right, bottom, glyph->u1, glyph->v1, r, g, b, a },
+		};
+
+		TextVertex *v = m_pImpl->vertices.Extend(6);
+		if (!v)
+			return;
+
+		v[0] = corners[0];
+		v[1] = corners[1];
+		v[2] = corners[2];
+		v[3] = corners[2];
+		v[4] = corners[1];
+		v[5] = corners[3];
+	}
+}
+
+void
+TextRenderer::DrawTextCentered(Font *font, const char *text, int centerX, int y, uint32_t color)
+{
+	if (!font || !font->IsLoaded() || !text)
+		return;
+
+	DrawText(font, text, centerX - font->MeasureText(text) / 2, y, color);
+}
+
+void
+TextRenderer::Flush()
+{
+	if (m_pImpl->vertices.Empty())
+		return;
+
+	/** sprites queued before the text belong underneath it */
+	m_pImpl->window->GetRenderer()->Flush();
+
+	const TextVertex *v = m_pImpl->vertices.Data();
+
+	glUseProgram(m_pImpl->program);
+	glUniform1i(m_pImpl->uniformAtlas, 0);
+
+	glBindTexture(GL_TEXTURE_2D, m_pImpl->atlas);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), &v->x);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), &v->u);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), &v->r);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	PremultipliedBlend::Apply();
+
+	glDrawArrays(GL_TRIANGLES, 0, m_pImpl->vertices.Size());
+	m_pImpl->window->CountDrawCall();
+
+	glDisable(GL_BLEND);
+
+	glDisableVertexAttribArray(2);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_pImpl->vertices.Clear();
+}
+
+} // End-of-namespace WLToolKit
+
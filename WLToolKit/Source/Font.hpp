@@ -0,0 +1,61 @@
+#ifndef WL_TOOLKIT_FONT_HPP
+#define WL_TOOLKIT_FONT_HPP
+
+#include <stdint.h>
+
+namespace WLToolKit {
+
+class WindowEGL;
+struct FontImpl;
+struct TextRendererImpl;
+
+/**
+ * A cairo scaled font plus a cache of shaped runs.
+ * Fonts hold no GL objects and can be shared between TextRenderers.
+ */
+class Font {
+public:
+	Font(const char *family, float size, bool bold = false);
+	virtual ~Font();
+
+	bool IsLoaded();
+
+	int GetAscent();
+	int GetDescent();
+	int GetLineHeight();
+
+	/** Advance width of text in pixels */
+	int MeasureText(const char *text);
+
+protected:
+	friend class TextRenderer;
+
+	struct FontImpl *m_pImpl;
+}; // End-of-class Font
+
+/**
+ * Batches text for one window.
+ *
+ * Glyphs are rasterized once with cairo into a shared GL_ALPHA atlas
+ * (shelf packed) and every DrawText() until Flush() lands in the same
+ * vertex array, so any number of labels costs one draw call. Changing a
+ * label only uploads glyphs that were never seen before.
+ */
+class TextRenderer {
+public:
+	TextRenderer(WindowEGL *window);
+	virtual ~TextRenderer();
+
+	/** (x, y) is the top-left of the line box, color is 0xAARRGGBB */
+	void DrawText(Font *font, const char *text, int x, int y, uint32_t color);
+	void DrawTextCentered(Font *font, const char *text, int centerX, int y, uint32_t color);
+
+	void Flush();
+
+protected:
+	struct TextRendererImpl *m_pImpl;
+}; // End-of-class TextRenderer
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_FONT_HPP */
@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "FrameArena.hpp"
+
+namespace WLToolKit {
+
+#define BLOCK_GRANULE	4096
+
+static size_t
+RoundUp(size_t bytes, size_t granule)
+{
+	return (bytes + granule - 1) & ~(granule - 1);
+}
+
+static unsigned char*
+AlignUp(unsigned char* p, size_t align)
+{
+	return (unsigned char*)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+FrameArena::FrameArena(size_t capacity)
+: m_current(0), m_frameId(0), m_last(NULL), m_bFailed(false)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	capacity = RoundUp(capacity, BLOCK_GRANULE);
+
+	for (int i = 0; i < kNumFrames; i++) {
+		Slot& slot = m_slots[i];
+
+		slot.base = (unsigned char*)malloc(capacity);
+
+		/** an empty slot, its frames take overflow blocks */
+		if (!slot.base) {
+			fprintf(stderr, "[WLToolKit] ERR: frame arena cannot allocate %zu bytes\n", capacity);
+			slot.capacity = 0;
+		} else {
+			slot.capacity = capacity;
+
+			m_stats.capacity += capacity;
+			m_stats.heapBlocks++;
+		}
+
+		slot.cursor = slot.base;
+		slot.limit = slot.base + slot.capacity;
+		slot.used = 0;
+
+		/** the vector itself must not allocate on the first overflow either */
+		slot.overflow.reserve(8);
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for (int i = 0; i < kNumFrames; i++) {
+		Slot& slot = m_slots[i];
+
+		for (size_t b = 0; b < slot.overflow.size(); b++)
+			free(slot.overflow[b]);
+
+		free(slot.base);
+	}
+}
+
+void
+FrameArena::BeginFrame()
+{
+	m_current = (m_current + 1) % kNumFrames;
+	m_frameId++;
+	m_last = NULL;
+	m_bFailed = false;
+
+	ResetSlot(m_slots[m_current]);
+}
+
+void
+FrameArena::ResetSlot(Slot& slot)
+{
+	if (!slot.overflow.empty()) {
+		for (size_t b = 0; b < slot.overflow.size(); b++)
+			free(slot.overflow[b]);
+		slot.overflow.clear();
+
+		/** one block big enough for the largest frame so far, with some slack */
+		size_t capacity = RoundUp(m_stats.highWater + m_stats.highWater / 4, BLOCK_GRANULE);
+
+		if (capacity > slot.capacity) {
+			unsigned char* base = (unsigned char*)malloc(capacity);
+
+			/** the old block still works, the frames in this slot keep overflowing */
+			if (!base) {
+				fprintf(stderr, "[WLToolKit] WARN: frame arena cannot grow a slot to %zu bytes\n", capacity);
+			} else {
+				free(slot.base);
+				slot.base = base;
+
+				m_stats.capacity += capacity - slot.capacity;
+				m_stats.heapBlocks++;
+
+				slot.capacity = capacity;
+			}
+		}
+	}
+
+	slot.cursor = slot.base;
+	slot.limit = slot.base + slot.capacity;
+	slot.used = 0;
+}
+
+void*
+FrameArena::Allocate(size_t bytes, size_t align)
+{
+	Slot& slot = m_slots[m_current];
+
+	unsigned char* p = AlignUp(slot.cursor, align);
+
+	if (p + bytes > slot.limit) {
+		/** room for this one and whatever else the frame still needs */
+		size_t size = RoundUp(bytes + align > slot.capacity ? bytes + align : slot.capacity, BLOCK_GRANULE);
+		unsigned char* block = (unsigned char*)malloc(size);
+
+		if (!block) {
+			if (!m_bFailed)
+				fprintf(stderr, "[WLToolKit] ERR: frame arena cannot grow by %zu bytes, dropping data of this frame\n", size);
+
+			m_bFailed = true;
+			m_stats.failures++;
+			return NULL;
+		}
+
+		slot.overflow.push_back(block);
+		m_stats.heapBlocks++;
+
+		slot.cursor = block;
+		slot.limit = block + size;
+
+		p = AlignUp(slot.cursor, align);
+	}
+
+	slot.used += (p + bytes) - slot.cursor;
+	slot.cursor = p + bytes;
+
+	if (slot.used > m_stats.highWater)
+		m_stats.highWater = slot.used;
+
+	m_last = p;
+
+	return p;
+}
+
+void*
+FrameArena::Reallocate(void* ptr, size_t oldBytes, size_t newBytes, size_t align)
+{
+	Slot& slot = m_slots[m_current];
+	unsigned char* p = (unsigned char*)ptr;
+
+	if ((p == m_last) && (p + newBytes <= slot.limit)) {
+		if (newBytes > oldBytes)
+			slot.used += newBytes - oldBytes;
+		else
+			slot.used -= oldBytes - newBytes;
+
+		slot.cursor = p + newBytes;
+
+		if (slot.used > m_stats.highWater)
+			m_stats.highWater = slot.used;
+
+		return p;
+	}
+
+	void* moved = Allocate(newBytes, align);
+	if (!moved)
+		return NULL;
+
+	memcpy(moved, ptr, (oldBytes < newBytes) ? oldBytes : newBytes);
+
+	return moved;
+}
+
+const FrameArena::Stats&
+FrameArena::GetStats()
+{
+	m_stats.used = m_slots[m_current].used;
+
+	return m_stats;
+}
+
+void
+FrameArena::Dump(FILE* fp)
+{
+	const Stats& stats = GetStats();
+
+	fprintf(fp, "[WLToolKit] frame arena: %zu KB in %d slots, high water %zu KB, %u heap blocks, %u failed\n",
+		stats.capacity / 1024, kNumFrames, stats.highWater / 1024, stats.heapBlocks, stats.failures);
+}
+
+} // End-of-namespace WLToolKit
+
@@ -0,0 +1,190 @@
+#ifndef WL_TOOLKIT_FRAME_ARENA_HPP
+#define WL_TOOLKIT_FRAME_ARENA_HPP
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+
+namespace WLToolKit {
+
+/**
+ * Linear allocator for data that lives for one frame: sprite queues,
+ * vertex and instance streams, text quads.
+ *
+ * Allocation is a pointer bump, nothing is freed individually; BeginFrame()
+ * moves to the next of kNumFrames slots and resets it wholesale. A frame's
+ * data therefore stays valid until its slot comes round again, which covers
+ * the frames the driver may still have queued behind eglSwapBuffers().
+ *
+ * A slot that runs out takes an overflow block from the heap and is grown
+ * to the high-water mark the next time it is reset, so once the largest
+ * frame has been seen rendering does not touch the heap anymore.
+ *
+ * Out of memory, a slot keeps the block it has and Allocate() returns
+ * NULL; the users drop what does not fit (sprites, glyphs, opaque rects)
+ * and the first failure of a frame is reported on stderr.
+ */
+class FrameArena {
+public:
+	static const int kNumFrames = 3;
+
+	struct Stats {
+		size_t capacity;		/** all slots together */
+		size_t used;			/** by the current frame */
+		size_t highWater;		/** most any frame used */
+		unsigned int heapBlocks;	/** blocks taken from the heap since creation */
+		unsigned int failures;		/** allocations refused because the heap was out of memory */
+	};
+
+	/** capacity is per slot, it only grows */
+	FrameArena(size_t capacity = 256 * 1024);
+	virtual ~FrameArena();
+
+	void BeginFrame();
+
+	/** Valid until the slot is reset; NULL with a message only when the heap is out of memory */
+	void* Allocate(size_t bytes, size_t align = 16);
+
+	/** Extends in place when ptr is the latest allocation, copies otherwise; NULL leaves ptr as it was */
+	void* Reallocate(void* ptr, size_t oldBytes, size_t newBytes, size_t align = 16);
+
+	template<typename T>
+	T* Allocate(size_t count) {
+		return (T*)Allocate(count * sizeof(T), __alignof__(T));
+	}
+
+	/** Changes every BeginFrame(), lets containers notice their storage is gone */
+	unsigned int GetFrameId() const { return m_frameId; }
+
+	const Stats& GetStats();
+	void Dump(FILE* fp);
+
+protected:
+	struct Slot {
+		unsigned char* base;
+		size_t capacity;
+
+		/** bump pointer into base or into the newest overflow block */
+		unsigned char* cursor;
+		unsigned char* limit;
+
+		/** bytes handed out by the frame in this slot, padding included */
+		size_t used;
+
+		/** overflow blocks of the frame in this slot, freed on reset */
+		std::vector<unsigned char*> overflow;
+	};
+
+	void ResetSlot(Slot& slot);
+
+protected:
+	Slot m_slots[kNumFrames];
+	int m_current;
+	unsigned int m_frameId;
+
+	/** start of the latest allocation, Reallocate() extends it in place */
+	unsigned char* m_last;
+
+	/** an allocation of this frame failed already, it was reported */
+	bool m_bFailed;
+
+	Stats m_stats;
+}; // End-of-class FrameArena
+
+/**
+ * Growable array of plain data on a FrameArena. It forgets its content when
+ * the arena starts a new frame, clearing keeps the storage until then.
+ * Elements are moved with memcpy, no constructors or destructors run.
+ */
+template<typename T>
+class FrameVector {
+public:
+	FrameVector(FrameArena* arena)
+	: m_arena(arena), m_data(NULL), m_size(0), m_capacity(0), m_frameId(arena->GetFrameId()) {}
+
+	/** Drops value when the arena is out of memory */
+	void PushBack(const T& value) {
+		T* p = Extend(1);
+		if (p)
+			*p = value;
+	}
+
+	/** Appends count uninitialized elements; NULL, and nothing appended, when the arena is out of memory */
+	T* Extend(size_t count) {
+		Sync();
+
+		if ((m_size + count > m_capacity) && !Grow(m_size + count))
+			return NULL;
+
+		T* p = m_data + m_size;
+		m_size += count;
+
+		return p;
+	}
+
+	void Clear() {
+		Sync();
+		m_size = 0;
+	}
+
+	size_t Size() {
+		Sync();
+		return m_size;
+	}
+
+	bool Empty() {
+		return Size() == 0;
+	}
+
+	T* Data() {
+		Sync();
+		return m_data;
+	}
+
+	T& operator[](size_t i) {
+		return m_data[i];
+	}
+
+protected:
+	void Sync() {
+		if (m_frameId != m_arena->GetFrameId()) {
+			m_frameId = m_arena->GetFrameId();
+			m_data = NULL;
+			m_size = 0;
+			m_capacity = 0;
+		}
+	}
+
+	bool Grow(size_t minimum) {
+		size_t capacity = m_capacity ? m_capacity * 2 : 64;
+		while (capacity < minimum)
+			capacity *= 2;
+
+		T* data;
+		if (m_data)
+			data = (T*)m_arena->Reallocate(m_data, m_size * sizeof(T), capacity * sizeof(T), __alignof__(T));
+		else
+			data = m_arena->Allocate<T>(capacity);
+
+		if (!data)
+			return false;
+
+		m_data = data;
+		m_capacity = capacity;
+
+		return true;
+	}
+
+protected:
+	FrameArena* m_arena;
+	T* m_data;
+	size_t m_size;
+	size_t m_capacity;
+	unsigned int m_frameId;
+}; // End-of-class FrameVector
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_FRAME_ARENA_HPP */
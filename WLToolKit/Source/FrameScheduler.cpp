@@ -0,0 +1,471 @@
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include <vector>
+
+#include "Common.hpp"
+#include "Clock.hpp"
+#include "Display.hpp"
+#include "FrameScheduler.hpp"
+
+namespace WLToolKit {
+
+#define COST_HISTORY		16
+#define DEFAULT_MARGIN_NS	2000000ULL		/** compositor repaint before the vblank */
+#define MIN_SAFETY_NS		500000ULL
+#define SAFETY_DECAY_NS		50000ULL		/** given back per on-time frame */
+#define MIN_DELAY_NS		500000ULL		/** not worth a timer below this */
+#define DEFAULT_PERIOD_NS	16666667ULL		/** 60 Hz until frame callbacks tell otherwise */
+#define MIN_PERIOD_NS		2000000ULL		/** closer callbacks are not vblank paced */
+
+struct FrameSchedulerImpl;
+
+/** toytoolkit hands the task back, this finds the scheduler again */
+struct SchedulerTask {
+	struct task task;
+	FrameSchedulerImpl* impl;
+};
+
+struct PendingFeedback {
+	FrameSchedulerImpl* impl;
+	struct wp_presentation_feedback* feedback;
+	unsigned int frame;
+	uint64_t targetNs;
+};
+
+struct FrameSchedulerImpl {
+	FrameSchedulerImpl()
+	: display(NULL), render(NULL), data(NULL), present(NULL), presentData(NULL), bEnabled(true),
+	  timerFd(-1), bTimerArmed(false),
+	  refreshNs(0), lastPresentNs(0), costIndex(0), costCount(0),
+	  marginNs(DEFAULT_MARGIN_NS), safetyNs(MIN_SAFETY_NS),
+	  frameStartNs(0), targetNs(0), startNs(0), lastDelayNs(0),
+	  lastCallbackNs(0), intervalIndex(0), intervalCount(0),
+	  presented(0), missed(0) {
+		memset(costs, 0, sizeof(costs));
+		memset(intervals, 0, sizeof(intervals));
+		memset(&timerTask, 0, sizeof(timerTask));
+	}
+
+	Display* display;
+	FrameScheduler::RenderFunc render;
+	void* data;
+	FrameScheduler::PresentFunc present;
+	void* presentData;
+	bool bEnabled;
+
+	int timerFd;
+	bool bTimerArmed;
+	SchedulerTask timerTask;
+
+	uint64_t refreshNs;
+	uint64_t lastPresentNs;
+
+	/** render start to end of swap of recent frames */
+	uint64_t costs[COST_HISTORY];
+	int costIndex;
+	int costCount;
+
+	uint64_t marginNs;
+	uint64_t safetyNs;
+
+	uint64_t frameStartNs;
+	uint64_t targetNs;
+	uint64_t startNs;		/** the armed render start */
+	uint64_t lastDelayNs;
+
+	/** between recent frame callbacks, the period when wp_presentation does not give one */
+	uint64_t lastCallbackNs;
+	uint64_t intervals[COST_HISTORY];
+	int intervalIndex;
+	int intervalCount;
+
+	unsigned int presented;
+	unsigned int missed;
+
+	std::vector<PendingFeedback*> pending;
+
+	/** finished entries are reused, steady-state frames do not allocate */
+	std::vector<PendingFeedback*> spare;
+};
+
+static void _TimerHandler(struct task* task, uint32_t events);
+static void _SyncOutputHandler(void* data, struct wp_presentation_feedback* feedback, struct wl_output* output);
+static void _PresentedHandler(void* data, struct wp_presentation_feedback* feedback,
+	uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+	uint32_t seq_hi, uint32_t seq_lo, uint32_t flags);
+static void _DiscardedHandler(void* data, struct wp_presentation_feedback* feedback);
+
+static const struct wp_presentation_feedback_listener feedbackListener = {
+	_SyncOutputHandler,
+	_PresentedHandler,
+	_DiscardedHandler
+};
+
+/** presentation timestamps use the clock the compositor announced */
+static uint64_t
+ToMonotonic(FrameSchedulerImpl* impl, uint64_t ns)
+{
+	clockid_t clock = (clockid_t)impl->display->GetPresentationClock();
+
+	if (clock == CLOCK_MONOTONIC)
+		return ns;
+
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+
+	uint64_t clockNow = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	return ns + Clock::NowNs() - clockNow;
+}
+
+/** worst recent cost, a frame that overruns costs more than one that starts early */
+static uint64_t
+PredictCost(FrameSchedulerImpl* impl)
+{
+	uint64_t cost = 0;
+
+	for (int i = 0; i < impl->costCount; i++) {
+		if (impl->costs[i] > cost)
+			cost = impl->costs[i];
+	}
+
+	return cost;
+}
+
+/** the shortest recent interval, longer ones skipped a vblank */
+static uint64_t
+PredictPeriod(FrameSchedulerImpl* impl)
+{
+	if (impl->refreshNs)
+		return impl->refreshNs;
+
+	uint64_t period = 0;
+
+	for (int i = 0; i < impl->intervalCount; i++) {
+		if (!period || (impl->intervals[i] < period))
+			period = impl->intervals[i];
+	}
+
+	return period ? period : DEFAULT_PERIOD_NS;
+}
+
+static void
+RemovePending(FrameSchedulerImpl* impl, PendingFeedback* pending)
+{
+	for (size_t i = 0; i < impl->pending.size(); i++) {
+		if (impl->pending[i] == pending) {
+			impl->pending.erase(impl->pending.begin() + i);
+			break;
+		}
+	}
+
+	wp_presentation_feedback_destroy(pending->feedback);
+	impl->spare.push_back(pending);
+}
+
+FrameScheduler::FrameScheduler(Display* display, RenderFunc render, void* data)
+{
+	assert(display);
+	assert(render);
+
+	m_pImpl = new FrameSchedulerImpl;
+
+	m_pImpl->display = display;
+	m_pImpl->render = render;
+	m_pImpl->data = data;
+
+	const char* sched = getenv("WLTK_SCHED");
+	if (sched && (sched[0] == '0'))
+		m_pImpl->bEnabled = false;
+
+	const char* margin = getenv("WLTK_SCHED_MARGIN_US");
+	if (margin && (margin[0] != '\0'))
+		m_pImpl->marginNs = (uint64_t)atoi(margin) * 1000ULL;
+
+	m_pImpl->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (m_pImpl->timerFd < 0) {
+		fprintf(stderr, "[WLToolKit] ERR: timerfd_create failed, frames are not delayed\n");
+		m_pImpl->bEnabled = false;
+		return;
+	}
+
+	m_pImpl->timerTask.task.run = _TimerHandler;
+	m_pImpl->timerTask.impl = m_pImpl;
+
+	display_watch_fd(display->GetDisplay(), m_pImpl->timerFd, EPOLLIN, &m_pImpl->timerTask.task);
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	while (!m_pImpl->pending.empty())
+		RemovePending(m_pImpl, m_pImpl->pending.back());
+
+	for (size_t i = 0; i < m_pImpl->spare.size(); i++)
+		delete m_pImpl->spare[i];
+
+	if (m_pImpl->timerFd >= 0) {
+		display_unwatch_fd(m_pImpl->display->GetDisplay(), m_pImpl->timerFd);
+		close(m_pImpl->timerFd);
+	}
+
+	delete m_pImpl;
+}
+
+void
+FrameScheduler::SetEnabled(bool enabled)
+{
+	m_pImpl->bEnabled = enabled && (m_pImpl->timerFd >= 0);
+}
+
+bool
+FrameScheduler::IsEnabled()
+{
+	return m_pImpl->bEnabled;
+}
+
+void
+FrameScheduler::SetPresentCallback(PresentFunc present, void* data)
+{
+	m_pImpl->present = present;
+	m_pImpl->presentData = data;
+}
+
+void
+FrameScheduler::OnFrameCallback()
+{
+	FrameSchedulerImpl* impl = m_pImpl;
+	uint64_t now = Clock::NowNs();
+
+	if (impl->lastCallbackNs && (now - impl->lastCallbackNs >= MIN_PERIOD_NS)) {
+		impl->intervals[impl->intervalIndex] = now - impl->lastCallbackNs;
+		impl->intervalIndex = (impl->intervalIndex + 1) % COST_HISTORY;
+		if (impl->intervalCount < COST_HISTORY)
+			impl->intervalCount++;
+	}
+
+	impl->lastCallbackNs = now;
+}
+
+void
+FrameScheduler::Schedule()
+{
+	FrameSchedulerImpl* impl = m_pImpl;
+
+	/** a frame is already waiting for its start time */
+	if (impl->bTimerArmed)
+		return;
+
+	impl->lastDelayNs = 0;
+	impl->targetNs = 0;
+
+	if (!impl->display->GetPresentation() || !impl->refreshNs || !impl->lastPresentNs) {
+		impl->render(impl->data);
+		return;
+	}
+
+	uint64_t now = Clock::NowNs();
+	uint64_t cost = PredictCost(impl);
+	uint64_t lead = impl->marginNs + impl->safetyNs + cost;
+
+	/** the first vblank this frame can still make */
+	uint64_t earliest = now + lead;
+	uint64_t periods = 1;
+	if (earliest > impl->lastPresentNs)
+		periods = (earliest - impl->lastPresentNs + impl->refreshNs - 1) / impl->refreshNs;
+	if (periods == 0)
+		periods = 1;
+
+	impl->targetNs = impl->lastPresentNs + periods * impl->refreshNs;
+
+	uint64_t start = impl->targetNs - lead;
+
+	if (impl->bEnabled && (start > now + MIN_DELAY_NS)) {
+		struct itimerspec its;
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = start / 1000000000ULL;
+		its.it_value.tv_nsec = start % 1000000000ULL;
+
+		if (timerfd_settime(impl->timerFd, TFD_TIMER_ABSTIME, &its, NULL) == 0) {
+			impl->startNs = start;
+			impl->lastDelayNs = start - now;
+			impl->bTimerArmed = true;
+			return;
+		}
+	}
+
+	impl->render(impl->data);
+}
+
+bool
+FrameScheduler::IsWaiting()
+{
+	return m_pImpl->bTimerArmed;
+}
+
+void
+FrameScheduler::BeginFrame()
+{
+	m_pImpl->frameStartNs = Clock::NowNs();
+}
+
+bool
+FrameScheduler::BeginSwap(struct wl_surface* surface, unsigned int frame)
+{
+	struct wp_presentation* presentation = m_pImpl->display->GetPresentation();
+	if (!presentation)
+		return false;
+
+	/** must be requested before eglSwapBuffers() commits the surface */
+	PendingFeedback* pending;
+	if (m_pImpl->spare.empty()) {
+		pending = new PendingFeedback;
+	} else {
+		pending = m_pImpl->spare.back();
+		m_pImpl->spare.pop_back();
+	}
+
+	pending->impl = m_pImpl;
+	pending->feedback = wp_presentation_feedback(presentation, surface);
+	pending->frame = frame;
+	pending->targetNs = m_pImpl->targetNs;
+
+	wp_presentation_feedback_add_listener(pending->feedback, &feedbackListener, pending);
+	m_pImpl->pending.push_back(pending);
+
+	return true;
+}
+
+void
+FrameScheduler::EndFrame()
+{
+	FrameSchedulerImpl* impl = m_pImpl;
+
+	impl->costs[impl->costIndex] = Clock::NowNs() - impl->frameStartNs;
+	impl->costIndex = (impl->costIndex + 1) % COST_HISTORY;
+	if (impl->costCount < COST_HISTORY)
+		impl->costCount++;
+}
+
+uint64_t
+FrameScheduler::GetPredictedPresentNs()
+{
+	return m_pImpl->targetNs;
+}
+
+uint64_t
+FrameScheduler::GetRefreshNs()
+{
+	return m_pImpl->refreshNs;
+}
+
+uint64_t
+FrameScheduler::GetNextFrameNs()
+{
+	FrameSchedulerImpl* impl = m_pImpl;
+	uint64_t now = Clock::NowNs();
+
+	if (impl->bTimerArmed)
+		return impl->startNs;
+
+	uint64_t period = PredictPeriod(impl);
+
+	if (!impl->lastCallbackNs)
+		return now + period;
+
+	/** the callback after the last one that is still to come */
+	uint64_t next = impl->lastCallbackNs + period;
+	if (next <= now)
+		next += ((now - next) / period + 1) * period;
+
+	return next;
+}
+
+uint64_t
+FrameScheduler::GetLastDelayNs()
+{
+	return m_pImpl->lastDelayNs;
+}
+
+unsigned int
+FrameScheduler::GetPresentedFrames()
+{
+	return m_pImpl->presented;
+}
+
+unsigned int
+FrameScheduler::GetMissedFrames()
+{
+	return m_pImpl->missed;
+}
+
+static void
+_TimerHandler(struct task* task, uint32_t events)
+{
+	FrameSchedulerImpl* impl = ((SchedulerTask*)task)->impl;
+	uint64_t expirations;
+
+	if (read(impl->timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+
+	impl->bTimerArmed = false;
+	impl->render(impl->data);
+}
+
+static void
+_SyncOutputHandler(void* data, struct wp_presentation_feedback* feedback, struct wl_output* output)
+{
+}
+
+static void
+_PresentedHandler(void* data, struct wp_presentation_feedback* feedback,
+	uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+	uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+	PendingFeedback* pending = (PendingFeedback*)data;
+	FrameSchedulerImpl* impl = pending->impl;
+
+	uint64_t sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+	uint64_t presentNs = ToMonotonic(impl, sec * 1000000000ULL + tv_nsec);
+
+	if (refresh)
+		impl->refreshNs = refresh;
+	impl->lastPresentNs = presentNs;
+	impl->presented++;
+
+	/** half a period late means the frame went out a vblank after the one predicted */
+	if (pending->targetNs && impl->refreshNs) {
+		if (presentNs > pending->targetNs + impl->refreshNs / 2) {
+			impl->missed++;
+
+			impl->safetyNs += impl->refreshNs / 8;
+			if (impl->safetyNs > impl->refreshNs)
+				impl->safetyNs = impl->refreshNs;
+		} else if (impl->safetyNs > MIN_SAFETY_NS) {
+			uint64_t decay = impl->safetyNs - MIN_SAFETY_NS;
+			impl->safetyNs -= (decay < SAFETY_DECAY_NS) ? decay : SAFETY_DECAY_NS;
+		}
+	}
+
+	if (impl->present)
+		impl->present(impl->presentData, pending->frame, presentNs);
+
+	RemovePending(impl, pending);
+}
+
+static void
+_DiscardedHandler(void* data, struct wp_presentation_feedback* feedback)
+{
+	PendingFeedback* pending = (PendingFeedback*)data;
+	FrameSchedulerImpl* impl = pending->impl;
+
+	if (impl->present)
+		impl->present(impl->presentData, pending->frame, 0);
+
+	RemovePending(impl, pending);
+}
+
+} // End-of-namespace WLToolKit
+
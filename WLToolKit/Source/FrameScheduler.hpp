@@ -0,0 +1,83 @@
+#ifndef WL_TOOLKIT_FRAME_SCHEDULER_HPP
+#define WL_TOOLKIT_FRAME_SCHEDULER_HPP
+
+#include <stdint.h>
+
+struct wl_surface;
+
+namespace WLToolKit {
+
+class Display;
+struct FrameSchedulerImpl;
+
+/**
+ * Decides when WindowEGL starts rendering a frame.
+ *
+ * Without wp_presentation the frame is rendered as soon as the frame
+ * callback fires, as before. With it, the refresh period and the real
+ * presentation times of previous frames predict the next vblank, and the
+ * render start is pushed back to (vblank - margin - render cost - safety),
+ * so input that arrives in the meantime still makes it into the frame.
+ *
+ * The safety term grows whenever a frame misses its predicted vblank and
+ * shrinks slowly while frames are on time.
+ *
+ * GetNextFrameNs() is when the next frame is expected to start, for the
+ * IdleScheduler: the armed render start, or the next frame callback, one
+ * refresh period after the last. Without wp_presentation the period is
+ * the shortest recent interval between frame callbacks.
+ *
+ * Runtime switches:
+ *   WLTK_SCHED=0              render on the frame callback, no delay
+ *   WLTK_SCHED_MARGIN_US=n    time the compositor needs before the vblank
+ */
+class FrameScheduler {
+public:
+	typedef void (*RenderFunc)(void* data);
+
+	/** presentNs is CLOCK_MONOTONIC, 0 when the compositor discarded the frame */
+	typedef void (*PresentFunc)(void* data, unsigned int frame, uint64_t presentNs);
+
+	FrameScheduler(Display* display, RenderFunc render, void* data);
+	virtual ~FrameScheduler();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled();
+
+	/** Told about every frame that got presentation feedback */
+	void SetPresentCallback(PresentFunc present, void* data);
+
+	/** Called when a frame callback arrives, before Schedule() */
+	void OnFrameCallback();
+
+	/** Called on the frame callback; renders now or arms the timer */
+	void Schedule();
+
+	/** A frame waits for the timer to start it */
+	bool IsWaiting();
+
+	/** Called by the render function around its work */
+	void BeginFrame();
+
+	/** false when no feedback will arrive for this frame */
+	bool BeginSwap(struct wl_surface* surface, unsigned int frame);
+	void EndFrame();
+
+	/** CLOCK_MONOTONIC, 0 when nothing is predicted */
+	uint64_t GetPredictedPresentNs();
+	uint64_t GetRefreshNs();
+	uint64_t GetLastDelayNs();
+
+	/** CLOCK_MONOTONIC */
+	uint64_t GetNextFrameNs();
+
+	unsigned int GetPresentedFrames();
+	unsigned int GetMissedFrames();
+
+protected:
+	FrameSchedulerImpl* m_pImpl;
+}; // End-of-class FrameScheduler
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_FRAME_SCHEDULER_HPP */
@@ -0,0 +1,422 @@
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** GL headers only, the trace itself must not go through GLTraceWrap.hpp */
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+}
+
+#include "Clock.hpp"
+#include "Capabilities.hpp"
+#include "GLTrace.hpp"
+
+namespace WLToolKit {
+
+#if defined(WLTK_ENABLE_GL_TRACE)
+
+struct GLTraceMessage {
+	unsigned int frame;
+	GLTrace::Call call;		/** last wrapped call issued before the message */
+	GLenum source;
+	GLenum type;
+	GLuint id;
+	GLenum severity;
+	std::string text;
+};
+
+struct GLTraceState {
+	GLTraceState()
+	: bInitialized(false), bInFrame(false), bPrintFrames(false),
+	  bTiming(false), bCheckErrors(false), bDebugOutput(false),
+	  drawBudget(0), overruns(0), frame(0), frameStart(0),
+	  lastCall(GLTrace::kNumCalls), log(stderr) {
+		memset(&current, 0, sizeof(current));
+		memset(&last, 0, sizeof(last));
+		memset(budgets, 0, sizeof(budgets));
+	}
+
+	bool bInitialized;
+	bool bInFrame;
+	bool bPrintFrames;
+	bool bTiming;
+	bool bCheckErrors;
+	bool bDebugOutput;
+
+	unsigned int budgets[GLTrace::kNumCalls];
+	unsigned int drawBudget;
+	unsigned int overruns;
+
+	unsigned int frame;
+	uint64_t frameStart;
+	GLTrace::Call lastCall;
+
+	GLTrace::FrameStats current;
+	GLTrace::FrameStats last;
+	std::vector<GLTraceMessage> messages;
+
+	FILE* log;
+};
+
+static GLTraceState s_trace;
+
+static void Initialize();
+static const char* DebugSourceName(GLenum source);
+static const char* DebugTypeName(GLenum type);
+static const char* DebugSeverityName(GLenum severity);
+
+#endif /* defined(WLTK_ENABLE_GL_TRACE) */
+
+static const char* s_callNames[] = {
+#define WLTK_GL_TRACE_NAME(name) "gl" #name,
+	WLTK_GL_TRACE_CALLS(WLTK_GL_TRACE_NAME)
+#undef WLTK_GL_TRACE_NAME
+};
+
+bool
+GLTrace::IsCompiledIn()
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void
+GLTrace::SetTimingEnabled(bool enabled)
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	Initialize();
+	s_trace.bTiming = enabled;
+#endif
+}
+
+void
+GLTrace::SetErrorCheckEnabled(bool enabled)
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	Initialize();
+	s_trace.bCheckErrors = enabled;
+#endif
+}
+
+bool
+GLTrace::IsTimingEnabled()
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	return s_trace.bTiming;
+#else
+	return false;
+#endif
+}
+
+void
+GLTrace::SetBudget(Call call, unsigned int maxPerFrame)
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	if (call < kNumCalls)
+		s_trace.budgets[call] = maxPerFrame;
+#endif
+}
+
+void
+GLTrace::SetDrawCallBudget(unsigned int maxPerFrame)
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	s_trace.drawBudget = maxPerFrame;
+#endif
+}
+
+unsigned int
+GLTrace::GetBudgetOverruns()
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	return s_trace.overruns;
+#else
+	return 0;
+#endif
+}
+
+void
+GLTrace::BeginFrame()
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	Initialize();
+
+	s_trace.frame++;
+	s_trace.bInFrame = true;
+	s_trace.frameStart = Clock::NowNs();
+
+	memset(&s_trace.current, 0, sizeof(s_trace.current));
+	s_trace.current.frame = s_trace.frame;
+#endif
+}
+
+void
+GLTrace::EndFrame()
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	if (!s_trace.bInFrame)
+		return;
+
+	FrameStats& stats = s_trace.current;
+
+	stats.totalTimeNs = Clock::NowNs() - s_trace.frameStart;
+	stats.drawCalls = stats.counts[kDrawArrays] + stats.counts[kDrawArraysInstanced] + stats.counts[kDrawElements];
+	stats.messages = 0;
+
+	for (size_t i = 0; i < s_trace.messages.size(); i++) {
+		const GLTraceMessage& msg = s_trace.messages[i];
+		if (msg.frame != stats.frame)
+			continue;
+
+		stats.messages++;
+#if defined(GL_KHR_debug)
+		if (msg.type == GL_DEBUG_TYPE_ERROR_KHR)
+			stats.errors++;
+#endif
+
+		fprintf(s_trace.log,
+				"[WLToolKit] GL: frame=%u call=%s source=%s type=%s id=%u severity=%s msg=\"%s\"\n",
+				msg.frame,
+				(msg.call < kNumCalls) ? s_callNames[msg.call] : "-",
+				DebugSourceName(msg.source), DebugTypeName(msg.type),
+				msg.id, DebugSeverityName(msg.severity), msg.text.c_str());
+	}
+	s_trace.messages.clear();
+
+	bool bOverrun = false;
+
+	if (s_trace.drawBudget && (stats.drawCalls > s_trace.drawBudget)) {
+		fprintf(s_trace.log, "[WLToolKit] GL: frame=%u budget exceeded: draw calls %u > %u\n",
+				stats.frame, stats.drawCalls, s_trace.drawBudget);
+		bOverrun = true;
+	}
+
+	for (int i = 0; i < kNumCalls; i++) {
+		if (s_trace.budgets[i] && (stats.counts[i] > s_trace.budgets[i])) {
+			fprintf(s_trace.log, "[WLToolKit] GL: frame=%u budget exceeded: %s %u > %u\n",
+					stats.frame, s_callNames[i], stats.counts[i], s_trace.budgets[i]);
+			bOverrun = true;
+		}
+	}
+
+	if (bOverrun)
+		s_trace.overruns++;
+
+	if (s_trace.bPrintFrames)
+		Dump(s_trace.log, stats);
+
+	s_trace.last = stats;
+	s_trace.bInFrame = false;
+#endif
+}
+
+#if defined(WLTK_ENABLE_GL_TRACE) && defined(GL_KHR_debug)
+static void GL_APIENTRY
+_DebugMessageHandler(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* data)
+{
+	GLTraceMessage msg;
+
+	msg.frame = s_trace.bInFrame ? s_trace.frame : 0;
+	msg.call = s_trace.lastCall;
+	msg.source = source;
+	msg.type = type;
+	msg.id = id;
+	msg.severity = severity;
+	msg.text.assign(message, (length < 0) ? strlen(message) : (size_t)length);
+
+	/** outside a frame there is nobody to flush the log, print right away */
+	if (!s_trace.bInFrame) {
+		fprintf(s_trace.log,
+				"[WLToolKit] GL: frame=- call=%s source=%s type=%s id=%u severity=%s msg=\"%s\"\n",
+				(msg.call < GLTrace::kNumCalls) ? s_callNames[msg.call] : "-",
+				DebugSourceName(source), DebugTypeName(type),
+				id, DebugSeverityName(severity), msg.text.c_str());
+		return;
+	}
+
+	s_trace.messages.push_back(msg);
+}
+#endif
+
+void
+GLTrace::EnableDebugOutput(const Capabilities& caps)
+{
+#if defined(WLTK_ENABLE_GL_TRACE) && defined(GL_KHR_debug)
+	Initialize();
+
+	if (s_trace.bDebugOutput)
+		return;
+
+	if (!caps.Has(Capabilities::kDebug)) {
+		fprintf(s_trace.log, "[WLToolKit] GL: GL_KHR_debug is not supported, relying on glGetError\n");
+		s_trace.bCheckErrors = true;
+		return;
+	}
+
+	caps.GetDebugMessageCallback()(&_DebugMessageHandler, NULL);
+
+	/** synchronous output lets each message be attributed to the call that raised it */
+	glEnable(GL_DEBUG_OUTPUT_KHR);
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
+
+	s_trace.bDebugOutput = true;
+#endif
+}
+
+const GLTrace::FrameStats&
+GLTrace::GetLastFrame()
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	return s_trace.last;
+#else
+	static FrameStats empty;
+	return empty;
+#endif
+}
+
+const char*
+GLTrace::GetCallName(Call call)
+{
+	if (call >= kNumCalls)
+		return "unknown";
+
+	return s_callNames[call];
+}
+
+void
+GLTrace::Dump(FILE* fp, const FrameStats& stats)
+{
+	fprintf(fp, "[WLToolKit] GL: frame=%u calls=%u draws=%u messages=%u errors=%u time=%.3fms",
+			stats.frame, stats.totalCalls, stats.drawCalls, stats.messages, stats.errors,
+			stats.totalTimeNs / 1000000.0);
+
+	for (int i = 0; i < kNumCalls; i++) {
+		if (stats.counts[i] == 0)
+			continue;
+
+		if (stats.timeNs[i])
+			fprintf(fp, " %s=%u/%.1fus", s_callNames[i], stats.counts[i], stats.timeNs[i] / 1000.0);
+		else
+			fprintf(fp, " %s=%u", s_callNames[i], stats.counts[i]);
+	}
+
+	fprintf(fp, "\n");
+}
+
+void
+GLTrace::Record(Call call, uint64_t startNs)
+{
+#if defined(WLTK_ENABLE_GL_TRACE)
+	s_trace.lastCall = call;
+
+	if (!s_trace.bInFrame)
+		return;
+
+	FrameStats& stats = s_trace.current;
+
+	stats.counts[call]++;
+	stats.totalCalls++;
+
+	if (startNs)
+		stats.timeNs[call] += Clock::NowNs() - startNs;
+
+	if (s_trace.bCheckErrors) {
+		GLenum err;
+		while ((err = glGetError()) != GL_NO_ERROR) {
+			stats.errors++;
+			fprintf(s_trace.log, "[WLToolKit] GL: frame=%u call=%s error=0x%04x\n",
+					stats.frame, s_callNames[call], err);
+		}
+	}
+#endif
+}
+
+#if defined(WLTK_ENABLE_GL_TRACE)
+
+static bool
+IsEnvSet(const char* name)
+{
+	const char* value = getenv(name);
+
+	return value && (value[0] != '\0') && (value[0] != '0');
+}
+
+static void
+Initialize()
+{
+	if (s_trace.bInitialized)
+		return;
+
+	s_trace.bInitialized = true;
+	s_trace.bPrintFrames = IsEnvSet("WLTK_GL_TRACE");
+	s_trace.bTiming = IsEnvSet("WLTK_GL_TRACE_TIMING");
+	s_trace.bCheckErrors = IsEnvSet("WLTK_GL_TRACE_ERRORS");
+
+	const char* path = getenv("WLTK_GL_TRACE_LOG");
+	if (path && path[0]) {
+		FILE* fp = fopen(path, "w");
+		if (fp)
+			s_trace.log = fp;
+		else
+			fprintf(stderr, "[WLToolKit] ERR: cannot open %s\n", path);
+	}
+}
+
+static const char*
+DebugSourceName(GLenum source)
+{
+	switch (source) {
+#if defined(GL_KHR_debug)
+	case GL_DEBUG_SOURCE_API_KHR:				return "api";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM_KHR:		return "window-system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER_KHR:	return "shader-compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY_KHR:		return "third-party";
+	case GL_DEBUG_SOURCE_APPLICATION_KHR:		return "application";
+#endif
+	default:									return "other";
+	}
+}
+
+static const char*
+DebugTypeName(GLenum type)
+{
+	switch (type) {
+#if defined(GL_KHR_debug)
+	case GL_DEBUG_TYPE_ERROR_KHR:				return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_KHR:	return "deprecated";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_KHR:	return "undefined";
+	case GL_DEBUG_TYPE_PORTABILITY_KHR:			return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE_KHR:			return "performance";
+	case GL_DEBUG_TYPE_MARKER_KHR:				return "marker";
+#endif
+	default:									return "other";
+	}
+}
+
+static const char*
+DebugSeverityName(GLenum severity)
+{
+	switch (severity) {
+#if defined(GL_KHR_debug)
+	case GL_DEBUG_SEVERITY_HIGH_KHR:			return "high";
+	case GL_DEBUG_SEVERITY_MEDIUM_KHR:			return "medium";
+	case GL_DEBUG_SEVERITY_LOW_KHR:				return "low";
+	case GL_DEBUG_SEVERITY_NOTIFICATION_KHR:	return "notification";
+#endif
+	default:									return "unknown";
+	}
+}
+
+#endif /* defined(WLTK_ENABLE_GL_TRACE) */
+
+} // End-of-namespace WLToolKit
+
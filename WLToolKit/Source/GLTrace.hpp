@@ -0,0 +1,131 @@
+#ifndef WL_TOOLKIT_GL_TRACE_HPP
+#define WL_TOOLKIT_GL_TRACE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * GL call tracing.
+ *
+ * Build libWLToolKit with -DWLTK_ENABLE_GL_TRACE to route every GL entry
+ * point used by the toolkit through GLTraceScope (see GLTraceWrap.hpp).
+ * Without the define the wrappers do not exist and the per-frame hooks
+ * below return immediately.
+ *
+ * Runtime switches (only meaningful in a tracing build):
+ *   WLTK_GL_TRACE=1         print a one-line call summary per frame
+ *   WLTK_GL_TRACE_TIMING=1  measure CPU time spent inside each GL call
+ *   WLTK_GL_TRACE_ERRORS=1  call glGetError() after every wrapped call
+ *   WLTK_GL_TRACE_LOG=path  write the per-frame log to path instead of stderr
+ */
+
+#define WLTK_GL_TRACE_CALLS(X)		\
+	X(ActiveTexture)				\
+	X(AttachShader)					\
+	X(BindAttribLocation)			\
+	X(BindBuffer)					\
+	X(BindBufferBase)				\
+	X(BindFramebuffer)				\
+	X(BindTexture)					\
+	X(BindVertexArray)				\
+	X(BlendFunc)					\
+	X(BufferData)					\
+	X(BufferSubData)				\
+	X(Clear)						\
+	X(ClearColor)					\
+	X(CompileShader)				\
+	X(CreateProgram)				\
+	X(CreateShader)					\
+	X(DeleteBuffers)				\
+	X(DeleteProgram)				\
+	X(DeleteShader)					\
+	X(DeleteTextures)				\
+	X(DeleteVertexArrays)			\
+	X(Disable)						\
+	X(DisableVertexAttribArray)		\
+	X(DrawArrays)					\
+	X(DrawArraysInstanced)			\
+	X(DrawElements)					\
+	X(Enable)						\
+	X(EnableVertexAttribArray)		\
+	X(GenBuffers)					\
+	X(GenTextures)					\
+	X(GenVertexArrays)				\
+	X(GetUniformLocation)			\
+	X(GetUniformBlockIndex)			\
+	X(LinkProgram)					\
+	X(MapBufferRange)				\
+	X(PixelStorei)					\
+	X(ReadPixels)					\
+	X(Scissor)						\
+	X(ShaderSource)					\
+	X(TexImage2D)					\
+	X(TexParameterf)				\
+	X(TexParameteri)				\
+	X(TexSubImage2D)				\
+	X(Uniform1f)					\
+	X(Uniform1i)					\
+	X(Uniform4f)					\
+	X(UniformBlockBinding)			\
+	X(UniformMatrix4fv)				\
+	X(UnmapBuffer)					\
+	X(UseProgram)					\
+	X(VertexAttribDivisor)			\
+	X(VertexAttribPointer)			\
+	X(Viewport)
+
+namespace WLToolKit {
+
+class Capabilities;
+
+class GLTrace {
+public:
+#define WLTK_GL_TRACE_ENUM(name) k##name,
+	enum Call {
+		WLTK_GL_TRACE_CALLS(WLTK_GL_TRACE_ENUM)
+		kNumCalls
+	};
+#undef WLTK_GL_TRACE_ENUM
+
+	struct FrameStats {
+		unsigned int frame;
+		unsigned int totalCalls;
+		unsigned int drawCalls;
+		unsigned int messages;		/** KHR_debug messages received in this frame */
+		unsigned int errors;		/** glGetError() / KHR_debug errors in this frame */
+		uint64_t totalTimeNs;
+		unsigned int counts[kNumCalls];
+		uint64_t timeNs[kNumCalls];
+	};
+
+	/** true when the library was built with WLTK_ENABLE_GL_TRACE */
+	static bool IsCompiledIn();
+
+	static void SetTimingEnabled(bool enabled);
+	static void SetErrorCheckEnabled(bool enabled);
+
+	/** 0 removes the budget */
+	static void SetBudget(Call call, unsigned int maxPerFrame);
+	static void SetDrawCallBudget(unsigned int maxPerFrame);
+	static unsigned int GetBudgetOverruns();
+
+	/** Called by WindowEGL around each frame */
+	static void BeginFrame();
+	static void EndFrame();
+
+	/** Hooks KHR_debug into the per-frame log; needs a current context and probed caps */
+	static void EnableDebugOutput(const Capabilities& caps);
+
+	static const FrameStats& GetLastFrame();
+	static const char* GetCallName(Call call);
+
+	static void Dump(FILE* fp, const FrameStats& stats);
+
+	/** Used by GLTraceScope */
+	static void Record(Call call, uint64_t startNs);
+	static bool IsTimingEnabled();
+}; // End-of-class GLTrace
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_GL_TRACE_HPP */
@@ -0,0 +1,95 @@
+#ifndef WL_TOOLKIT_GL_TRACE_WRAP_HPP
+#define WL_TOOLKIT_GL_TRACE_WRAP_HPP
+
+/**
+ * Redirects the GL entry points used by WLToolKit through GLTraceScope.
+ * Must be included after every GL header (Common.hpp does that), otherwise
+ * the prototypes themselves would be rewritten.
+ *
+ * The function name inside each replacement list is not expanded again, so
+ * the wrapper still ends up calling the real entry point.
+ */
+
+#if defined(WLTK_ENABLE_GL_TRACE)
+
+#include "Clock.hpp"
+#include "GLTrace.hpp"
+
+namespace WLToolKit {
+
+class GLTraceScope {
+public:
+	GLTraceScope(GLTrace::Call call)
+	: m_call(call), m_start(GLTrace::IsTimingEnabled() ? Clock::NowNs() : 0) {}
+	~GLTraceScope() { GLTrace::Record(m_call, m_start); }
+
+private:
+	GLTrace::Call m_call;
+	uint64_t m_start;
+}; // End-of-class GLTraceScope
+
+} // End-of-namespace WLToolKit
+
+#define WLTK_GL_TRACE_WRAP(name, expr)	\
+	(WLToolKit::GLTraceScope(WLToolKit::GLTrace::k##name), expr)
+
+#define glActiveTexture(...)			WLTK_GL_TRACE_WRAP(ActiveTexture, glActiveTexture(__VA_ARGS__))
+#define glAttachShader(...)				WLTK_GL_TRACE_WRAP(AttachShader, glAttachShader(__VA_ARGS__))
+#define glBindAttribLocation(...)		WLTK_GL_TRACE_WRAP(BindAttribLocation, glBindAttribLocation(__VA_ARGS__))
+#define glBindBuffer(...)				WLTK_GL_TRACE_WRAP(BindBuffer, glBindBuffer(__VA_ARGS__))
+#define glBindFramebuffer(...)			WLTK_GL_TRACE_WRAP(BindFramebuffer, glBindFramebuffer(__VA_ARGS__))
+#define glBindTexture(...)				WLTK_GL_TRACE_WRAP(BindTexture, glBindTexture(__VA_ARGS__))
+#define glBlendFunc(...)				WLTK_GL_TRACE_WRAP(BlendFunc, glBlendFunc(__VA_ARGS__))
+#define glBufferData(...)				WLTK_GL_TRACE_WRAP(BufferData, glBufferData(__VA_ARGS__))
+#define glBufferSubData(...)			WLTK_GL_TRACE_WRAP(BufferSubData, glBufferSubData(__VA_ARGS__))
+#define glClear(...)					WLTK_GL_TRACE_WRAP(Clear, glClear(__VA_ARGS__))
+#define glClearColor(...)				WLTK_GL_TRACE_WRAP(ClearColor, glClearColor(__VA_ARGS__))
+#define glCompileShader(...)			WLTK_GL_TRACE_WRAP(CompileShader, glCompileShader(__VA_ARGS__))
+#define glCreateProgram(...)			WLTK_GL_TRACE_WRAP(CreateProgram, glCreateProgram(__VA_ARGS__))
+#define glCreateShader(...)				WLTK_GL_TRACE_WRAP(CreateShader, glCreateShader(__VA_ARGS__))
+#define glDeleteBuffers(...)			WLTK_GL_TRACE_WRAP(DeleteBuffers, glDeleteBuffers(__VA_ARGS__))
+#define glDeleteProgram(...)			WLTK_GL_TRACE_WRAP(DeleteProgram, glDeleteProgram(__VA_ARGS__))
+#define glDeleteShader(...)				WLTK_GL_TRACE_WRAP(DeleteShader, glDeleteShader(__VA_ARGS__))
+#define glDeleteTextures(...)			WLTK_GL_TRACE_WRAP(DeleteTextures, glDeleteTextures(__VA_ARGS__))
+#define glDisable(...)					WLTK_GL_TRACE_WRAP(Disable, glDisable(__VA_ARGS__))
+#define glDisableVertexAttribArray(...)	WLTK_GL_TRACE_WRAP(DisableVertexAttribArray, glDisableVertexAttribArray(__VA_ARGS__))
+#define glDrawArrays(...)				WLTK_GL_TRACE_WRAP(DrawArrays, glDrawArrays(__VA_ARGS__))
+#define glDrawElements(...)				WLTK_GL_TRACE_WRAP(DrawElements, glDrawElements(__VA_ARGS__))
+#define glEnable(...)					WLTK_GL_TRACE_WRAP(Enable, glEnable(__VA_ARGS__))
+#define glEnableVertexAttribArray(...)	WLTK_GL_TRACE_WRAP(EnableVertexAttribArray, glEnableVertexAttribArray(__VA_ARGS__))
+#define glGenBuffers(...)				WLTK_GL_TRACE_WRAP(GenBuffers, glGenBuffers(__VA_ARGS__))
+#define glGenTextures(...)				WLTK_GL_TRACE_WRAP(GenTextures, glGenTextures(__VA_ARGS__))
+#define glGetUniformLocation(...)		WLTK_GL_TRACE_WRAP(GetUniformLocation, glGetUniformLocation(__VA_ARGS__))
+#define glLinkProgram(...)				WLTK_GL_TRACE_WRAP(LinkProgram, glLinkProgram(__VA_ARGS__))
+#define glPixelStorei(...)				WLTK_GL_TRACE_WRAP(PixelStorei, glPixelStorei(__VA_ARGS__))
+#define glReadPixels(...)				WLTK_GL_TRACE_WRAP(ReadPixels, glReadPixels(__VA_ARGS__))
+#define glScissor(...)					WLTK_GL_TRACE_WRAP(Scissor, glScissor(__VA_ARGS__))
+#define glShaderSource(...)				WLTK_GL_TRACE_WRAP(ShaderSource, glShaderSource(__VA_ARGS__))
+#define glTexImage2D(...)				WLTK_GL_TRACE_WRAP(TexImage2D, glTexImage2D(__VA_ARGS__))
+#define glTexParameterf(...)			WLTK_GL_TRACE_WRAP(TexParameterf, glTexParameterf(__VA_ARGS__))
+#define glTexParameteri(...)			WLTK_GL_TRACE_WRAP(TexParameteri, glTexParameteri(__VA_ARGS__))
+#define glTexSubImage2D(...)			WLTK_GL_TRACE_WRAP(TexSubImage2D, glTexSubImage2D(__VA_ARGS__))
+#define glUniform1f(...)				WLTK_GL_TRACE_WRAP(Uniform1f, glUniform1f(__VA_ARGS__))
+#define glUniform1i(...)				WLTK_GL_TRACE_WRAP(Uniform1i, glUniform1i(__VA_ARGS__))
+#define glUniform4f(...)				WLTK_GL_TRACE_WRAP(Uniform4f, glUniform4f(__VA_ARGS__))
+#define glUniformMatrix4fv(...)			WLTK_GL_TRACE_WRAP(UniformMatrix4fv, glUniformMatrix4fv(__VA_ARGS__))
+#define glUseProgram(...)				WLTK_GL_TRACE_WRAP(UseProgram, glUseProgram(__VA_ARGS__))
+#define glVertexAttribPointer(...)		WLTK_GL_TRACE_WRAP(VertexAttribPointer, glVertexAttribPointer(__VA_ARGS__))
+#define glViewport(...)					WLTK_GL_TRACE_WRAP(Viewport, glViewport(__VA_ARGS__))
+
+#if defined(WLTK_HAVE_GLES3)
+#define glBindBufferBase(...)			WLTK_GL_TRACE_WRAP(BindBufferBase, glBindBufferBase(__VA_ARGS__))
+#define glBindVertexArray(...)			WLTK_GL_TRACE_WRAP(BindVertexArray, glBindVertexArray(__VA_ARGS__))
+#define glDeleteVertexArrays(...)		WLTK_GL_TRACE_WRAP(DeleteVertexArrays, glDeleteVertexArrays(__VA_ARGS__))
+#define glDrawArraysInstanced(...)		WLTK_GL_TRACE_WRAP(DrawArraysInstanced, glDrawArraysInstanced(__VA_ARGS__))
+#define glGenVertexArrays(...)			WLTK_GL_TRACE_WRAP(GenVertexArrays, glGenVertexArrays(__VA_ARGS__))
+#define glGetUniformBlockIndex(...)		WLTK_GL_TRACE_WRAP(GetUniformBlockIndex, glGetUniformBlockIndex(__VA_ARGS__))
+#define glMapBufferRange(...)			WLTK_GL_TRACE_WRAP(MapBufferRange, glMapBufferRange(__VA_ARGS__))
+#define glUniformBlockBinding(...)		WLTK_GL_TRACE_WRAP(UniformBlockBinding, glUniformBlockBinding(__VA_ARGS__))
+#define glUnmapBuffer(...)				WLTK_GL_TRACE_WRAP(UnmapBuffer, glUnmapBuffer(__VA_ARGS__))
+#define glVertexAttribDivisor(...)		WLTK_GL_TRACE_WRAP(VertexAttribDivisor, glVertexAttribDivisor(__VA_ARGS__))
+#endif
+
+#endif /* defined(WLTK_ENABLE_GL_TRACE) */
+
+#endif /* WL_TOOLKIT_GL_TRACE_WRAP_HPP */
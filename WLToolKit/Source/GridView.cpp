@@ -0,0 +1,506 @@
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Common.hpp"
+#include "Clock.hpp"
+#include "WindowEGL.hpp"
+#include "Renderer.hpp"
+#include "GridView.hpp"
+
+namespace WLToolKit {
+
+#define TAP_SLOP				8.0f		/** pixels a press may move and still be a tap */
+#define FLING_TIME_CONSTANT		0.325f		/** seconds for the fling velocity to decay by 1/e */
+#define FLING_MIN_VELOCITY		20.0f		/** pixels per second */
+#define FLING_MAX_VELOCITY		8000.0f
+#define VELOCITY_WINDOW_NS		100000000ULL	/** motion samples used for the release velocity */
+#define VELOCITY_SAMPLES		16
+
+struct MotionSample {
+	uint64_t timeNs;
+	float y;
+};
+
+struct BoundCell {
+	int index;
+	GridCell *cell;
+};
+
+static bool
+IsBefore(const BoundCell &a, int index)
+{
+	return a.index < index;
+}
+
+struct GridViewImpl {
+	GridViewImpl()
+	: window(NULL), source(NULL), x(0), y(0), width(0), height(0),
+	  cellWidth(1), cellHeight(1), prefetchRows(1), maxPrefetchPerFrame(2), bandCells(0),
+	  offset(0.0f), velocity(0.0f), lastUpdateNs(0),
+	  bDragging(false), bMoved(false), pressX(0), pressY(0), pressOffset(0.0f) {}
+
+	WindowEGL *window;
+	GridDataSource *source;
+
+	int x, y, width, height;
+	int cellWidth, cellHeight;
+	int prefetchRows;
+	int maxPrefetchPerFrame;
+	size_t bandCells;		/** the viewport and prefetch rows, plus a spare row */
+
+	float offset;
+	float velocity;
+	uint64_t lastUpdateNs;
+
+	bool bDragging;
+	bool bMoved;
+	int pressX, pressY;
+	float pressOffset;
+	std::vector<MotionSample> samples;
+
+	/**
+	 * Cells of items in or near the viewport, sorted by item index. Both
+	 * vectors are reserved for the viewport and prefetch rows, so binding
+	 * and recycling while scrolling stays within their capacity.
+	 */
+	std::vector<BoundCell> bound;
+	std::vector<GridCell*> pool;
+};
+
+static float
+Clamp(float value, float min, float max)
+{
+	if (value < min)
+		return min;
+	if (value > max)
+		return max;
+	return value;
+}
+
+/** room for every cell the viewport and the prefetch rows can hold, called when any of them changes */
+static void
+ReserveCells(GridViewImpl *impl)
+{
+	int columns = std::max(impl->width / impl->cellWidth, 1);
+	int rows = impl->height / impl->cellHeight + 2 + impl->prefetchRows * 2;
+	size_t cells = (size_t)rows * columns;
+
+	impl->bandCells = cells + columns;
+	impl->bound.reserve(cells);
+
+	/** a jump recycles every bound cell on top of the spares */
+	impl->pool.reserve(impl->bandCells);
+}
+
+static bool
+IsBound(GridViewImpl *impl, int index)
+{
+	std::vector<BoundCell>::iterator it = std::lower_bound(impl->bound.begin(), impl->bound.end(), index, IsBefore);
+
+	return (it != impl->bound.end()) && (it->index == index);
+}
+
+/** reuses a recycled cell when there is one */
+static void
+BindCell(GridViewImpl *impl, int index)
+{
+	GridCell *cell;
+
+	if (!impl->pool.empty()) {
+		cell = impl->pool.back();
+		impl->pool.pop_back();
+	} else {
+		cell = impl->source->CreateCell();
+	}
+
+	cell->Bind(index);
+
+	BoundCell bound = { index, cell };
+	impl->bound.insert(std::lower_bound(impl->bound.begin(), impl->bound.end(), index, IsBefore), bound);
+}
+
+GridView::GridView(WindowEGL *window, int x, int y, int width, int height)
+{
+	assert(window);
+
+	m_pImpl = new GridViewImpl;
+
+	m_pImpl->window = window;
+	m_pImpl->x = x;
+	m_pImpl->y = y;
+	m_pImpl->width = width;
+	m_pImpl->height = height;
+
+	m_pImpl->samples.reserve(VELOCITY_SAMPLES);
+
+	ReserveCells(m_pImpl);
+}
+
+GridView::~GridView()
+{
+	for (size_t i = 0; i < m_pImpl->bound.size(); i++) {
+		m_pImpl->bound[i].cell->Unbind();
+		delete m_pImpl->bound[i].cell;
+	}
+
+	for (size_t i = 0; i < m_pImpl->pool.size(); i++)
+		delete m_pImpl->pool[i];
+
+	delete m_pImpl;
+}
+
+void
+GridView::SetDataSource(GridDataSource *source)
+{
+	m_pImpl->source = source;
+
+	ReloadData();
+}
+
+void
+GridView::SetCellSize(int width, int height)
+{
+	assert((width > 0) && (height > 0));
+
+	m_pImpl->cellWidth = width;
+	m_pImpl->cellHeight = height;
+
+	ReserveCells(m_pImpl);
+	ReloadData();
+}
+
+void
+GridView::SetGeometry(int x, int y, int width, int height)
+{
+	int oldColumns = GetColumns();
+	int topRow = (int)(m_pImpl->offset / m_pImpl->cellHeight);
+	float withinRow = m_pImpl->offset - (float)(topRow * m_pImpl->cellHeight);
+
+	m_pImpl->x = x;
+	m_pImpl->y = y;
+	m_pImpl->width = width;
+	m_pImpl->height = height;
+
+	ReserveCells(m_pImpl);
+
+	/** a new column count moves every item, follow the one at the top */
+	int columns = GetColumns();
+	if (columns != oldColumns)
+		m_pImpl->offset = (float)((topRow * oldColumns / columns) * m_pImpl->cellHeight) + withinRow;
+
+	/** UpdateCells() drops and binds only what left or entered the viewport */
+	m_pImpl->offset = Clamp(m_pImpl->offset, 0.0f, GetMaxScrollOffset());
+}
+
+void
+GridView::SetPrefetchRows(int rows)
+{
+	m_pImpl->prefetchRows = (rows < 0) ? 0 : rows;
+
+	ReserveCells(m_pImpl);
+}
+
+void
+GridView::SetMaxPrefetchPerFrame(int count)
+{
+	m_pImpl->maxPrefetchPerFrame = (count < 0) ? 0 : count;
+}
+
+void
+GridView::ReloadData()
+{
+	for (size_t i = 0; i < m_pImpl->bound.size(); i++) {
+		m_pImpl->bound[i].cell->Unbind();
+		m_pImpl->pool.push_back(m_pImpl->bound[i].cell);
+	}
+	m_pImpl->bound.clear();
+
+	m_pImpl->offset = Clamp(m_pImpl->offset, 0.0f, GetMaxScrollOffset());
+}
+
+void
+GridView::ScrollTo(float offset)
+{
+	m_pImpl->velocity = 0.0f;
+	m_pImpl->offset = Clamp(offset, 0.0f, GetMaxScrollOffset());
+}
+
+float
+GridView::GetScrollOffset()
+{
+	return m_pImpl->offset;
+}
+
+float
+GridView::GetMaxScrollOffset()
+{
+	if (!m_pImpl->source)
+		return 0.0f;
+
+	int columns = GetColumns();
+	int rows = (m_pImpl->source->GetItemCount() + columns - 1) / columns;
+	int contentHeight = rows * m_pImpl->cellHeight;
+
+	return (contentHeight > m_pImpl->height) ? (float)(contentHeight - m_pImpl->height) : 0.0f;
+}
+
+bool
+GridView::IsScrolling()
+{
+	return m_pImpl->bDragging || (m_pImpl->velocity != 0.0f);
+}
+
+int
+GridView::GetColumns()
+{
+	int columns = m_pImpl->width / m_pImpl->cellWidth;
+
+	return (columns > 0) ? columns : 1;
+}
+
+int
+GridView::GetBoundCellCount()
+{
+	return (int)m_pImpl->bound.size();
+}
+
+int
+GridView::GetCellCount()
+{
+	return (int)(m_pImpl->bound.size() + m_pImpl->pool.size());
+}
+
+bool
+GridView::OnPress(int x, int y)
+{
+	if ((x < m_pImpl->x) || (x >= m_pImpl->x + m_pImpl->width) ||
+		(y < m_pImpl->y) || (y >= m_pImpl->y + m_pImpl->height))
+		return false;
+
+	/** a press catches a running fling */
+	m_pImpl->velocity = 0.0f;
+
+	m_pImpl->bDragging = true;
+	m_pImpl->bMoved = false;
+	m_pImpl->pressX = x;
+	m_pImpl->pressY = y;
+	m_pImpl->pressOffset = m_pImpl->offset;
+
+	MotionSample sample = { Clock::NowNs(), (float)y };
+	m_pImpl->samples.clear();
+	m_pImpl->samples.push_back(sample);
+
+	return true;
+}
+
+void
+GridView::OnMotion(int x, int y)
+{
+	if (!m_pImpl->bDragging)
+		return;
+
+	float dy = (float)(y - m_pImpl->pressY);
+
+	if (!m_pImpl->bMoved && (fabsf(dy) > TAP_SLOP))
+		m_pImpl->bMoved = true;
+
+	if (m_pImpl->bMoved)
+		m_pImpl->offset = Clamp(m_pImpl->pressOffset - dy, 0.0f, GetMaxScrollOffset());
+
+	std::vector<MotionSample> &samples = m_pImpl->samples;
+	if (samples.size() == VELOCITY_SAMPLES)
+		samples.erase(samples.begin());
+
+	MotionSample sample = { Clock::NowNs(), (float)y };
+	samples.push_back(sample);
+}
+
+void
+GridView::OnRelease()
+{
+	if (!m_pImpl->bDragging)
+		return;
+
+	m_pImpl->bDragging = false;
+
+	if (!m_pImpl->bMoved) {
+		int column = (m_pImpl->pressX - m_pImpl->x) / m_pImpl->cellWidth;
+		int row = (int)((m_pImpl->pressY - m_pImpl->y + m_pImpl->offset) / m_pImpl->cellHeight);
+		int index = row * GetColumns() + column;
+
+		if (m_pImpl->source && (column < GetColumns()) && (index < m_pImpl->source->GetItemCount()))
+			m_pImpl->source->OnItemSelected(index);
+
+		return;
+	}
+
+	/** fling velocity from the samples of the last VELOCITY_WINDOW_NS */
+	const std::vector<MotionSample> &samples = m_pImpl->samples;
+	uint64_t now = Clock::NowNs();
+
+	size_t first = samples.size() - 1;
+	while ((first > 0) && (now - samples[first - 1].timeNs <= VELOCITY_WINDOW_NS))
+		first--;
+
+	const MotionSample &a = samples[first];
+	const MotionSample &b = samples.back();
+
+	if ((b.timeNs > a.timeNs) && (now - b.timeNs <= VELOCITY_WINDOW_NS / 2)) {
+		float velocity = -(b.y - a.y) * 1e9f / (float)(b.timeNs - a.timeNs);
+		m_pImpl->velocity = Clamp(velocity, -FLING_MAX_VELOCITY, FLING_MAX_VELOCITY);
+	} else {
+		/** the finger rested before lifting */
+		m_pImpl->velocity = 0.0f;
+	}
+}
+
+void
+GridView::Update(uint64_t nowNs)
+{
+	float dt = m_pImpl->lastUpdateNs ? (float)(nowNs - m_pImpl->lastUpdateNs) / 1e9f : 0.0f;
+	m_pImpl->lastUpdateNs = nowNs;
+
+	/** a stalled frame should not throw the list across the screen */
+	if (dt > 0.1f)
+		dt = 0.1f;
+
+	if (!m_pImpl->bDragging && (m_pImpl->velocity != 0.0f)) {
+		float max = GetMaxScrollOffset();
+
+		m_pImpl->offset += m_pImpl->velocity * dt;
+		m_pImpl->velocity *= expf(-dt / FLING_TIME_CONSTANT);
+
+		if ((m_pImpl->offset <= 0.0f) || (m_pImpl->offset >= max) ||
+			(fabsf(m_pImpl->velocity) < FLING_MIN_VELOCITY)) {
+			m_pImpl->offset = Clamp(m_pImpl->offset, 0.0f, max);
+			m_pImpl->velocity = 0.0f;
+		}
+	}
+
+	UpdateCells();
+}
+
+void
+GridView::UpdateCells()
+{
+	GridViewImpl *impl = m_pImpl;
+
+	if (!impl->source)
+		return;
+
+	int count = impl->source->GetItemCount();
+	int columns = GetColumns();
+	int rows = (count + columns - 1) / columns;
+
+	int firstVisible = (int)(impl->offset / impl->cellHeight);
+	int lastVisible = (int)((impl->offset + impl->height - 1) / impl->cellHeight);
+	if (lastVisible >= rows)
+		lastVisible = rows - 1;
+
+	int firstKeep = firstVisible - impl->prefetchRows;
+	int lastKeep = lastVisible + impl->prefetchRows;
+
+	/** recycle everything outside the prefetch band, compacting in place */
+	size_t kept = 0;
+	for (size_t i = 0; i < impl->bound.size(); i++) {
+		const BoundCell &bound = impl->bound[i];
+		int row = bound.index / columns;
+
+		if ((row < firstKeep) || (row > lastKeep) || (bound.index >= count)) {
+			bound.cell->Unbind();
+			impl->pool.push_back(bound.cell);
+		} else {
+			impl->bound[kept++] = bound;
+		}
+	}
+	impl->bound.resize(kept);
+
+	/** visible cells are bound now, whatever it costs */
+	for (int row = firstVisible; row <= lastVisible; row++) {
+		for (int column = 0; column < columns; column++) {
+			int index = row * columns + column;
+			if (index >= count)
+				break;
+
+			if (!IsBound(impl, index))
+				BindCell(impl, index);
+		}
+	}
+
+	/** prefetch nearest rows first, in the scroll direction, a few per frame */
+	int budget = impl->maxPrefetchPerFrame;
+	for (int distance = 1; (distance <= impl->prefetchRows) && (budget > 0); distance++) {
+		int ahead = (impl->velocity >= 0.0f) ? lastVisible + distance : firstVisible - distance;
+		int behind = (impl->velocity >= 0.0f) ? firstVisible - distance : lastVisible + distance;
+		int candidates[2] = { ahead, behind };
+
+		for (int c = 0; (c < 2) && (budget > 0); c++) {
+			int row = candidates[c];
+			if ((row < 0) || (row >= rows))
+				continue;
+
+			for (int column = 0; (column < columns) && (budget > 0); column++) {
+				int index = row * columns + column;
+				if (index >= count)
+					break;
+
+				if (IsBound(impl, index))
+					continue;
+
+				BindCell(impl, index);
+				budget--;
+			}
+		}
+	}
+
+	/**
+	 * Keep spares for the whole band, rows leaving it are the ones entering
+	 * it next; cells beyond it are left over from a larger viewport.
+	 */
+	while (!impl->pool.empty() && (impl->bound.size() + impl->pool.size() > impl->bandCells)) {
+		delete impl->pool.back();
+		impl->pool.pop_back();
+	}
+}
+
+void
+GridView::Draw()
+{
+	GridViewImpl *impl = m_pImpl;
+
+	Update(impl->window->GetFrameTimeNs());
+
+	if (!impl->source)
+		return;
+
+	int columns = GetColumns();
+	int scroll = (int)floorf(impl->offset + 0.5f);
+
+	/** cells must not bleed out of the view, sprites queued so far are not ours */
+	impl->window->GetRenderer()->Flush();
+
+	impl->window->SetClipRect(impl->x, impl->y, impl->width, impl->height);
+
+	for (size_t i = 0; i < impl->bound.size(); i++) {
+		int row = impl->bound[i].index / columns;
+		int column = impl->bound[i].index % columns;
+		int top = impl->y + row * impl->cellHeight - scroll;
+
+		/** prefetched cells are bound but off screen */
+		if ((top + impl->cellHeight <= impl->y) || (top >= impl->y + impl->height))
+			continue;
+
+		impl->bound[i].cell->Draw(impl->window, impl->x + column * impl->cellWidth, top, impl->cellWidth, impl->cellHeight);
+	}
+
+	impl->window->GetRenderer()->Flush();
+	impl->source->OnFlush();
+
+	impl->window->ResetClipRect();
+}
+
+} // End-of-namespace WLToolKit
+
@@ -0,0 +1,97 @@
+#ifndef WL_TOOLKIT_GRID_VIEW_HPP
+#define WL_TOOLKIT_GRID_VIEW_HPP
+
+#include <stdint.h>
+
+namespace WLToolKit {
+
+class WindowEGL;
+class GridDataSource;
+struct GridViewImpl;
+
+/**
+ * A recycled view for one item. Cells are created by the data source, then
+ * bound and unbound as items scroll in and out of the viewport, so a cell
+ * should keep its heavy resources (textures) across Bind() calls.
+ */
+class GridCell {
+public:
+	GridCell() {}
+	virtual ~GridCell() {}
+
+	virtual void Bind(int index) = 0;
+	virtual void Unbind() {}
+
+	/** x, y is the top-left corner of the cell in window coordinates */
+	virtual void Draw(WindowEGL *window, int x, int y, int width, int height) = 0;
+}; // End-of-class GridCell
+
+class GridDataSource {
+public:
+	virtual ~GridDataSource() {}
+
+	virtual int GetItemCount() = 0;
+	virtual GridCell* CreateCell() = 0;
+
+	virtual void OnItemSelected(int index) {}
+
+	/**
+	 * Called after the cells are drawn while the viewport clip is still set,
+	 * for content the cells batch outside the Renderer (e.g. TextRenderer).
+	 */
+	virtual void OnFlush() {}
+}; // End-of-class GridDataSource
+
+/**
+ * Vertically scrolling grid. Only rows inside the viewport, plus a few
+ * prefetched rows around it, have bound cells; everything else is layout
+ * arithmetic. Scrolling is kinetic and advanced from the window frame time.
+ */
+class GridView {
+public:
+	GridView(WindowEGL *window, int x, int y, int width, int height);
+	virtual ~GridView();
+
+	/** The data source is not owned */
+	void SetDataSource(GridDataSource *source);
+	void SetCellSize(int width, int height);
+
+	/** Moves or resizes the view; bound cells stay bound, the top item stays on top */
+	void SetGeometry(int x, int y, int width, int height);
+
+	/** Rows bound beyond each edge of the viewport */
+	void SetPrefetchRows(int rows);
+
+	/** Prefetch binds allowed per frame, visible cells are always bound */
+	void SetMaxPrefetchPerFrame(int count);
+
+	/** Rebinds every cell, after the data source changed */
+	void ReloadData();
+
+	void ScrollTo(float offset);
+	float GetScrollOffset();
+	float GetMaxScrollOffset();
+	bool IsScrolling();
+
+	int GetColumns();
+	int GetBoundCellCount();
+	int GetCellCount();
+
+	/** Window coordinates; returns false when the press is outside the view */
+	bool OnPress(int x, int y);
+	void OnMotion(int x, int y);
+	void OnRelease();
+
+	void Draw();
+
+protected:
+	void Update(uint64_t nowNs);
+	void UpdateCells();
+
+protected:
+	GridViewImpl *m_pImpl;
+}; // End-of-class GridView
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_GRID_VIEW_HPP */
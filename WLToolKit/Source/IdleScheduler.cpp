@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <vector>
+
+#include "Common.hpp"
+#include "Clock.hpp"
+#include "IdleScheduler.hpp"
+
+namespace WLToolKit {
+
+#define DEFAULT_BUDGET_NS	1000000ULL
+#define DEFAULT_MARGIN_NS	1000000ULL		/** swap, event dispatch and timer wakeup jitter */
+
+struct IdleTask {
+	unsigned int id;
+	IdleScheduler::TaskFunc func;	/** NULL once finished or cancelled */
+	void* data;
+	uint64_t budgetNs;
+	uint64_t costNs;				/** the budget, or what the last call took when it overran */
+	bool bWarned;
+};
+
+struct IdleSchedulerImpl {
+	IdleSchedulerImpl()
+	: nextId(1), marginNs(DEFAULT_MARGIN_NS), pending(0), bRunning(false) {}
+
+	/** in posting order; entries are only removed outside Run(), so indices stay valid during calls */
+	std::vector<IdleTask> queues[IdleScheduler::kNumPriorities];
+
+	unsigned int nextId;
+	uint64_t marginNs;
+	size_t pending;
+	bool bRunning;
+};
+
+static void
+Compact(IdleSchedulerImpl* impl)
+{
+	for (int p = 0; p < IdleScheduler::kNumPriorities; p++) {
+		std::vector<IdleTask>& queue = impl->queues[p];
+		size_t count = 0;
+
+		for (size_t i = 0; i < queue.size(); i++) {
+			if (queue[i].func)
+				queue[count++] = queue[i];
+		}
+
+		queue.resize(count);
+	}
+}
+
+static IdleTask*
+FindTask(IdleSchedulerImpl* impl, unsigned int id)
+{
+	for (int p = 0; p < IdleScheduler::kNumPriorities; p++) {
+		std::vector<IdleTask>& queue = impl->queues[p];
+
+		for (size_t i = 0; i < queue.size(); i++) {
+			if ((queue[i].id == id) && queue[i].func)
+				return &queue[i];
+		}
+	}
+
+	return NULL;
+}
+
+IdleScheduler::IdleScheduler()
+{
+	m_pImpl = new IdleSchedulerImpl;
+
+	const char* margin = getenv("WLTK_IDLE_MARGIN_US");
+	if (margin && (margin[0] != '\0'))
+		m_pImpl->marginNs = (uint64_t)atoi(margin) * 1000ULL;
+}
+
+IdleScheduler::~IdleScheduler()
+{
+	delete m_pImpl;
+}
+
+unsigned int
+IdleScheduler::Post(TaskFunc func, void* data, Priority priority, uint64_t budgetNs)
+{
+	assert(func);
+	assert((priority >= 0) && (priority < kNumPriorities));
+
+	IdleTask task;
+	task.id = m_pImpl->nextId++;
+	task.func = func;
+	task.data = data;
+	task.budgetNs = budgetNs ? budgetNs : DEFAULT_BUDGET_NS;
+	task.costNs = task.budgetNs;
+	task.bWarned = false;
+
+	/** 0 means no task */
+	if (m_pImpl->nextId == 0)
+		m_pImpl->nextId = 1;
+
+	m_pImpl->queues[priority].push_back(task);
+	m_pImpl->pending++;
+
+	return task.id;
+}
+
+bool
+IdleScheduler::Cancel(unsigned int id)
+{
+	IdleTask* task = FindTask(m_pImpl, id);
+	if (!task)
+		return false;
+
+	task->func = NULL;
+	m_pImpl->pending--;
+
+	if (!m_pImpl->bRunning)
+		Compact(m_pImpl);
+
+	return true;
+}
+
+void
+IdleScheduler::CancelAll(void* data)
+{
+	for (int p = 0; p < kNumPriorities; p++) {
+		std::vector<IdleTask>& queue = m_pImpl->queues[p];
+
+		for (size_t i = 0; i < queue.size(); i++) {
+			if (queue[i].func && (queue[i].data == data)) {
+				queue[i].func = NULL;
+				m_pImpl->pending--;
+			}
+		}
+	}
+
+	if (!m_pImpl->bRunning)
+		Compact(m_pImpl);
+}
+
+size_t
+IdleScheduler::GetPendingCount()
+{
+	return m_pImpl->pending;
+}
+
+uint64_t
+IdleScheduler::Run(uint64_t deadlineNs)
+{
+	IdleSchedulerImpl* impl = m_pImpl;
+
+	/** a task that runs the loop of its own gets no nested calls */
+	if (!impl->pending || impl->bRunning)
+		return 0;
+
+	uint64_t start = Clock::NowNs();
+	if (deadlineNs < start + impl->marginNs)
+		return 0;
+
+	uint64_t end = deadlineNs - impl->marginNs;
+
+	impl->bRunning = true;
+
+	for (int p = 0; p < kNumPriorities; p++) {
+		/** tasks posted by tasks are appended, and called in this pass when they fit */
+		for (size_t i = 0; i < impl->queues[p].size(); i++) {
+			uint64_t now = Clock::NowNs();
+			if (now >= end)
+				break;
+
+			IdleTask& task = impl->queues[p][i];
+			if (!task.func)
+				continue;
+
+			/**
+			 * A larger task may not fit where a smaller one after it still
+			 * does. An overrun halves back towards the budget each time it
+			 * holds the task back, so one slow call does not park it forever.
+			 */
+			if (now + task.costNs > end) {
+				task.costNs = std::max(task.budgetNs, (task.costNs + task.budgetNs) / 2);
+				continue;
+			}
+
+			TaskFunc func = task.func;
+			void* data = task.data;
+			uint64_t budgetNs = task.budgetNs;
+
+			bool bDone = func(data, std::min(now + budgetNs, end));
+
+			uint64_t cost = Clock::NowNs() - now;
+
+			/** the call may have posted, the queue may have moved */
+			IdleTask& called = impl->queues[p][i];
+
+			/** working up to the deadline overshoots it a little */
+			if ((cost > budgetNs + budgetNs / 4) && !called.bWarned) {
+				fprintf(stderr, "[WLToolKit] WARN: idle task %u took %.2f ms of a %.2f ms budget\n",
+					called.id, cost / 1000000.0, budgetNs / 1000000.0);
+				called.bWarned = true;
+			}
+
+			called.costNs = std::max(budgetNs, cost);
+
+			/** it may have cancelled itself */
+			if (bDone && called.func) {
+				called.func = NULL;
+				impl->pending--;
+			}
+		}
+	}
+
+	impl->bRunning = false;
+
+	Compact(impl);
+
+	return Clock::NowNs() - start;
+}
+
+} // End-of-namespace WLToolKit
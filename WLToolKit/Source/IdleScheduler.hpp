@@ -0,0 +1,67 @@
+#ifndef WL_TOOLKIT_IDLE_SCHEDULER_HPP
+#define WL_TOOLKIT_IDLE_SCHEDULER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace WLToolKit {
+
+struct IdleSchedulerImpl;
+
+/**
+ * Runs work nothing is waiting for (preloading, building caches, layout,
+ * releasing evicted resources) in the slack between a window's frames.
+ *
+ * WindowEGL calls Run() after the swap, and again while the FrameScheduler
+ * holds the next render start back, with the time the next frame is
+ * expected to start. Tasks run highest priority first, oldest first within
+ * a priority, and a task is only started while its cost still fits before
+ * that deadline less a safety margin. Its cost is the budget it was posted
+ * with, raised for a while after a call took longer.
+ *
+ * A task gets at most one call per Run(), told when its budget ends; it
+ * returns false to be called again after a later frame. Tasks that do not
+ * fit stay queued as well. They run on the main thread with the window's
+ * GL context current; whatever is pending when the window goes away is
+ * dropped without a call.
+ *
+ * Runtime switches:
+ *   WLTK_IDLE_MARGIN_US=n    left free before the next frame, 1000 by default
+ */
+class IdleScheduler {
+public:
+	enum Priority {
+		kPriorityHigh,
+		kPriorityNormal,
+		kPriorityLow,
+
+		kNumPriorities
+	};
+
+	/** deadlineNs is CLOCK_MONOTONIC; true when the task is done */
+	typedef bool (*TaskFunc)(void* data, uint64_t deadlineNs);
+
+	IdleScheduler();
+	virtual ~IdleScheduler();
+
+	/** budgetNs is the longest one call should take, 0 for 1 ms; returns the id for Cancel(), never 0 */
+	unsigned int Post(TaskFunc func, void* data, Priority priority = kPriorityNormal, uint64_t budgetNs = 0);
+
+	/** false when the task already finished */
+	bool Cancel(unsigned int id);
+
+	/** Every task posted with data, for owners going away */
+	void CancelAll(void* data);
+
+	size_t GetPendingCount();
+
+	/** Calls tasks until deadlineNs (CLOCK_MONOTONIC) less the margin; returns the time spent */
+	uint64_t Run(uint64_t deadlineNs);
+
+protected:
+	IdleSchedulerImpl* m_pImpl;
+}; // End-of-class IdleScheduler
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_IDLE_SCHEDULER_HPP */
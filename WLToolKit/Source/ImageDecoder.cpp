@@ -0,0 +1,667 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "Common.hpp"
+#include "ImageDecoder.hpp"
+
+#if defined(HAVE_JPEG)
+#include <setjmp.h>
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+#if defined(HAVE_WEBP)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+#include <webp/decode.h>
+}
+#endif
+
+namespace WLToolKit {
+
+static std::vector<ImageDecoder*> s_decoders;
+
+/** cairo_image_surface_create_from_png(), swizzled from cairo's BGRA */
+class PngDecoder : public ImageDecoder {
+public:
+	virtual const char* GetName() { return "png"; }
+
+	virtual bool Probe(const unsigned char* header, size_t size) {
+		return (size >= 8) && (memcmp(header, "\x89PNG\r\n\x1a\n", 8) == 0);
+	}
+
+	virtual bool Decode(const char* path, int minWidth, int minHeight, DecodedImage* image) {
+		cairo_surface_t* surface = cairo_image_surface_create_from_png(path);
+
+		cairo_format_t format = cairo_image_surface_get_format(surface);
+		if ((format != CAIRO_FORMAT_ARGB32) && (format != CAIRO_FORMAT_RGB24)) {
+			fprintf(stderr, "[WLToolKit] ERR: format(%d) is not supported\n", format);
+			cairo_surface_destroy(surface);
+			return false;
+		}
+
+		if (!AllocatePixels(image, cairo_image_surface_get_width(surface), cairo_image_surface_get_height(surface))) {
+			cairo_surface_destroy(surface);
+			return false;
+		}
+
+		image->bOpaque = (format == CAIRO_FORMAT_RGB24);
+
+		const unsigned char* data = cairo_image_surface_get_data(surface);
+		int stride = cairo_image_surface_get_stride(surface);
+
+		for (int y = 0; y < image->height; y++) {
+			const unsigned char* src = data + (size_t)y * stride;
+			unsigned char* dst = image->pixels + (size_t)y * image->width * 4;
+
+			for (int x = 0; x < image->width; x++, src += 4, dst += 4) {
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = src[3];
+			}
+		}
+
+		cairo_surface_destroy(surface);
+
+		return true;
+	}
+}; // End-of-class PngDecoder
+
+#if defined(HAVE_JPEG)
+struct JpegError {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jump;
+};
+
+static void
+_JpegErrorExit(j_common_ptr cinfo)
+{
+	char message[JMSG_LENGTH_MAX];
+
+	(*cinfo->err->format_message)(cinfo, message);
+	fprintf(stderr, "[WLToolKit] ERR: jpeg: %s\n", message);
+
+	longjmp(((JpegError*)cinfo->err)->jump, 1);
+}
+
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER)
+/**
+ * One decompression kept open between reads. jpeg_crop_scanline() limits
+ * the IDCT to the iMCU columns of the read that started it, and
+ * jpeg_skip_scanlines() passes the rows above a read without it. A read
+ * further up, or outside those columns, starts over at the top of the
+ * file: the entropy coded rows above it can not be skipped.
+ */
+class JpegRegionReader : public ImageRegionReader {
+public:
+	JpegRegionReader() : m_fp(NULL), m_bStarted(false), m_cropX(0), m_cropWidth(0) {}
+
+	virtual ~JpegRegionReader() {
+		Close();
+	}
+
+	/** Reads the header, false for files that are not baseline or broken */
+	bool Open(const char* path, int* width, int* height) {
+		m_fp = fopen(path, "rb");
+		if (!m_fp)
+			return false;
+
+		m_cinfo.err = jpeg_std_error(&m_error.mgr);
+		m_error.mgr.error_exit = _JpegErrorExit;
+
+		if (setjmp(m_error.jump)) {
+			Close();
+			return false;
+		}
+
+		jpeg_create_decompress(&m_cinfo);
+		jpeg_stdio_src(&m_cinfo, m_fp);
+		jpeg_read_header(&m_cinfo, TRUE);
+
+		if (m_cinfo.progressive_mode) {
+			Close();
+			return false;
+		}
+
+		*width = (int)m_cinfo.image_width;
+		*height = (int)m_cinfo.image_height;
+
+		return true;
+	}
+
+	virtual bool Read(int x, int y, int width, int height, unsigned char* pixels, size_t stride) {
+		if (!m_fp)
+			return false;
+
+		/** a failed read closes the reader; nothing with a destructor lives between here and a longjmp() */
+		if (setjmp(m_error.jump)) {
+			Close();
+			return false;
+		}
+
+		if (!m_bStarted || (y < (int)m_cinfo.output_scanline) || (x < m_cropX) || (x + width > m_cropX + m_cropWidth))
+			Start(x, width);
+
+		if (y > (int)m_cinfo.output_scanline)
+			jpeg_skip_scanlines(&m_cinfo, (JDIMENSION)(y - (int)m_cinfo.output_scanline));
+
+		int offset = x - m_cropX;
+
+		for (int row = 0; row < height; row++) {
+			unsigned char* line = &m_row[0];
+			unsigned char* dst = pixels + (size_t)row * stride;
+
+			jpeg_read_scanlines(&m_cinfo, &line, 1);
+
+#if defined(JCS_ALPHA_EXTENSIONS)
+			memcpy(dst, line + offset * 4, (size_t)width * 4);
+#else
+			for (int i = 0; i < width; i++) {
+				dst[i * 4 + 0] = line[(offset + i) * 3 + 0];
+				dst[i * 4 + 1] = line[(offset + i) * 3 + 1];
+				dst[i * 4 + 2] = line[(offset + i) * 3 + 2];
+				dst[i * 4 + 3] = 0xff;
+			}
+#endif
+		}
+
+		return true;
+	}
+
+protected:
+	/** From the top of the file, decoding the columns x to x + width */
+	void Start(int x, int width) {
+		if (m_bStarted) {
+			jpeg_abort_decompress(&m_cinfo);
+			rewind(m_fp);
+			jpeg_stdio_src(&m_cinfo, m_fp);
+			jpeg_read_header(&m_cinfo, TRUE);
+		}
+
+#if defined(JCS_ALPHA_EXTENSIONS)
+		m_cinfo.out_color_space = JCS_EXT_RGBA;
+#else
+		m_cinfo.out_color_space = JCS_RGB;
+#endif
+
+		jpeg_start_decompress(&m_cinfo);
+		m_bStarted = true;
+
+		/** widened to iMCU boundaries, Read() cuts off the columns left of x */
+		JDIMENSION cropX = (JDIMENSION)x;
+		JDIMENSION cropWidth = (JDIMENSION)width;
+		jpeg_crop_scanline(&m_cinfo, &cropX, &cropWidth);
+
+		m_cropX = (int)cropX;
+		m_cropWidth = (int)cropWidth;
+		m_row.resize((size_t)m_cropWidth * 4);
+	}
+
+	void Close() {
+		if (!m_fp)
+			return;
+
+		jpeg_destroy_decompress(&m_cinfo);
+		fclose(m_fp);
+		m_fp = NULL;
+	}
+
+	FILE* m_fp;
+	struct jpeg_decompress_struct m_cinfo;
+	JpegError m_error;
+	bool m_bStarted;
+	int m_cropX;
+	int m_cropWidth;
+	std::vector<unsigned char> m_row;		/** one scanline of the cropped columns */
+}; // End-of-class JpegRegionReader
+#endif
+
+/**
+ * libjpeg-turbo. The IDCT scales by 1/2, 1/4 or 1/8 for free, which is
+ * most of the work for a wallpaper shown smaller than the photo.
+ */
+class JpegDecoder : public ImageDecoder {
+public:
+	virtual const char* GetName() { return "jpeg"; }
+
+	virtual bool Probe(const unsigned char* header, size_t size) {
+		return (size >= 3) && (header[0] == 0xff) && (header[1] == 0xd8) && (header[2] == 0xff);
+	}
+
+	virtual bool Decode(const char* path, int minWidth, int minHeight, DecodedImage* image) {
+		FILE* fp = fopen(path, "rb");
+		if (!fp)
+			return false;
+
+		struct jpeg_decompress_struct cinfo;
+		JpegError error;
+
+		cinfo.err = jpeg_std_error(&error.mgr);
+		error.mgr.error_exit = _JpegErrorExit;
+
+		/** nothing with a destructor lives between here and a longjmp() */
+		if (setjmp(error.jump)) {
+			jpeg_destroy_decompress(&cinfo);
+			fclose(fp);
+
+			delete[] image->pixels;
+			image->pixels = NULL;
+			return false;
+		}
+
+		jpeg_create_decompress(&cinfo);
+		jpeg_stdio_src(&cinfo, fp);
+		jpeg_read_header(&cinfo, TRUE);
+
+		/** the largest 1/N still giving the caller enough pixels, full size without a minimum */
+		cinfo.scale_num = 1;
+		cinfo.scale_denom = 1;
+		for (unsigned int denom = 8; (minWidth > 0) && (minHeight > 0) && (denom > 1); denom /= 2) {
+			if (((int)((cinfo.image_width + denom - 1) / denom) >= minWidth) &&
+				((int)((cinfo.image_height + denom - 1) / denom) >= minHeight)) {
+				cinfo.scale_denom = denom;
+				break;
+			}
+		}
+
+#if defined(JCS_ALPHA_EXTENSIONS)
+		cinfo.out_color_space = JCS_EXT_RGBA;
+#else
+		cinfo.out_color_space = JCS_RGB;
+#endif
+
+		jpeg_start_decompress(&cinfo);
+
+		/** JPEG_MAX_DIMENSION keeps both sides well inside an int */
+		if (!AllocatePixels(image, (int)cinfo.output_width, (int)cinfo.output_height)) {
+			jpeg_destroy_decompress(&cinfo);
+			fclose(fp);
+			return false;
+		}
+
+		image->bOpaque = true;
+
+		while (cinfo.output_scanline < cinfo.output_height) {
+			unsigned char* row = image->pixels + (size_t)cinfo.output_scanline * image->width * 4;
+
+			jpeg_read_scanlines(&cinfo, &row, 1);
+
+#if !defined(JCS_ALPHA_EXTENSIONS)
+			/** RGB was read into the start of the row, spread it out from the end */
+			for (int x = image->width - 1; x >= 0; x--) {
+				row[x * 4 + 3] = 0xff;
+				row[x * 4 + 2] = row[x * 3 + 2];
+				row[x * 4 + 1] = row[x * 3 + 1];
+				row[x * 4 + 0] = row[x * 3 + 0];
+			}
+#endif
+		}
+
+		jpeg_finish_decompress(&cinfo);
+		jpeg_destroy_decompress(&cinfo);
+		fclose(fp);
+
+		return true;
+	}
+
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER)
+	/** Progressive files buffer all of their coefficients on start, they are decoded whole */
+	virtual ImageRegionReader* OpenRegions(const char* path, int* width, int* height, bool* bOpaque) {
+		JpegRegionReader* reader = new JpegRegionReader();
+
+		if (!reader->Open(path, width, height)) {
+			delete reader;
+			return NULL;
+		}
+
+		*bOpaque = true;
+
+		return reader;
+	}
+#endif
+}; // End-of-class JpegDecoder
+#endif
+
+#if defined(HAVE_WEBP)
+/** Reads all of path, false if it can not be opened */
+static bool
+ReadFile(const char* path, std::vector<unsigned char>* data)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (size > 0) {
+		data->resize(size);
+		size = (long)fread(&(*data)[0], 1, size, fp);
+		data->resize(size);
+	}
+
+	fclose(fp);
+
+	return !data->empty();
+}
+
+/**
+ * The file stays mapped, not read, and every read crops it. libwebp still
+ * decodes the macroblock rows above a crop, and crops from even offsets
+ * only in some versions; odd ones go through m_region.
+ */
+class WebPRegionReader : public ImageRegionReader {
+public:
+	WebPRegionReader() : m_data(MAP_FAILED), m_size(0) {}
+
+	virtual ~WebPRegionReader() {
+		if (m_data != MAP_FAILED)
+			munmap(m_data, m_size);
+	}
+
+	/** Animations are not read in regions */
+	bool Open(const char* path, int* width, int* height, bool* bOpaque) {
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+			m_size = (size_t)st.st_size;
+			m_data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+
+		WebPBitstreamFeatures features;
+		if ((m_data == MAP_FAILED) || (WebPGetFeatures((const uint8_t*)m_data, m_size, &features) != VP8_STATUS_OK) || features.has_animation)
+			return false;
+
+		*width = features.width;
+		*height = features.height;
+		*bOpaque = !features.has_alpha;
+
+		return true;
+	}
+
+	virtual bool Read(int x, int y, int width, int height, unsigned char* pixels, size_t stride) {
+		WebPDecoderConfig config;
+		if (!WebPInitDecoderConfig(&config))
+			return false;
+
+		int left = x & ~1;
+		int top = y & ~1;
+		int cropWidth = width + (x - left);
+		int cropHeight = height + (y - top);
+		bool bDirect = (left == x) && (top == y);
+
+		if (!bDirect)
+			m_region.resize((size_t)cropWidth * cropHeight * 4);
+
+		config.options.use_cropping = 1;
+		config.options.crop_left = left;
+		config.options.crop_top = top;
+		config.options.crop_width = cropWidth;
+		config.options.crop_height = cropHeight;
+
+		config.output.colorspace = MODE_rgbA;
+		config.output.is_external_memory = 1;
+		config.output.u.RGBA.rgba = bDirect ? pixels : &m_region[0];
+		config.output.u.RGBA.stride = bDirect ? (int)stride : cropWidth * 4;
+		config.output.u.RGBA.size = bDirect ? stride * (height - 1) + (size_t)width * 4 : m_region.size();
+
+		VP8StatusCode status = WebPDecode((const uint8_t*)m_data, m_size, &config);
+		WebPFreeDecBuffer(&config.output);
+
+		if (status != VP8_STATUS_OK) {
+			fprintf(stderr, "[WLToolKit] ERR: webp: decoding %dx%d at %d,%d failed (%d)\n", width, height, x, y, status);
+			return false;
+		}
+
+		if (!bDirect) {
+			for (int row = 0; row < height; row++) {
+				memcpy(pixels + (size_t)row * stride,
+					&m_region[((size_t)(row + y - top) * cropWidth + (x - left)) * 4], (size_t)width * 4);
+			}
+		}
+
+		return true;
+	}
+
+protected:
+	void* m_data;
+	size_t m_size;
+	std::vector<unsigned char> m_region;	/** the even aligned crop of an odd read */
+}; // End-of-class WebPRegionReader
+
+/** libwebp, premultiplied by the decoder itself */
+class WebPDecoder : public ImageDecoder {
+public:
+	virtual const char* GetName() { return "webp"; }
+
+	virtual bool Probe(const unsigned char* header, size_t size) {
+		return (size >= 12) && (memcmp(header, "RIFF", 4) == 0) && (memcmp(header + 8, "WEBP", 4) == 0);
+	}
+
+	virtual bool Decode(const char* path, int minWidth, int minHeight, DecodedImage* image) {
+		std::vector<unsigned char> data;
+		if (!ReadFile(path, &data))
+			return false;
+
+		WebPDecoderConfig config;
+		if (!WebPInitDecoderConfig(&config))
+			return false;
+
+		if (WebPGetFeatures(&data[0], data.size(), &config.input) != VP8_STATUS_OK) {
+			fprintf(stderr, "[WLToolKit] ERR: webp: %s is broken\n", path);
+			return false;
+		}
+
+		if (!AllocatePixels(image, config.input.width, config.input.height))
+			return false;
+
+		image->bOpaque = !config.input.has_alpha;
+
+		config.output.colorspace = MODE_rgbA;
+		config.output.is_external_memory = 1;
+		config.output.u.RGBA.rgba = image->pixels;
+		config.output.u.RGBA.stride = image->width * 4;
+		config.output.u.RGBA.size = (size_t)image->width * image->height * 4;
+		config.options.use_threads = 1;
+
+		VP8StatusCode status = WebPDecode(&data[0], data.size(), &config);
+		WebPFreeDecBuffer(&config.output);
+
+		if (status != VP8_STATUS_OK) {
+			fprintf(stderr, "[WLToolKit] ERR: webp: decoding %s failed (%d)\n", path, status);
+			delete[] image->pixels;
+			image->pixels = NULL;
+			return false;
+		}
+
+		return true;
+	}
+
+	virtual ImageRegionReader* OpenRegions(const char* path, int* width, int* height, bool* bOpaque) {
+		WebPRegionReader* reader = new WebPRegionReader();
+
+		if (!reader->Open(path, width, height, bOpaque)) {
+			delete reader;
+			return NULL;
+		}
+
+		return reader;
+	}
+}; // End-of-class WebPDecoder
+#endif
+
+static PngDecoder s_png;
+#if defined(HAVE_JPEG)
+static JpegDecoder s_jpeg;
+#endif
+#if defined(HAVE_WEBP)
+static WebPDecoder s_webp;
+#endif
+
+static ImageDecoder* const s_builtins[] = {
+	&s_png,
+#if defined(HAVE_JPEG)
+	&s_jpeg,
+#endif
+#if defined(HAVE_WEBP)
+	&s_webp,
+#endif
+};
+
+void
+ImageDecoder::Register(ImageDecoder* decoder)
+{
+	if (std::find(s_decoders.begin(), s_decoders.end(), decoder) == s_decoders.end())
+		s_decoders.push_back(decoder);
+}
+
+void
+ImageDecoder::Unregister(ImageDecoder* decoder)
+{
+	s_decoders.erase(std::remove(s_decoders.begin(), s_decoders.end(), decoder), s_decoders.end());
+}
+
+ImageDecoder*
+ImageDecoder::Find(const char* path)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+
+	unsigned char header[kHeaderSize];
+	size_t size = fread(header, 1, sizeof(header), fp);
+	fclose(fp);
+
+	for (size_t i = 0; i < s_decoders.size(); i++) {
+		if (s_decoders[i]->Probe(header, size))
+			return s_decoders[i];
+	}
+
+	for (size_t i = 0; i < sizeof(s_builtins) / sizeof(s_builtins[0]); i++) {
+		if (s_builtins[i]->Probe(header, size))
+			return s_builtins[i];
+	}
+
+	return NULL;
+}
+
+bool
+ImageDecoder::Load(const char* path, int minWidth, int minHeight, DecodedImage* image)
+{
+	ImageDecoder* decoder = Find(path);
+	if (!decoder) {
+		fprintf(stderr, "[WLToolKit] ERR: no decoder for %s\n", path);
+		return false;
+	}
+
+	if (!decoder->Decode(path, minWidth, minHeight, image)) {
+		fprintf(stderr, "[WLToolKit] ERR: %s decoder failed on %s\n", decoder->GetName(), path);
+		return false;
+	}
+
+	if (image->bStraightAlpha && !image->bOpaque)
+		Premultiply(image->pixels, (size_t)image->width * image->height);
+
+	image->bStraightAlpha = false;
+
+	return true;
+}
+
+bool
+ImageDecoder::AllocatePixels(DecodedImage* image, int width, int height)
+{
+	if ((width <= 0) || (height <= 0) || ((size_t)width > (size_t)-1 / 4 / (size_t)height)) {
+		fprintf(stderr, "[WLToolKit] ERR: image size %dx%d can not be allocated\n", width, height);
+		return false;
+	}
+
+	image->pixels = new (std::nothrow) unsigned char[(size_t)width * height * 4];
+	if (!image->pixels) {
+		fprintf(stderr, "[WLToolKit] ERR: out of memory for a %dx%d image\n", width, height);
+		return false;
+	}
+
+	image->width = width;
+	image->height = height;
+
+	return true;
+}
+
+/** c * a / 255, rounded; exact for all 8 bit inputs */
+static inline unsigned char
+MultiplyAlpha(unsigned int c, unsigned int a)
+{
+	unsigned int t = c * a + 128;
+
+	return (unsigned char)((t + (t >> 8)) >> 8);
+}
+
+void
+ImageDecoder::Premultiply(unsigned char* pixels, size_t count)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(128);
+
+	/** alpha times 255 is alpha again, so alpha rides along with the colors */
+	const __m128i keepAlpha = _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i px = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+		__m128i lo = _mm_unpacklo_epi8(px, zero);
+		__m128i hi = _mm_unpackhi_epi8(px, zero);
+
+		__m128i alo = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff), keepAlpha);
+		__m128i ahi = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff), keepAlpha);
+
+		lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), bias);
+		hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), bias);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+		_mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t px = vld4_u8(pixels + i * 4);
+
+		for (int c = 0; c < 3; c++) {
+			uint16x8_t t = vmull_u8(px.val[c], px.val[3]);
+
+			px.val[c] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+		}
+
+		vst4_u8(pixels + i * 4, px);
+	}
+#endif
+
+	for (; i < count; i++) {
+		unsigned char* p = pixels + i * 4;
+
+		p[0] = MultiplyAlpha(p[0], p[3]);
+		p[1] = MultiplyAlpha(p[1], p[3]);
+		p[2] = MultiplyAlpha(p[2], p[3]);
+	}
+}
+
+} // End-of-namespace WLToolKit
@@ -0,0 +1,99 @@
+#ifndef WL_TOOLKIT_IMAGE_DECODER_HPP
+#define WL_TOOLKIT_IMAGE_DECODER_HPP
+
+#include <stddef.h>
+
+namespace WLToolKit {
+
+/** What every decoder produces: the layout Texture uploads */
+struct DecodedImage {
+	DecodedImage() : pixels(NULL), width(0), height(0), bOpaque(false), bStraightAlpha(false) {}
+
+	unsigned char* pixels;		/** RGBA, premultiplied, tight rows; new[], the caller's */
+	int width;
+	int height;
+	bool bOpaque;				/** the file has no alpha channel */
+	bool bStraightAlpha;		/** set by a decoder that could not premultiply, Load() does it */
+};
+
+/**
+ * Decodes rectangles of one image file, for images too large to keep
+ * decoded. A read further down than the last one, over the same or fewer
+ * columns, carries on where that one stopped; others may start over at
+ * the top of the file.
+ */
+class ImageRegionReader {
+public:
+	virtual ~ImageRegionReader() {}
+
+	/** The width x height pixels at x, y, premultiplied RGBA rows stride bytes apart */
+	virtual bool Read(int x, int y, int width, int height, unsigned char* pixels, size_t stride) = 0;
+}; // End-of-class ImageRegionReader
+
+/**
+ * Image file decoders, chosen by the first bytes of the file rather than
+ * its name.
+ *
+ * Everything leaves Load() premultiplied, the toolkit's only alpha format
+ * (see Renderer). A decoder whose library hands out straight alpha sets
+ * bStraightAlpha instead of converting on its own.
+ *
+ * PNG goes through cairo and is always there. JPEG (libjpeg-turbo) and
+ * WebP (libwebp) are built with HAVE_JPEG and HAVE_WEBP, see Makefile.am;
+ * both write straight into the final buffer, and JPEG shrinks by up to
+ * 8 times while decoding when the caller needs fewer pixels. Both also
+ * read parts of a file through an ImageRegionReader (baseline JPEG with
+ * libjpeg-turbo 2.0 or later), which TiledTexture uses to keep only its
+ * tiles in memory.
+ */
+class ImageDecoder {
+public:
+	enum {
+		kHeaderSize = 16		/** bytes Probe() gets to look at */
+	};
+
+	virtual ~ImageDecoder() {}
+
+	virtual const char* GetName() = 0;
+
+	/** header is the start of the file, size is less than kHeaderSize for tiny files */
+	virtual bool Probe(const unsigned char* header, size_t size) = 0;
+
+	/**
+	 * minWidth x minHeight are the fewest pixels the caller can use, 0 for
+	 * the full size. A decoder may return anything between that and the
+	 * full size.
+	 */
+	virtual bool Decode(const char* path, int minWidth, int minHeight, DecodedImage* image) = 0;
+
+	/**
+	 * A reader for path, the caller's to delete, with the size and alpha
+	 * from the file header. NULL, the default, when the decoder can only
+	 * decode all of the file.
+	 */
+	virtual ImageRegionReader* OpenRegions(const char* path, int* width, int* height, bool* bOpaque) { return NULL; }
+
+	/** Asked before the built-in decoders, in the order registered; not owned */
+	static void Register(ImageDecoder* decoder);
+	static void Unregister(ImageDecoder* decoder);
+
+	/** NULL if the file can not be read or no decoder knows it */
+	static ImageDecoder* Find(const char* path);
+
+	/** Find() and Decode(), false with a message on stderr */
+	static bool Load(const char* path, int minWidth, int minHeight, DecodedImage* image);
+
+	/**
+	 * Sets the size and allocates the pixels of image, for decoders. False
+	 * with a message on stderr when the size is empty, does not fit a
+	 * size_t, or the allocation fails.
+	 */
+	static bool AllocatePixels(DecodedImage* image, int width, int height);
+
+	/** Straight to premultiplied RGBA in place, count pixels; SSE2 or NEON where available */
+	static void Premultiply(unsigned char* pixels, size_t count);
+}; // End-of-class ImageDecoder
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_IMAGE_DECODER_HPP */
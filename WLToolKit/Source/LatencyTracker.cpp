@@ -0,0 +1,298 @@
+#include <signal.h>
+
+#include <algorithm>
+#include <string>
+
+#include "Common.hpp"
+#include "Clock.hpp"
+#include "LatencyTracker.hpp"
+
+namespace WLToolKit {
+
+#define MAX_FRAMES_IN_FLIGHT	8
+#define MAX_FRAME_EVENTS		64		/** per frame, more input is counted as dropped */
+#define SAME_CLOCK_WINDOW_MS	1000	/** input timestamps this close to now share our clock */
+
+struct LatencyEvent {
+	Window::InputType type;
+	uint64_t timeNs;
+};
+
+/** oldest first */
+struct LatencyEvents {
+	LatencyEvent events[MAX_FRAME_EVENTS];
+	int count;
+};
+
+struct LatencyFrame {
+	unsigned int frame;
+	unsigned int sequence;		/** commit order, 0 for a free slot */
+	LatencyEvents events;
+};
+
+/** Fixed storage, input arriving every frame must not allocate */
+struct LatencyTrackerImpl {
+	LatencyTrackerImpl() : nextSequence(1), dropped(0), bDump(false) {
+		pending.count = 0;
+
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			inFlight[i].sequence = 0;
+	}
+
+	LatencyTracker::Histogram histograms[Window::kNumInputTypes];
+
+	LatencyEvents pending;
+	LatencyFrame inFlight[MAX_FRAMES_IN_FLIGHT];
+	unsigned int nextSequence;
+
+	/** events that found the pending list full */
+	unsigned int dropped;
+
+	bool bDump;
+	std::string dumpPath;
+};
+
+static const char* s_inputNames[Window::kNumInputTypes] = {
+	"pointer-button",
+	"pointer-motion",
+	"touch-down",
+	"touch-motion",
+	"touch-up",
+};
+
+static volatile sig_atomic_t s_dumpRequested = 0;
+
+static void
+_DumpSignalHandler(int signum)
+{
+	s_dumpRequested = 1;
+}
+
+LatencyTracker::LatencyTracker()
+{
+	m_pImpl = new LatencyTrackerImpl;
+
+	Reset();
+
+	const char* env = getenv("WLTK_LATENCY");
+	if (env && (env[0] != '\0') && (env[0] != '0')) {
+		m_pImpl->bDump = true;
+		if (strcmp(env, "1") != 0)
+			m_pImpl->dumpPath = env;
+
+		signal(SIGUSR1, _DumpSignalHandler);
+	}
+}
+
+LatencyTracker::~LatencyTracker()
+{
+	if (m_pImpl->bDump) {
+		s_dumpRequested = 1;
+		DumpIfRequested();
+	}
+
+	delete m_pImpl;
+}
+
+void
+LatencyTracker::AddEvent(Window::InputType type, uint32_t time)
+{
+	uint64_t now = Clock::NowNs();
+
+	/**
+	 * wl_input timestamps are milliseconds of an unspecified clock; weston
+	 * uses CLOCK_MONOTONIC. When the stamp is close to our own monotonic
+	 * time use it, otherwise fall back to when the event was dispatched.
+	 */
+	uint32_t nowMs = (uint32_t)(now / 1000000ULL);
+	uint32_t ageMs = nowMs - time;
+
+	LatencyEvent event;
+	event.type = type;
+	event.timeNs = (ageMs < SAME_CLOCK_WINDOW_MS) ? now - (uint64_t)ageMs * 1000000ULL : now;
+
+	LatencyEvents& pending = m_pImpl->pending;
+
+	if (pending.count == MAX_FRAME_EVENTS) {
+		m_pImpl->dropped++;
+		return;
+	}
+
+	pending.events[pending.count++] = event;
+}
+
+void
+LatencyTracker::CommitFrame(unsigned int frame)
+{
+	LatencyEvents& pending = m_pImpl->pending;
+
+	if (pending.count == 0)
+		return;
+
+	/** a free slot, or the oldest one: feedback that never arrives must not hold it forever */
+	LatencyFrame* entry = &m_pImpl->inFlight[0];
+	for (int i = 1; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (m_pImpl->inFlight[i].sequence < entry->sequence)
+			entry = &m_pImpl->inFlight[i];
+	}
+
+	entry->frame = frame;
+	entry->sequence = m_pImpl->nextSequence++;
+	if (m_pImpl->nextSequence == 0)
+		m_pImpl->nextSequence = 1;
+
+	memcpy(entry->events.events, pending.events, pending.count * sizeof(LatencyEvent));
+	entry->events.count = pending.count;
+
+	pending.count = 0;
+}
+
+void
+LatencyTracker::DropPending()
+{
+	m_pImpl->pending.count = 0;
+}
+
+void
+LatencyTracker::OnPresented(unsigned int frame, uint64_t presentNs)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		LatencyFrame& entry = m_pImpl->inFlight[i];
+
+		if ((entry.sequence == 0) || (entry.frame != frame))
+			continue;
+
+		const LatencyEvents& events = entry.events;
+
+		if (!presentNs) {
+			/** a newer commit replaced this one, the input shows up there; ahead of the newer events */
+			LatencyEvents& pending = m_pImpl->pending;
+			int kept = std::min(pending.count, MAX_FRAME_EVENTS - events.count);
+
+			memmove(pending.events + events.count, pending.events, kept * sizeof(LatencyEvent));
+			memcpy(pending.events, events.events, events.count * sizeof(LatencyEvent));
+
+			m_pImpl->dropped += pending.count - kept;
+			pending.count = events.count + kept;
+		} else {
+			for (int e = 0; e < events.count; e++) {
+				const LatencyEvent& event = events.events[e];
+				Histogram& h = m_pImpl->histograms[event.type];
+				uint64_t latencyUs = (presentNs > event.timeNs) ? (presentNs - event.timeNs) / 1000ULL : 0;
+
+				h.count++;
+				h.sumUs += latencyUs;
+				if (latencyUs < h.minUs)
+					h.minUs = latencyUs;
+				if (latencyUs > h.maxUs)
+					h.maxUs = latencyUs;
+
+				uint64_t bucket = latencyUs / 1000ULL;
+				if (bucket < kNumBuckets)
+					h.buckets[bucket]++;
+				else
+					h.overflow++;
+			}
+		}
+
+		entry.sequence = 0;
+		break;
+	}
+}
+
+const LatencyTracker::Histogram&
+LatencyTracker::GetHistogram(Window::InputType type)
+{
+	return m_pImpl->histograms[type];
+}
+
+uint64_t
+LatencyTracker::GetPercentileUs(Window::InputType type, float percentile)
+{
+	const Histogram& h = m_pImpl->histograms[type];
+
+	if (h.count == 0)
+		return 0;
+
+	unsigned int rank = (unsigned int)(h.count * percentile / 100.0f);
+	if (rank >= h.count)
+		rank = h.count - 1;
+
+	unsigned int seen = 0;
+	for (int i = 0; i < kNumBuckets; i++) {
+		seen += h.buckets[i];
+		if (seen > rank)
+			return (uint64_t)(i + 1) * 1000ULL;
+	}
+
+	return h.maxUs;
+}
+
+void
+LatencyTracker::Reset()
+{
+	memset(m_pImpl->histograms, 0, sizeof(m_pImpl->histograms));
+	m_pImpl->dropped = 0;
+
+	for (int i = 0; i < Window::kNumInputTypes; i++)
+		m_pImpl->histograms[i].minUs = UINT64_MAX;
+}
+
+void
+LatencyTracker::Dump(FILE* fp)
+{
+	fprintf(fp, "[WLToolKit] input-to-present latency (ms)\n");
+	fprintf(fp, "[WLToolKit]   %-14s %7s %7s %7s %7s %7s %7s\n", "input", "count", "min", "avg", "p50", "p95", "max");
+
+	for (int i = 0; i < Window::kNumInputTypes; i++) {
+		Window::InputType type = (Window::InputType)i;
+		const Histogram& h = m_pImpl->histograms[i];
+
+		if (h.count == 0)
+			continue;
+
+		fprintf(fp, "[WLToolKit]   %-14s %7u %7.1f %7.1f %7.1f %7.1f %7.1f\n",
+			GetInputName(type), h.count,
+			h.minUs / 1000.0, (double)h.sumUs / h.count / 1000.0,
+			GetPercentileUs(type, 50.0f) / 1000.0, GetPercentileUs(type, 95.0f) / 1000.0,
+			h.maxUs / 1000.0);
+	}
+
+	if (m_pImpl->dropped)
+		fprintf(fp, "[WLToolKit]   %u events not recorded, more than %d in a frame\n", m_pImpl->dropped, MAX_FRAME_EVENTS);
+}
+
+void
+LatencyTracker::DumpIfRequested()
+{
+	if (!s_dumpRequested)
+		return;
+
+	s_dumpRequested = 0;
+
+	if (m_pImpl->dumpPath.empty()) {
+		Dump(stderr);
+		return;
+	}
+
+	FILE* fp = fopen(m_pImpl->dumpPath.c_str(), "w");
+	if (!fp) {
+		fprintf(stderr, "[WLToolKit] ERR: cannot open %s\n", m_pImpl->dumpPath.c_str());
+		return;
+	}
+
+	Dump(fp);
+	fclose(fp);
+}
+
+const char*
+LatencyTracker::GetInputName(Window::InputType type)
+{
+	if ((type < 0) || (type >= Window::kNumInputTypes))
+		return "unknown";
+
+	return s_inputNames[type];
+}
+
+} // End-of-namespace WLToolKit
+
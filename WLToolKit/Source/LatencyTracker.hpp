@@ -0,0 +1,76 @@
+#ifndef WL_TOOLKIT_LATENCY_TRACKER_HPP
+#define WL_TOOLKIT_LATENCY_TRACKER_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Window.hpp"
+
+namespace WLToolKit {
+
+struct LatencyTrackerImpl;
+
+/**
+ * Input-to-present latency per input type.
+ *
+ * WindowEGL feeds every input event in, attaches the events received since
+ * the previous frame to the next commit, and closes them with the
+ * wp_presentation feedback of that commit. Events of a discarded commit move
+ * on to the next one. Without wp_presentation nothing is recorded.
+ *
+ * Storage is fixed, tracking never allocates: up to 64 events wait for a
+ * frame and 8 frames wait for feedback. Events beyond that are counted as
+ * dropped, and a frame whose feedback never arrives gives its slot to the
+ * newest commit.
+ *
+ * Runtime switches:
+ *   WLTK_LATENCY=1      dump the histograms to stderr on SIGUSR1 and at exit
+ *   WLTK_LATENCY=path   same, written to path
+ */
+class LatencyTracker {
+public:
+	/** 1 ms buckets up to kNumBuckets ms, slower events land in overflow */
+	static const int kNumBuckets = 100;
+
+	struct Histogram {
+		unsigned int count;
+		unsigned int overflow;
+		uint64_t sumUs;
+		uint64_t minUs;
+		uint64_t maxUs;
+		unsigned int buckets[kNumBuckets];
+	};
+
+	LatencyTracker();
+	virtual ~LatencyTracker();
+
+	/** time is the wl_input timestamp in ms */
+	void AddEvent(Window::InputType type, uint32_t time);
+
+	/** Events since the last commit belong to frame; Drop forgets them */
+	void CommitFrame(unsigned int frame);
+	void DropPending();
+
+	/** presentNs is CLOCK_MONOTONIC, 0 for a discarded frame */
+	void OnPresented(unsigned int frame, uint64_t presentNs);
+
+	const Histogram& GetHistogram(Window::InputType type);
+
+	/** Upper bound of the bucket holding the percentile, 0 without samples */
+	uint64_t GetPercentileUs(Window::InputType type, float percentile);
+
+	void Reset();
+	void Dump(FILE* fp);
+
+	/** Dumps where WLTK_LATENCY points if a SIGUSR1 arrived since the last call */
+	void DumpIfRequested();
+
+	static const char* GetInputName(Window::InputType type);
+
+protected:
+	LatencyTrackerImpl* m_pImpl;
+}; // End-of-class LatencyTracker
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_LATENCY_TRACKER_HPP */
@@ -0,0 +1,171 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "Opacity.hpp"
+
+namespace WLToolKit {
+
+/** AND and OR of the alpha bytes of count RGBA pixels, folded into *andAlpha and *orAlpha */
+static void
+ScanAlpha(const unsigned char* p, int count, unsigned char* andAlpha, unsigned char* orAlpha)
+{
+	unsigned char a = *andAlpha;
+	unsigned char o = *orAlpha;
+	int i = 0;
+
+#if defined(__SSE2__)
+	if (count >= 4) {
+		__m128i vand = _mm_set1_epi8((char)0xff);
+		__m128i vor = _mm_setzero_si128();
+
+		for (; i + 4 <= count; i += 4) {
+			__m128i px = _mm_loadu_si128((const __m128i*)(p + i * 4));
+			vand = _mm_and_si128(vand, px);
+			vor = _mm_or_si128(vor, px);
+		}
+
+		unsigned char lanesAnd[16], lanesOr[16];
+		_mm_storeu_si128((__m128i*)lanesAnd, vand);
+		_mm_storeu_si128((__m128i*)lanesOr, vor);
+
+		a &= lanesAnd[3] & lanesAnd[7] & lanesAnd[11] & lanesAnd[15];
+		o |= lanesOr[3] | lanesOr[7] | lanesOr[11] | lanesOr[15];
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	if (count >= 16) {
+		uint8x16_t vand = vdupq_n_u8(0xff);
+		uint8x16_t vor = vdupq_n_u8(0x00);
+
+		/** de-interleaved load, val[3] holds 16 alphas */
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t px = vld4q_u8(p + i * 4);
+			vand = vandq_u8(vand, px.val[3]);
+			vor = vorrq_u8(vor, px.val[3]);
+		}
+
+		unsigned char lanesAnd[16], lanesOr[16];
+		vst1q_u8(lanesAnd, vand);
+		vst1q_u8(lanesOr, vor);
+
+		for (int l = 0; l < 16; l++) {
+			a &= lanesAnd[l];
+			o |= lanesOr[l];
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		a &= p[i * 4 + 3];
+		o |= p[i * 4 + 3];
+	}
+
+	*andAlpha = a;
+	*orAlpha = o;
+}
+
+static OpacityMap::Opacity
+ToOpacity(unsigned char andAlpha, unsigned char orAlpha)
+{
+	if (andAlpha == 0xff)
+		return OpacityMap::kOpaque;
+	if (orAlpha == 0x00)
+		return OpacityMap::kTransparent;
+
+	return OpacityMap::kMixed;
+}
+
+OpacityMap::OpacityMap()
+: m_opacity(kMixed), m_columns(0), m_rows(0)
+{
+}
+
+void
+OpacityMap::Set(Opacity opacity)
+{
+	m_opacity = opacity;
+	m_columns = 0;
+	m_rows = 0;
+	m_tiles.clear();
+}
+
+OpacityMap::Opacity
+OpacityMap::Classify(const unsigned char* rgba, int width, int height, int stride, bool bTiles)
+{
+	Set(kMixed);
+
+	if ((width <= 0) || (height <= 0))
+		return m_opacity;
+
+	if (!bTiles) {
+		unsigned char andAlpha = 0xff;
+		unsigned char orAlpha = 0x00;
+
+		for (int y = 0; y < height; y++) {
+			ScanAlpha(rgba + y * stride, width, &andAlpha, &orAlpha);
+
+			/** nothing left to learn once both kinds were seen */
+			if ((andAlpha != 0xff) && (orAlpha != 0x00))
+				return m_opacity;
+		}
+
+		m_opacity = ToOpacity(andAlpha, orAlpha);
+		return m_opacity;
+	}
+
+	int columns = (width + kTileSize - 1) / kTileSize;
+	int rows = (height + kTileSize - 1) / kTileSize;
+
+	std::vector<unsigned char> tileAnd(columns, 0xff);
+	std::vector<unsigned char> tileOr(columns, 0x00);
+
+	m_tiles.resize(columns * rows);
+
+	unsigned char andAlpha = 0xff;
+	unsigned char orAlpha = 0x00;
+
+	for (int row = 0; row < rows; row++) {
+		int top = row * kTileSize;
+		int bottom = (top + kTileSize < height) ? top + kTileSize : height;
+
+		for (int column = 0; column < columns; column++) {
+			tileAnd[column] = 0xff;
+			tileOr[column] = 0x00;
+		}
+
+		for (int y = top; y < bottom; y++) {
+			const unsigned char* line = rgba + y * stride;
+
+			for (int column = 0; column < columns; column++) {
+				int left = column * kTileSize;
+				int count = (left + kTileSize < width) ? kTileSize : width - left;
+
+				ScanAlpha(line + left * 4, count, &tileAnd[column], &tileOr[column]);
+			}
+		}
+
+		for (int column = 0; column < columns; column++) {
+			m_tiles[row * columns + column] = (unsigned char)ToOpacity(tileAnd[column], tileOr[column]);
+
+			andAlpha &= tileAnd[column];
+			orAlpha |= tileOr[column];
+		}
+	}
+
+	m_opacity = ToOpacity(andAlpha, orAlpha);
+
+	/** a uniform image says everything with m_opacity */
+	if (m_opacity == kMixed) {
+		m_columns = columns;
+		m_rows = rows;
+	} else {
+		m_tiles.clear();
+	}
+
+	return m_opacity;
+}
+
+} // End-of-namespace WLToolKit
+
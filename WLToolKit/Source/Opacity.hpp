@@ -0,0 +1,51 @@
+#ifndef WL_TOOLKIT_OPACITY_HPP
+#define WL_TOOLKIT_OPACITY_HPP
+
+#include <vector>
+
+namespace WLToolKit {
+
+/**
+ * Alpha classification of an RGBA image: the whole image and, for mixed
+ * images, each kTileSize square. Computed once at load time with SIMD
+ * where the target has it (SSE2, NEON).
+ */
+class OpacityMap {
+public:
+	enum Opacity {
+		kOpaque,
+		kTransparent,
+		kMixed
+	};
+
+	static const int kTileSize = 32;
+
+	/** Mixed and without tiles until Classify() */
+	OpacityMap();
+
+	/** rgba has alpha in the 4th byte of each pixel; tiles are only kept for mixed images */
+	Opacity Classify(const unsigned char* rgba, int width, int height, int stride, bool bTiles);
+
+	/** For content whose alpha is known without looking, e.g. RGB24 */
+	void Set(Opacity opacity);
+
+	Opacity GetOpacity() const { return m_opacity; }
+
+	/** 0 when no tiles were recorded */
+	int GetColumns() const { return m_columns; }
+	int GetRows() const { return m_rows; }
+
+	Opacity GetTile(int column, int row) const {
+		return (Opacity)m_tiles[row * m_columns + column];
+	}
+
+protected:
+	Opacity m_opacity;
+	int m_columns;
+	int m_rows;
+	std::vector<unsigned char> m_tiles;
+}; // End-of-class OpacityMap
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_OPACITY_HPP */
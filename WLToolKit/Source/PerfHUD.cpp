@@ -0,0 +1,321 @@
+
+#include "Common.hpp"
+#include "Shader.hpp"
+#include "Pipeline.hpp"
+#include "PerfHUD.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+#define HUD_CELL		8		/** atlas cell size in texels */
+#define HUD_COLUMNS		16
+#define HUD_ROWS		4
+#define HUD_SCALE		2		/** glyph magnification on screen */
+#define HUD_ADVANCE		(6 * HUD_SCALE)
+#define HUD_LINE		(9 * HUD_SCALE)
+#define HUD_MARGIN		8
+#define HUD_GRAPH_H		60
+#define HUD_GRAPH_MS	50.0f	/** frame time at the top of the graph */
+
+/** 5x7 glyphs, one byte per row, bit 4 is the leftmost column */
+static const struct {
+	char c;
+	unsigned char rows[7];
+} s_glyphs[] = {
+	{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+	{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+	{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+	{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+	{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+	{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+	{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+	{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+	{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+	{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+	{ ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+	{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+	{ 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+	{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+	{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+	{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+	{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+	{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+	{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+	{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+	{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+	{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+	{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+	{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+	{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+};
+
+#define NUM_GLYPHS		(int)(sizeof(s_glyphs) / sizeof(s_glyphs[0]))
+#define SOLID_CELL		0	/** fully covered cell used for panel and graph */
+
+static const GLfloat s_panelColor[]		= { 0.0f, 0.0f, 0.0f, 0.6f };
+static const GLfloat s_textColor[]		= { 1.0f, 1.0f, 1.0f, 1.0f };
+static const GLfloat s_renderColor[]	= { 0.2f, 0.7f, 1.0f, 0.9f };
+static const GLfloat s_goodColor[]		= { 0.3f, 0.9f, 0.3f, 0.9f };
+static const GLfloat s_lateColor[]		= { 1.0f, 0.8f, 0.2f, 0.9f };
+static const GLfloat s_missColor[]		= { 1.0f, 0.2f, 0.2f, 0.9f };
+static const GLfloat s_targetColor[]	= { 1.0f, 1.0f, 1.0f, 0.5f };
+
+static int
+GlyphCell(char c)
+{
+	for (int i = 0; i < NUM_GLYPHS; i++) {
+		if (s_glyphs[i].c == c)
+			return i + 1;
+	}
+
+	return -1;
+}
+
+PerfHUD::PerfHUD()
+: m_program(0), m_atlas(0), m_uniformAtlas(-1), m_head(0), m_count(0),
+  m_accumNs(0), m_accumRenderNs(0), m_accumSwapNs(0), m_accumOverdraw(0.0), m_accumFrames(0),
+  m_width(0), m_height(0)
+{
+	memset(m_history, 0, sizeof(m_history));
+	memset(m_lines, 0, sizeof(m_lines));
+
+	m_vertices.reserve(kMaxQuads * 6);
+}
+
+PerfHUD::~PerfHUD()
+{
+	if (m_atlas) {
+		ResourceRegistry::Untrack(ResourceRegistry::kTexture, m_atlas);
+		glDeleteTextures(1, &m_atlas);
+	}
+	if (m_program)
+		DeleteProgram(m_program);
+}
+
+bool
+PerfHUD::Init()
+{
+	m_program = CreateCoverageProgram();
+	if (!m_program)
+		return false;
+
+	m_uniformAtlas = glGetUniformLocation(m_program, "atlas");
+
+	return CreateAtlas();
+}
+
+bool
+PerfHUD::CreateAtlas()
+{
+	const int width = HUD_COLUMNS * HUD_CELL;
+	const int height = HUD_ROWS * HUD_CELL;
+
+	std::vector<unsigned char> pixels(width * height * 4, 0);
+
+	for (int cell = 0; cell <= NUM_GLYPHS; cell++) {
+		int cx = (cell % HUD_COLUMNS) * HUD_CELL;
+		int cy = (cell / HUD_COLUMNS) * HUD_CELL;
+
+		for (int y = 0; y < HUD_CELL; y++) {
+			for (int x = 0; x < HUD_CELL; x++) {
+				bool on;
+
+				if (cell == SOLID_CELL)
+					on = true;
+				else
+					on = (x < 5) && (y < 7) && (s_glyphs[cell - 1].rows[y] & (0x10 >> x));
+
+				int idx = ((cy + y) * width + (cx + x)) << 2;
+				pixels[idx + 0] = 0xff;
+				pixels[idx + 1] = 0xff;
+				pixels[idx + 2] = 0xff;
+				pixels[idx + 3] = on ? 0xff : 0x00;
+			}
+		}
+	}
+
+	glGenTextures(1, &m_atlas);
+	glBindTexture(GL_TEXTURE_2D, m_atlas);
+
+	/** glyphs are magnified by an integer factor, keep them crisp */
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	ResourceRegistry::Track(ResourceRegistry::kTexture, m_atlas, width * height * 4, "PerfHUD atlas");
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+}
+
+void
+PerfHUD::AddFrame(const WindowEGL::FrameStats& stats, size_t textureBytes)
+{
+	m_history[m_head] = stats;
+	m_head = (m_head + 1) % kHistory;
+	if (m_count < kHistory)
+		m_count++;
+
+	m_accumNs += stats.intervalNs;
+	m_accumRenderNs += stats.renderNs;
+	m_accumSwapNs += stats.swapNs;
+	m_accumOverdraw += stats.overdraw;
+	m_accumFrames++;
+
+	if ((m_accumNs < 500000000ULL) && (m_lines[0][0] != '\0'))
+		return;
+
+	double frameMs = m_accumFrames ? (m_accumNs / 1000000.0) / m_accumFrames : 0.0;
+	double renderMs = m_accumFrames ? (m_accumRenderNs / 1000000.0) / m_accumFrames : 0.0;
+	double swapMs = m_accumFrames ? (m_accumSwapNs / 1000000.0) / m_accumFrames : 0.0;
+	double overdraw = m_accumFrames ? m_accumOverdraw / m_accumFrames : 0.0;
+
+	snprintf(m_lines[0], sizeof(m_lines[0]), "FPS %.1f  FRAME %.1fMS",
+			 (frameMs > 0.0) ? 1000.0 / frameMs : 0.0, frameMs);
+	snprintf(m_lines[1], sizeof(m_lines[1]), "RENDER %.1fMS  SWAP %.1fMS", renderMs, swapMs);
+	snprintf(m_lines[2], sizeof(m_lines[2]), "DRAWS %u  TEX %uKB",
+			 stats.drawCalls, (unsigned int)(textureBytes / 1024));
+	snprintf(m_lines[3], sizeof(m_lines[3]), "OVERDRAW %.2fX", overdraw);
+
+	m_accumNs = 0;
+	m_accumRenderNs = 0;
+	m_accumSwapNs = 0;
+	m_accumOverdraw = 0.0;
+	m_accumFrames = 0;
+}
+
+void
+PerfHUD::AddQuad(float x, float y, float w, float h, int cell, const GLfloat* color)
+{
+	if (m_vertices.size() + 6 > (size_t)kMaxQuads * 6)
+		return;
+
+	/** sample the middle of the solid cell so filtering never reaches a neighbour */
+	float u0, v0, u1, v1;
+	if (cell == SOLID_CELL) {
+		u0 = u1 = (HUD_CELL * 0.5f) / (HUD_COLUMNS * HUD_CELL);
+		v0 = v1 = (HUD_CELL * 0.5f) / (HUD_ROWS * HUD_CELL);
+	} else {
+		u0 = (float)((cell % HUD_COLUMNS) * HUD_CELL) / (HUD_COLUMNS * HUD_CELL);
+		v0 = (float)((cell / HUD_COLUMNS) * HUD_CELL) / (HUD_ROWS * HUD_CELL);
+		u1 = u0 + 5.0f / (HUD_COLUMNS * HUD_CELL);
+		v1 = v0 + 7.0f / (HUD_ROWS * HUD_CELL);
+	}
+
+	float left = (x / m_width) * 2.0f - 1.0f;
+	float right = ((x + w) / m_width) * 2.0f - 1.0f;
+	float top = 1.0f - (y / m_height) * 2.0f;
+	float bottom = 1.0f - ((y + h) / m_height) * 2.0f;
+
+	Vertex corners[4] = {
+		{ left,  top,    u0, v0, color[0], color[1], color[2], color[3] },
+		{ left,  bottom, u0, v1, color[0], color[1], color[2], color[3] },
+		{ right, top,    u1, v0, color[0], color[1], color[2], color[3] },
+		{ right, bottom, u1, v1, color[0], color[1], color[2], color[3] },
+	};
+
+	m_vertices.push_back(corners[0]);
+	m_vertices.push_back(corners[1]);
+	m_vertices.push_back(corners[2]);
+	m_vertices.push_back(corners[2]);
+	m_vertices.push_back(corners[1]);
+	m_vertices.push_back(corners[3]);
+}
+
+void
+PerfHUD::AddText(float x, float y, const char* text, const GLfloat* color)
+{
+	for (; *text; text++, x += HUD_ADVANCE) {
+		int cell = GlyphCell(*text);
+		if (cell < 0)
+			continue;
+
+		AddQuad(x, y, 5 * HUD_SCALE, 7 * HUD_SCALE, cell, color);
+	}
+}
+
+void
+PerfHUD::Draw(int width, int height)
+{
+	if (!m_program || (width <= 0) || (height <= 0))
+		return;
+
+	m_width = width;
+	m_height = height;
+	m_vertices.clear();
+
+	const float graphW = kHistory * 2;
+	const float panelW = graphW + HUD_MARGIN * 2;
+	const float panelH = HUD_LINE * kLines + HUD_GRAPH_H + HUD_MARGIN * 3;
+	const float graphX = HUD_MARGIN * 2;
+	const float graphBottom = HUD_MARGIN * 2 + HUD_LINE * kLines + HUD_GRAPH_H;
+	const float pxPerMs = HUD_GRAPH_H / HUD_GRAPH_MS;
+
+	AddQuad(HUD_MARGIN, HUD_MARGIN, panelW, panelH, SOLID_CELL, s_panelColor);
+
+	for (int i = 0; i < kLines; i++)
+		AddText(HUD_MARGIN * 2, HUD_MARGIN * 2 + HUD_LINE * i, m_lines[i], s_textColor);
+
+	/** oldest sample on the left, render time stacked under the rest of the frame */
+	for (int i = 0; i < m_count; i++) {
+		const WindowEGL::FrameStats& s = m_history[(m_head - m_count + i + kHistory) % kHistory];
+
+		float frameMs = s.intervalNs / 1000000.0f;
+		float renderMs = s.renderNs / 1000000.0f;
+		if (frameMs > HUD_GRAPH_MS)
+			frameMs = HUD_GRAPH_MS;
+		if (renderMs > frameMs)
+			renderMs = frameMs;
+
+		const GLfloat* color = s_goodColor;
+		if (frameMs > 34.0f)
+			color = s_missColor;
+		else if (frameMs > 17.5f)
+			color = s_lateColor;
+
+		float x = graphX + (kHistory - m_count + i) * 2;
+		float renderH = renderMs * pxPerMs;
+		float frameH = frameMs * pxPerMs;
+
+		AddQuad(x, graphBottom - renderH, 2, renderH, SOLID_CELL, s_renderColor);
+		AddQuad(x, graphBottom - frameH, 2, frameH - renderH, SOLID_CELL, color);
+	}
+
+	/** 60Hz target */
+	AddQuad(graphX, graphBottom - 16.7f * pxPerMs, graphW, 1, SOLID_CELL, s_targetColor);
+
+	glUseProgram(m_program);
+	glUniform1i(m_uniformAtlas, 0);
+
+	glBindTexture(GL_TEXTURE_2D, m_atlas);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), &m_vertices[0].x);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), &m_vertices[0].u);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), &m_vertices[0].r);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	PremultipliedBlend::Apply();
+
+	glDrawArrays(GL_TRIANGLES, 0, m_vertices.size());
+
+	glDisable(GL_BLEND);
+
+	glDisableVertexAttribArray(2);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+} // End-of-namespace WLToolKit
+
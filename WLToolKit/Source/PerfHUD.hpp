@@ -0,0 +1,70 @@
+#ifndef WL_TOOLKIT_PERF_HUD_HPP
+#define WL_TOOLKIT_PERF_HUD_HPP
+
+#include <vector>
+
+#include "Common.hpp"
+#include "WindowEGL.hpp"
+
+namespace WLToolKit {
+
+/**
+ * Frame statistics overlay drawn by WindowEGL after Render().
+ *
+ * Text, panel and the frame time graph are all quads sampling one small
+ * atlas built at Init() (a 5x7 bitmap font plus a solid cell), so the whole
+ * HUD is a single glDrawArrays from a preallocated vertex array.
+ */
+class PerfHUD {
+public:
+	PerfHUD();
+	virtual ~PerfHUD();
+
+	bool Init();
+
+	void AddFrame(const WindowEGL::FrameStats& stats, size_t textureBytes);
+	void Draw(int width, int height);
+
+protected:
+	struct Vertex {
+		GLfloat x, y;
+		GLfloat u, v;
+		GLfloat r, g, b, a;
+	};
+
+	void AddQuad(float x, float y, float w, float h, int cell, const GLfloat* color);
+	void AddText(float x, float y, const char* text, const GLfloat* color);
+
+	bool CreateAtlas();
+
+protected:
+	enum {
+		kHistory = 120,
+		kLines = 4,
+		kMaxQuads = 512,
+	};
+
+	GLuint m_program;
+	GLuint m_atlas;
+	GLint m_uniformAtlas;
+
+	/** ring buffer of the last kHistory frames */
+	WindowEGL::FrameStats m_history[kHistory];
+	int m_head;
+	int m_count;
+
+	/** numbers shown as text are averaged and refreshed twice a second */
+	char m_lines[kLines][64];
+	uint64_t m_accumNs;
+	uint64_t m_accumRenderNs;
+	uint64_t m_accumSwapNs;
+	double m_accumOverdraw;
+	unsigned int m_accumFrames;
+
+	std::vector<Vertex> m_vertices;
+	int m_width, m_height;
+}; // End-of-class PerfHUD
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_PERF_HUD_HPP */
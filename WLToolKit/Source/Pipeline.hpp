@@ -0,0 +1,172 @@
+#ifndef WL_TOOLKIT_PIPELINE_HPP
+#define WL_TOOLKIT_PIPELINE_HPP
+
+#include <stddef.h>
+
+#include "Common.hpp"
+
+namespace WLToolKit {
+
+/**
+ * Policy types behind the Renderer's sprite pipelines, not part of the
+ * public API.
+ *
+ * A pipeline is one blend, one color and one transform policy. Renderer.cpp
+ * instantiates its stream and draw code per combination, so the per-sprite
+ * loops are resolved at compile time, and every policy adds a #define to the
+ * shared shader source so each combination links into its own program.
+ */
+
+struct SpriteVertex {
+	GLfloat x, y;
+	GLfloat u, v;
+};
+
+struct TintedSpriteVertex {
+	GLfloat x, y;
+	GLfloat u, v;
+	GLubyte color[4];
+};
+
+struct SpriteInstance {
+	GLfloat rect[4];
+	GLfloat uv[4];
+};
+
+struct TintedSpriteInstance {
+	GLfloat rect[4];
+	GLfloat uv[4];
+	GLubyte color[4];
+};
+
+/** Blend policies, the id matches Renderer::Blend */
+struct OpaqueBlend {
+	static const int kId = 0;
+
+	static void Apply() {
+		glDisable(GL_BLEND);
+	}
+
+	static const char* Defines() {
+		return "#define OPAQUE 1\n#define PREMULTIPLIED 0\n";
+	}
+};
+
+struct AlphaBlend {
+	static const int kId = 1;
+
+	static void Apply() {
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_BLEND);
+	}
+
+	static const char* Defines() {
+		return "#define OPAQUE 0\n#define PREMULTIPLIED 0\n";
+	}
+};
+
+struct PremultipliedBlend {
+	static const int kId = 2;
+
+	static void Apply() {
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_BLEND);
+	}
+
+	static const char* Defines() {
+		return "#define OPAQUE 0\n#define PREMULTIPLIED 1\n";
+	}
+};
+
+/** Color policies, they pick the stream layout and bind the color attribute */
+struct NoTint {
+	typedef SpriteVertex Vertex;
+	typedef SpriteInstance Instance;
+
+	static void SetColor(Vertex& vertex, const GLubyte* color) {}
+	static void SetColor(Instance& instance, const GLubyte* color) {}
+
+	static void BindVertexColor(GLuint index, const Vertex* first) {
+		glDisableVertexAttribArray(index);
+	}
+
+	static void BindInstanceColor(GLuint index, size_t offset) {
+		glDisableVertexAttribArray(index);
+	}
+
+	static const char* Defines() {
+		return "#define TINTED 0\n";
+	}
+};
+
+struct Tint {
+	typedef TintedSpriteVertex Vertex;
+	typedef TintedSpriteInstance Instance;
+
+	static void SetColor(Vertex& vertex, const GLubyte* color) {
+		memcpy(vertex.color, color, 4);
+	}
+
+	static void SetColor(Instance& instance, const GLubyte* color) {
+		memcpy(instance.color, color, 4);
+	}
+
+	/** GLES2: client-side vertices */
+	static void BindVertexColor(GLuint index, const Vertex* first) {
+		glVertexAttribPointer(index, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), first->color);
+		glEnableVertexAttribArray(index);
+	}
+
+	/** GLES3: offset of the first instance in the bound instance buffer */
+	static void BindInstanceColor(GLuint index, size_t offset) {
+		glVertexAttribPointer(index, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+			(const GLvoid*)(offset + offsetof(Instance, color)));
+		glEnableVertexAttribArray(index);
+	}
+
+	static const char* Defines() {
+		return "#define TINTED 1\n";
+	}
+};
+
+/** Transform policies */
+struct NoTransform {
+	static const bool kTransformed = false;
+
+	static const char* Defines() {
+		return "#define TRANSFORMED 0\n";
+	}
+};
+
+struct Transform {
+	static const bool kTransformed = true;
+
+	static const char* Defines() {
+		return "#define TRANSFORMED 1\n";
+	}
+};
+
+template<int Id> struct BlendPolicy;
+template<> struct BlendPolicy<0> { typedef OpaqueBlend Type; };
+template<> struct BlendPolicy<1> { typedef AlphaBlend Type; };
+template<> struct BlendPolicy<2> { typedef PremultipliedBlend Type; };
+
+template<bool Tinted> struct ColorPolicy;
+template<> struct ColorPolicy<false> { typedef NoTint Type; };
+template<> struct ColorPolicy<true> { typedef Tint Type; };
+
+template<bool Transformed> struct TransformPolicy;
+template<> struct TransformPolicy<false> { typedef NoTransform Type; };
+template<> struct TransformPolicy<true> { typedef Transform Type; };
+
+/** Policies of a Renderer pipeline id, see Renderer::GetPipeline() */
+template<unsigned int Id>
+struct Pipeline {
+	typedef typename BlendPolicy<Id / 4>::Type Blend;
+	typedef typename ColorPolicy<(Id & 1) != 0>::Type Color;
+	typedef typename TransformPolicy<(Id & 2) != 0>::Type Transform;
+};
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_PIPELINE_HPP */
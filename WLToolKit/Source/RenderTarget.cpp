@@ -0,0 +1,213 @@
+#include "Common.hpp"
+#include "Capabilities.hpp"
+#include "RenderTarget.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+/** dst and src may be the same row */
+static void
+CopyRow(unsigned char* dst, const unsigned char* src, int width, bool bSwizzle)
+{
+	if (!bSwizzle) {
+		if (dst != src)
+			memcpy(dst, src, width * 4);
+		return;
+	}
+
+	for (int x = 0; x < width; x++, src += 4, dst += 4) {
+		unsigned char r = src[0];
+		unsigned char b = src[2];
+
+		dst[0] = b;
+		dst[1] = src[1];
+		dst[2] = r;
+		dst[3] = src[3];
+	}
+}
+
+RenderTarget::RenderTarget()
+: m_framebuffer(0), m_texture(0), m_depth(0), m_bDepth(false), m_width(0), m_height(0)
+{
+}
+
+RenderTarget::~RenderTarget()
+{
+	Destroy();
+}
+
+bool
+RenderTarget::Create(int width, int height, bool bDepth)
+{
+	Destroy();
+
+	m_width = width;
+	m_height = height;
+	m_bDepth = bDepth;
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenTextures(1, &m_texture);
+	if (m_bDepth)
+		glGenRenderbuffers(1, &m_depth);
+
+	ResourceRegistry::Track(ResourceRegistry::kTexture, m_texture, GetBytes(), "RenderTarget");
+
+	if (!Allocate()) {
+		Destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void
+RenderTarget::Destroy()
+{
+	if (!m_framebuffer)
+		return;
+
+	ResourceRegistry::Untrack(ResourceRegistry::kTexture, m_texture);
+
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(1, &m_texture);
+	if (m_depth)
+		glDeleteRenderbuffers(1, &m_depth);
+
+	m_framebuffer = 0;
+	m_texture = 0;
+	m_depth = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+bool
+RenderTarget::Resize(int width, int height)
+{
+	if (!m_framebuffer)
+		return false;
+
+	if ((width == m_width) && (height == m_height))
+		return true;
+
+	m_width = width;
+	m_height = height;
+
+	ResourceRegistry::Resize(ResourceRegistry::kTexture, m_texture, GetBytes());
+
+	return Allocate();
+}
+
+bool
+RenderTarget::Allocate()
+{
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+
+	if (m_bDepth) {
+		glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, m_width, m_height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+	}
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "[WLToolKit] ERR: %dx%d framebuffer is incomplete (%#x)\n", m_width, m_height, status);
+		return false;
+	}
+
+	return true;
+}
+
+void
+RenderTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+}
+
+void
+RenderTarget::BindDefault()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+size_t
+RenderTarget::GetBytes()
+{
+	return (size_t)m_width * m_height * (m_bDepth ? 6 : 4);
+}
+
+bool
+RenderTarget::ReadPixels(void* pixels, int stride, PixelFormat format)
+{
+	if (!m_framebuffer || !pixels || (stride < m_width * 4))
+		return false;
+
+	const Capabilities* caps = Capabilities::GetCurrent();
+
+	/** GL_RGBA is the only combination every implementation reads */
+	bool bReadBGRA = (format == kBGRA) && caps && caps->Has(Capabilities::kReadBGRA);
+	bool bSwizzle = (format == kBGRA) && !bReadBGRA;
+	GLenum glFormat = bReadBGRA ? GL_BGRA_EXT : GL_RGBA;
+
+	unsigned char* dst = (unsigned char*)pixels;
+	int rowBytes = m_width * 4;
+
+	Bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	if (stride == rowBytes) {
+		glReadPixels(0, 0, m_width, m_height, glFormat, GL_UNSIGNED_BYTE, dst);
+	}
+#if defined(WLTK_HAVE_GLES3)
+	else if (caps && caps->Has(Capabilities::kGLES3) && ((stride % 4) == 0)) {
+		glPixelStorei(GL_PACK_ROW_LENGTH, stride / 4);
+		glReadPixels(0, 0, m_width, m_height, glFormat, GL_UNSIGNED_BYTE, dst);
+		glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	}
+#endif
+	else {
+		m_staging.resize((size_t)rowBytes * m_height);
+		glReadPixels(0, 0, m_width, m_height, glFormat, GL_UNSIGNED_BYTE, &m_staging[0]);
+
+		/** flip and swizzle on the way out */
+		for (int y = 0; y < m_height; y++)
+			CopyRow(dst + y * stride, &m_staging[(size_t)(m_height - 1 - y) * rowBytes], m_width, bSwizzle);
+
+		return true;
+	}
+
+	/** GL returns the bottom row first, swap rows in place */
+	m_staging.resize(rowBytes);
+
+	int top = 0;
+	int bottom = m_height - 1;
+
+	for (; top < bottom; top++, bottom--) {
+		unsigned char* a = dst + (size_t)top * stride;
+		unsigned char* b = dst + (size_t)bottom * stride;
+
+		memcpy(&m_staging[0], a, rowBytes);
+		CopyRow(a, b, m_width, bSwizzle);
+		CopyRow(b, &m_staging[0], m_width, bSwizzle);
+	}
+
+	if (bSwizzle && (top == bottom))
+		CopyRow(dst + (size_t)top * stride, dst + (size_t)top * stride, m_width, true);
+
+	return true;
+}
+
+} // End-of-namespace WLToolKit
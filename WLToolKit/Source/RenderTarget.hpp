@@ -0,0 +1,72 @@
+#ifndef WL_TOOLKIT_RENDER_TARGET_HPP
+#define WL_TOOLKIT_RENDER_TARGET_HPP
+
+#include <vector>
+
+extern "C" {
+#include <GLES2/gl2.h>
+}
+
+namespace WLToolKit {
+
+/**
+ * A framebuffer object with an RGBA texture and an optional 16 bit depth
+ * buffer: what an offscreen WindowEGL renders into instead of a
+ * wl_egl_window, and usable on its own for thumbnails.
+ *
+ * Needs a current context for everything but the getters.
+ */
+class RenderTarget {
+public:
+	enum PixelFormat {
+		kRGBA,		/** GL byte order */
+		kBGRA		/** cairo ARGB32 on little endian */
+	};
+
+	RenderTarget();
+	virtual ~RenderTarget();
+
+	bool Create(int width, int height, bool bDepth);
+	void Destroy();
+
+	/** Reallocates the attachments, the content is lost */
+	bool Resize(int width, int height);
+
+	/** Makes it the target of GL drawing, BindDefault() goes back to the EGL surface */
+	void Bind();
+	static void BindDefault();
+
+	/**
+	 * Copies the content into pixels, top row first, stride bytes per row.
+	 * Reads straight into the caller's buffer when the layout allows it
+	 * (tight rows, or GL_PACK_ROW_LENGTH on GLES3, and GL_EXT_read_format_bgra
+	 * for kBGRA), otherwise through a staging row. Waits for the GPU.
+	 */
+	bool ReadPixels(void* pixels, int stride, PixelFormat format);
+
+	int GetWidth() { return m_width; }
+	int GetHeight() { return m_height; }
+	size_t GetBytes();
+
+	GLuint GetFramebuffer() { return m_framebuffer; }
+	GLuint GetTexture() { return m_texture; }
+
+protected:
+	bool Allocate();
+
+protected:
+	GLuint m_framebuffer;
+	GLuint m_texture;
+	GLuint m_depth;
+	bool m_bDepth;
+
+	int m_width;
+	int m_height;
+
+	/** staging for strided reads without pack row length, and the row swap */
+	std::vector<unsigned char> m_staging;
+}; // End-of-class RenderTarget
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_RENDER_TARGET_HPP */
@@ -0,0 +1,882 @@
+#include <string>
+#include <algorithm>
+
+#include "Common.hpp"
+#include "Shader.hpp"
+#include "Renderer.hpp"
+#include "Pipeline.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+#define NO_TRANSFORM		-1
+
+/** pipeline of a sprite dropped by CullSprites() */
+#define CULLED_PIPELINE		~0u
+
+/** occluders kept while culling one flush, the largest win */
+#define MAX_OCCLUDERS		8
+
+/** distinct run depths per frame, two steps of a 16 bit depth buffer apart */
+#define MAX_DEPTH_LAYERS	32768
+
+struct SpriteRecord {
+	GLuint texture;
+	GLfloat rect[4];
+	GLfloat uv[4];
+	GLubyte color[4];		/** r, g, b, a */
+	unsigned int pipeline;
+	int transform;
+};
+
+/** shared by all pipelines, Pipeline.hpp supplies OPAQUE, PREMULTIPLIED, TINTED and TRANSFORMED */
+static const char *vert_shader_text =
+	"attribute vec4 pos;\n"
+	"attribute vec2 texcoord;\n"
+	"varying vec2 v_texcoord;\n"
+	"#if TINTED\n"
+	"attribute vec4 color;\n"
+	"varying vec4 v_color;\n"
+	"#endif\n"
+	"#if TRANSFORMED\n"
+	"uniform mat4 rotation;\n"
+	"#endif\n"
+	"uniform float depth;\n"
+	"void main() {\n"
+	"#if TRANSFORMED\n"
+	"  gl_Position = rotation * pos;\n"
+	"#else\n"
+	"  gl_Position = pos;\n"
+	"#endif\n"
+	"  gl_Position.z = depth * gl_Position.w;\n"
+	"  v_texcoord = texcoord;\n"
+	"#if TINTED\n"
+	"  v_color = color;\n"
+	"#endif\n"
+	"}\n";
+
+static const char *frag_shader_text =
+	"precision mediump float;\n"
+	"varying vec2 v_texcoord;\n"
+	"#if TINTED\n"
+	"varying vec4 v_color;\n"
+	"#endif\n"
+	"uniform sampler2D texture;\n"
+	"void main() {\n"
+	"  vec4 c = texture2D(texture, v_texcoord);\n"
+	"#if TINTED && PREMULTIPLIED\n"
+	"  c *= vec4(v_color.rgb * v_color.a, v_color.a);\n"
+	"#elif TINTED\n"
+	"  c *= v_color;\n"
+	"#endif\n"
+	"#if OPAQUE\n"
+	"  c.a = 1.0;\n"
+	"#endif\n"
+	"  gl_FragColor = c;\n"
+	"}\n";
+
+static const char *shader_attributes[] = { "pos", "texcoord", "color", NULL };
+
+#if defined(WLTK_HAVE_GLES3)
+static const char *vert_shader_text_es3 =
+	"layout(location = 0) in vec2 corner;\n"
+	"layout(location = 1) in vec4 rect;\n"
+	"layout(location = 2) in vec4 uvRect;\n"
+	"out vec2 v_texcoord;\n"
+	"#if TINTED\n"
+	"layout(location = 3) in vec4 color;\n"
+	"out vec4 v_color;\n"
+	"#endif\n"
+	"#if TRANSFORMED\n"
+	"layout(std140) uniform Frame {\n"
+	"  mat4 transform;\n"
+	"};\n"
+	"#endif\n"
+	"uniform float depth;\n"
+	"void main() {\n"
+	"  vec4 p = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);\n"
+	"#if TRANSFORMED\n"
+	"  gl_Position = transform * p;\n"
+	"#else\n"
+	"  gl_Position = p;\n"
+	"#endif\n"
+	"  gl_Position.z = depth * gl_Position.w;\n"
+	"  v_texcoord = mix(uvRect.xy, uvRect.zw, corner);\n"
+	"#if TINTED\n"
+	"  v_color = color;\n"
+	"#endif\n"
+	"}\n";
+
+static const char *frag_shader_text_es3 =
+	"precision mediump float;\n"
+	"in vec2 v_texcoord;\n"
+	"#if TINTED\n"
+	"in vec4 v_color;\n"
+	"#endif\n"
+	"uniform sampler2D tex;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"  vec4 c = texture(tex, v_texcoord);\n"
+	"#if TINTED && PREMULTIPLIED\n"
+	"  c *= vec4(v_color.rgb * v_color.a, v_color.a);\n"
+	"#elif TINTED\n"
+	"  c *= v_color;\n"
+	"#endif\n"
+	"#if OPAQUE\n"
+	"  c.a = 1.0;\n"
+	"#endif\n"
+	"  fragColor = c;\n"
+	"}\n";
+
+static const char *shader_attributes_es3[] = { "corner", "rect", "uvRect", "color", NULL };
+#endif
+
+static const GLfloat identity[] = {
+	1.0f, 0.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 0.0f, 1.0f,
+};
+
+/** the stream layouts are the largest a pipeline uses */
+#define MAX_VERTEX_BYTES	(6 * sizeof(TintedSpriteVertex))
+#define MAX_INSTANCE_BYTES	(sizeof(TintedSpriteInstance))
+
+/** the program WindowEGL hands out to code drawing on its own */
+#define LEGACY_PIPELINE		(Renderer::kBlendPremultiplied * 4 + Renderer::kPipelineTransformed)
+
+template<class V>
+static inline void
+SetVertex(V& v, GLfloat x, GLfloat y, GLfloat s, GLfloat t)
+{
+	v.x = x;
+	v.y = y;
+	v.u = s;
+	v.v = t;
+}
+
+/** x0 < x1 and y0 < y1 in NDC */
+struct Bounds {
+	GLfloat x0, y0, x1, y1;
+};
+
+static inline bool
+Contains(const Bounds& outer, const Bounds& inner)
+{
+	return (outer.x0 <= inner.x0) && (outer.y0 <= inner.y0) && (outer.x1 >= inner.x1) && (outer.y1 >= inner.y1);
+}
+
+static inline GLfloat
+Area(const Bounds& b)
+{
+	return (b.x1 - b.x0) * (b.y1 - b.y0);
+}
+
+static inline void
+GetBounds(const SpriteRecord& sprite, Bounds* b)
+{
+	b->x0 = std::min(sprite.rect[0], sprite.rect[2]);
+	b->x1 = std::max(sprite.rect[0], sprite.rect[2]);
+	b->y0 = std::min(sprite.rect[1], sprite.rect[3]);
+	b->y1 = std::max(sprite.rect[1], sprite.rect[3]);
+}
+
+/** GLES2: two triangles per sprite in the pipeline's vertex layout */
+template<unsigned int Id>
+static size_t
+EmitVertices(const SpriteRecord* sprites, size_t count, unsigned char* dst)
+{
+	typedef typename Pipeline<Id>::Color Color;
+	typedef typename Color::Vertex Vertex;
+
+	Vertex* v = (Vertex*)dst;
+
+	for (size_t i = 0; i < count; i++, v += 6) {
+		const GLfloat *r = sprites[i].rect;
+		const GLfloat *t = sprites[i].uv;
+
+		/** left top, left bottom, right top / right top, left bottom, right bottom */
+		SetVertex(v[0], r[0], r[1], t[0], t[1]);
+		SetVertex(v[1], r[0], r[3], t[0], t[3]);
+		SetVertex(v[2], r[2], r[1], t[2], t[1]);
+		SetVertex(v[3], r[2], r[1], t[2], t[1]);
+		SetVertex(v[4], r[0], r[3], t[0], t[3]);
+		SetVertex(v[5], r[2], r[3], t[2], t[3]);
+
+		for (int k = 0; k < 6; k++)
+			Color::SetColor(v[k], sprites[i].color);
+	}
+
+	return (unsigned char*)v - dst;
+}
+
+/** GLES3: one instance per sprite */
+template<unsigned int Id>
+static size_t
+EmitInstances(const SpriteRecord* sprites, size_t count, unsigned char* dst)
+{
+	typedef typename Pipeline<Id>::Color Color;
+	typedef typename Color::Instance Instance;
+
+	Instance* instance = (Instance*)dst;
+
+	for (size_t i = 0; i < count; i++, instance++) {
+		memcpy(instance->rect, sprites[i].rect, sizeof(instance->rect));
+		memcpy(instance->uv, sprites[i].uv, sizeof(instance->uv));
+		Color::SetColor(*instance, sprites[i].color);
+	}
+
+	return (unsigned char*)instance - dst;
+}
+
+typedef size_t (*EmitFunc)(const SpriteRecord* sprites, size_t count, unsigned char* dst);
+
+#define PIPELINE_TABLE(func)	{	\
+	func<0>, func<1>, func<2>, func<3>,		\
+	func<4>, func<5>, func<6>, func<7>,		\
+	func<8>, func<9>, func<10>, func<11>,	\
+}
+
+static const EmitFunc s_emitGLES2[Renderer::kNumPipelines] = PIPELINE_TABLE(EmitVertices);
+static const EmitFunc s_emitGLES3[Renderer::kNumPipelines] = PIPELINE_TABLE(EmitInstances);
+
+const Renderer::DrawFunc Renderer::s_drawGLES2[kNumPipelines] = PIPELINE_TABLE(&Renderer::DrawRunGLES2);
+const Renderer::DrawFunc Renderer::s_drawGLES3[kNumPipelines] = PIPELINE_TABLE(&Renderer::DrawRunGLES3);
+
+Renderer::Renderer(FrameArena* arena)
+: m_bGLES3(false), m_arena(arena), m_sprites(arena), m_transforms(arena), m_transform(NO_TRANSFORM), m_drawCalls(0),
+  m_culled(0), m_coverage(0.0f), m_bDepth(false), m_bClearPending(false), m_depthLayer(0),
+  m_currentProgram(0), m_currentBlend(-1),
+  m_program(0), m_uniformRotation(-1), m_uniformTexture(-1),
+  m_vao(0), m_quadBuffer(0), m_instanceBuffer(0), m_uniformBuffer(0),
+  m_instanceCapacity(0)
+{
+	memset(m_programs, 0, sizeof(m_programs));
+}
+
+Renderer::~Renderer()
+{
+	DeinitGLES3();
+
+	for (int i = 0; i < kNumPipelines; i++) {
+		if (m_programs[i].program && (m_programs[i].program != m_program))
+			DeleteProgram(m_programs[i].program);
+	}
+
+	if (m_program)
+		DeleteProgram(m_program);
+}
+
+bool
+Renderer::Init(bool bGLES3)
+{
+	typedef Pipeline<LEGACY_PIPELINE> Legacy;
+
+	Program legacy;
+	if (!BuildProgram(false, Legacy::Blend::Defines(), Legacy::Color::Defines(), Legacy::Transform::Defines(), &legacy))
+		return false;
+
+	m_program = legacy.program;
+	m_uniformRotation = legacy.uniformTransform;
+	m_uniformTexture  = glGetUniformLocation(m_program, "texture");
+
+	glUseProgram(m_program);
+	glUniformMatrix4fv(m_uniformRotation, 1, GL_FALSE, identity);
+
+	if (bGLES3 && !InitGLES3()) {
+		fprintf(stderr, "[WLToolKit] ERR: GLES3 renderer setup failed, using the GLES2 path\n");
+		DeinitGLES3();
+		bGLES3 = false;
+
+		/** ES3 programs built so far, the GLES2 path builds its own */
+		for (int i = 0; i < kNumPipelines; i++) {
+			if (m_programs[i].program)
+				DeleteProgram(m_programs[i].program);
+		}
+		memset(m_programs, 0, sizeof(m_programs));
+	}
+
+	m_bGLES3 = bGLES3;
+
+	/** on GLES2 the legacy program is one of the pipelines */
+	if (!m_bGLES3)
+		m_programs[LEGACY_PIPELINE] = legacy;
+
+	/** depth only orders the runs, any config with a depth buffer does */
+	GLint depthBits = 0;
+	glGetIntegerv(GL_DEPTH_BITS, &depthBits);
+	m_bDepth = (depthBits >= 16);
+
+	return true;
+}
+
+bool
+Renderer::BuildProgram(bool bGLES3, const char* blend, const char* color, const char* transform, Program* program)
+{
+	std::string defines;
+
+	/** #version has to come first */
+	if (bGLES3)
+		defines = "#version 300 es\n";
+
+	defines += blend;
+	defines += color;
+	defines += transform;
+
+	std::string vert = defines;
+	std::string frag = defines;
+
+	const char* const* attributes = shader_attributes;
+
+#if defined(WLTK_HAVE_GLES3)
+	if (bGLES3) {
+		vert += vert_shader_text_es3;
+		frag += frag_shader_text_es3;
+		attributes = shader_attributes_es3;
+	} else
+#endif
+	{
+		vert += vert_shader_text;
+		frag += frag_shader_text;
+	}
+
+	memset(program, 0, sizeof(*program));
+
+	program->program = CreateProgram(vert.c_str(), frag.c_str(), attributes);
+	if (!program->program) {
+		program->bFailed = true;
+		return false;
+	}
+
+	glUseProgram(program->program);
+	program->uniformTransform = -1;
+	program->uniformDepth = glGetUniformLocation(program->program, "depth");
+
+#if defined(WLTK_HAVE_GLES3)
+	if (bGLES3) {
+		glUniform1i(glGetUniformLocation(program->program, "tex"), 0);
+
+		GLuint blockIndex = glGetUniformBlockIndex(program->program, "Frame");
+		if (blockIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(program->program, blockIndex, 0);
+
+		return true;
+	}
+#endif
+
+	glUniform1i(glGetUniformLocation(program->program, "texture"), 0);
+	program->uniformTransform = glGetUniformLocation(program->program, "rotation");
+
+	return true;
+}
+
+bool
+Renderer::InitGLES3()
+{
+#if defined(WLTK_HAVE_GLES3)
+	static const GLfloat corners[] = {
+		0.0f, 0.0f,		// left top
+		0.0f, 1.0f,		// left bottom
+		1.0f, 0.0f,		// right top
+		1.0f, 1.0f,		// right bottom
+	};
+
+	/** the common pipeline up front, a driver that cannot build it gets the GLES2 path */
+	typedef Pipeline<kBlendPremultiplied * 4> Default;
+	Program& program = m_programs[kBlendPremultiplied * 4];
+	if (!BuildProgram(true, Default::Blend::Defines(), Default::Color::Defines(), Default::Transform::Defines(), &program))
+		return false;
+
+	glGenBuffers(1, &m_uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(identity), identity, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	ResourceRegistry::Track(ResourceRegistry::kBuffer, m_uniformBuffer, sizeof(identity), "Renderer UBO");
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	ResourceRegistry::Track(ResourceRegistry::kBuffer, m_quadBuffer, sizeof(corners), "Renderer quad");
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(0);
+
+	glGenBuffers(1, &m_instanceBuffer);
+	ResourceRegistry::Track(ResourceRegistry::kBuffer, m_instanceBuffer, 0, "Renderer instances");
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribDivisor(2, 1);
+	glVertexAttribDivisor(3, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glUseProgram(m_program);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void
+Renderer::DeinitGLES3()
+{
+#if defined(WLTK_HAVE_GLES3)
+	if (m_vao)
+		glDeleteVertexArrays(1, &m_vao);
+	if (m_quadBuffer) {
+		ResourceRegistry::Untrack(ResourceRegistry::kBuffer, m_quadBuffer);
+		glDeleteBuffers(1, &m_quadBuffer);
+	}
+	if (m_instanceBuffer) {
+		ResourceRegistry::Untrack(ResourceRegistry::kBuffer, m_instanceBuffer);
+		glDeleteBuffers(1, &m_instanceBuffer);
+	}
+	if (m_uniformBuffer) {
+		ResourceRegistry::Untrack(ResourceRegistry::kBuffer, m_uniformBuffer);
+		glDeleteBuffers(1, &m_uniformBuffer);
+	}
+#endif
+
+	m_vao = 0;
+	m_quadBuffer = 0;
+	m_instanceBuffer = 0;
+	m_uniformBuffer = 0;
+	m_instanceCapacity = 0;
+}
+
+void
+Renderer::BeginFrame()
+{
+	m_transform = NO_TRANSFORM;
+	m_bClearPending = true;
+	m_depthLayer = 0;
+}
+
+void
+Renderer::AddSprite(GLuint texture, const GLfloat* rect, const GLfloat* uv, Blend blend, uint32_t color)
+{
+	/** the arena is out of memory and said so, the sprite is not drawn */
+	SpriteRecord* sprite = m_sprites.Extend(1);
+	if (!sprite)
+		return;
+
+	sprite->texture = texture;
+	memcpy(sprite->rect, rect, sizeof(sprite->rect));
+	memcpy(sprite->uv, uv, sizeof(sprite->uv));
+
+	sprite->color[0] = (color >> 16) & 0xff;
+	sprite->color[1] = (color >> 8) & 0xff;
+	sprite->color[2] = color & 0xff;
+	sprite->color[3] = (color >> 24) & 0xff;
+
+	/** a translucent tint on an opaque texture has to blend, and hides nothing */
+	if ((blend == kBlendOpaque) && ((color >> 24) != 0xff))
+		blend = kBlendPremultiplied;
+
+	unsigned int flags = 0;
+	if (color != 0xffffffff)
+		flags |= kPipelineTinted;
+	if (m_transform != NO_TRANSFORM)
+		flags |= kPipelineTransformed;
+
+	sprite->pipeline = GetPipeline(blend, flags);
+	sprite->transform = m_transform;
+}
+
+void
+Renderer::SetTransform(const GLfloat* matrix)
+{
+	/** out of memory in the arena, draw untransformed rather than with a stale matrix */
+	Matrix* m = m_transforms.Extend(1);
+	if (!m) {
+		m_transform = NO_TRANSFORM;
+		return;
+	}
+
+	memcpy(m->m, matrix, sizeof(m->m));
+
+	m_transform = m_transforms.Size() - 1;
+}
+
+void
+Renderer::ResetTransform()
+{
+	m_transform = NO_TRANSFORM;
+}
+
+bool
+Renderer::IsTransformed()
+{
+	return m_transform != NO_TRANSFORM;
+}
+
+void
+Renderer::Flush()
+{
+	if (m_sprites.Empty()) {
+		if (m_bClearPending)
+			Clear(true);
+		return;
+	}
+
+	bool bCoversViewport = false;
+	const size_t count = CullSprites(m_sprites.Data(), m_sprites.Size(), &bCoversViewport);
+	const SpriteRecord* sprites = m_sprites.Data();
+
+	/** an opaque sprite over everything leaves no pixel of the clear visible */
+	if (m_bClearPending)
+		Clear(!bCoversViewport);
+
+	if (count == 0) {
+		m_sprites.Clear();
+		return;
+	}
+
+	const EmitFunc* emit = m_bGLES3 ? s_emitGLES3 : s_emitGLES2;
+
+	unsigned char* stream = (unsigned char*)m_arena->Allocate(count * (m_bGLES3 ? MAX_INSTANCE_BYTES : MAX_VERTEX_BYTES));
+	Run* runs = m_arena->Allocate<Run>(count);
+
+	/** the arena is out of memory and said so, this batch is lost */
+	if (!stream || !runs) {
+		m_sprites.Clear();
+		return;
+	}
+
+	size_t numRuns = 0;
+	size_t bytes = 0;
+
+	/** split into runs and write each in its pipeline's layout */
+	size_t first = 0;
+	while (first < count) {
+		const SpriteRecord& head = sprites[first];
+
+		size_t last = first + 1;
+		while ((last < count) && (sprites[last].texture == head.texture) &&
+			(sprites[last].pipeline == head.pipeline) && (sprites[last].transform == head.transform))
+			last++;
+
+		Run& run = runs[numRuns++];
+		run.sprites = &sprites[first];
+		run.count = last - first;
+		run.offset = bytes;
+
+		bytes += emit[head.pipeline](run.sprites, run.count, stream + bytes);
+
+		first = last;
+	}
+
+	/**
+	 * Later runs are nearer, across flushes too, so content drawn by earlier
+	 * flushes stays behind. Out of layers the rest of the frame is drawn in
+	 * plain painter's order, which is just as correct.
+	 */
+	bool bDepth = m_bDepth && (m_depthLayer + numRuns < MAX_DEPTH_LAYERS);
+
+	for (size_t i = 0; i < numRuns; i++) {
+		if (bDepth)
+			runs[i].depth = 1.0f - 2.0f * (GLfloat)(++m_depthLayer) / MAX_DEPTH_LAYERS;
+		else
+			runs[i].depth = 0.0f;
+	}
+
+	/** whatever drew since the last flush may have changed these */
+	m_currentProgram = 0;
+	m_currentBlend = -1;
+
+	if (m_bGLES3) {
+#if defined(WLTK_HAVE_GLES3)
+		glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_uniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer);
+		glBindVertexArray(m_vao);
+
+		/** one upload per flush, the buffer only grows */
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		if (bytes > m_instanceCapacity) {
+			m_instanceCapacity = bytes * 2;
+			glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity, NULL, GL_STREAM_DRAW);
+			ResourceRegistry::Resize(ResourceRegistry::kBuffer, m_instanceBuffer, m_instanceCapacity);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, stream);
+
+		DrawRuns(runs, numRuns, NULL, bDepth);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+#endif
+	} else {
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+
+		DrawRuns(runs, numRuns, stream, bDepth);
+
+		glDisableVertexAttribArray(2);
+		glDisableVertexAttribArray(1);
+		glDisableVertexAttribArray(0);
+	}
+
+	glDisable(GL_BLEND);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_sprites.Clear();
+}
+
+size_t
+Renderer::CullSprites(SpriteRecord* sprites, size_t count, bool* pbCoversViewport)
+{
+	static const Bounds viewport = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+	Bounds occluders[MAX_OCCLUDERS];
+	int numOccluders = 0;
+	size_t culled = 0;
+
+	*pbCoversViewport = false;
+
+	/** topmost first, a sprite can only be hidden by what is drawn after it */
+	for (size_t i = count; i-- > 0;) {
+		SpriteRecord& sprite = sprites[i];
+
+		Bounds b;
+		GetBounds(sprite, &b);
+
+		/** where a transform puts the sprite is not worth working out here */
+		if (sprite.transform != NO_TRANSFORM) {
+			m_coverage += Area(b) * 0.25f;
+			continue;
+		}
+
+		b.x0 = std::max(b.x0, viewport.x0);
+		b.y0 = std::max(b.y0, viewport.y0);
+		b.x1 = std::min(b.x1, viewport.x1);
+		b.y1 = std::min(b.y1, viewport.y1);
+
+		bool bHidden = (b.x0 >= b.x1) || (b.y0 >= b.y1);
+		for (int k = 0; !bHidden && (k < numOccluders); k++)
+			bHidden = Contains(occluders[k], b);
+
+		if (bHidden) {
+			sprite.pipeline = CULLED_PIPELINE;
+			culled++;
+			continue;
+		}
+
+		m_coverage += Area(b) * 0.25f;
+
+		if (sprite.pipeline / 4 != kBlendOpaque)
+			continue;
+
+		if (Contains(b, viewport))
+			*pbCoversViewport = true;
+
+		if (numOccluders < MAX_OCCLUDERS) {
+			occluders[numOccluders++] = b;
+		} else {
+			int smallest = 0;
+			for (int k = 1; k < MAX_OCCLUDERS; k++) {
+				if (Area(occluders[k]) < Area(occluders[smallest]))
+					smallest = k;
+			}
+
+			if (Area(b) > Area(occluders[smallest]))
+				occluders[smallest] = b;
+		}
+	}
+
+	if (culled == 0)
+		return count;
+
+	m_culled += culled;
+
+	/** keeps the order, runs are built from neighbours */
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (sprites[i].pipeline != CULLED_PIPELINE)
+			sprites[kept++] = sprites[i];
+	}
+
+	return kept;
+}
+
+void
+Renderer::DrawRuns(const Run* runs, size_t numRuns, const unsigned char* stream, bool bDepth)
+{
+	const DrawFunc* draw = m_bGLES3 ? s_drawGLES3 : s_drawGLES2;
+
+	if (!bDepth) {
+		for (size_t i = 0; i < numRuns; i++)
+			(this->*draw[runs[i].sprites->pipeline])(runs[i], stream);
+		return;
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+
+	/** opaque runs front to back, early-Z rejects the fragments they hide */
+	glDepthMask(GL_TRUE);
+	for (size_t i = numRuns; i-- > 0;) {
+		if (runs[i].sprites->pipeline / 4 == kBlendOpaque)
+			(this->*draw[runs[i].sprites->pipeline])(runs[i], stream);
+	}
+
+	/** blended runs keep their order, tested against the opaque ones in front */
+	glDepthMask(GL_FALSE);
+	for (size_t i = 0; i < numRuns; i++) {
+		if (runs[i].sprites->pipeline / 4 != kBlendOpaque)
+			(this->*draw[runs[i].sprites->pipeline])(runs[i], stream);
+	}
+
+	/** glClear() honours the mask */
+	glDepthMask(GL_TRUE);
+	glDisable(GL_DEPTH_TEST);
+}
+
+void
+Renderer::Clear(bool bColor)
+{
+	GLbitfield mask = m_bDepth ? GL_DEPTH_BUFFER_BIT : 0;
+
+	if (bColor) {
+		glClearColor(0.0, 0.0, 0.0, 1.0);
+		mask |= GL_COLOR_BUFFER_BIT;
+
+		m_coverage += 1.0f;
+	}
+
+	if (mask)
+		glClear(mask);
+
+	m_bClearPending = false;
+}
+
+template<unsigned int Id>
+bool
+Renderer::UseProgram()
+{
+	typedef Pipeline<Id> P;
+
+	Program& program = m_programs[Id];
+
+	if (!program.program) {
+		/** do not retry a broken shader every frame */
+		if (program.bFailed)
+			return false;
+
+		if (!BuildProgram(m_bGLES3, P::Blend::Defines(), P::Color::Defines(), P::Transform::Defines(), &program)) {
+			fprintf(stderr, "[WLToolKit] ERR: sprite pipeline %u is not available\n", Id);
+			return false;
+		}
+
+		m_currentProgram = program.program;
+	}
+
+	if (m_currentProgram != program.program) {
+		glUseProgram(program.program);
+		m_currentProgram = program.program;
+	}
+
+	if (m_currentBlend != P::Blend::kId) {
+		P::Blend::Apply();
+		m_currentBlend = P::Blend::kId;
+	}
+
+	return true;
+}
+
+const GLfloat*
+Renderer::GetRunTransform(const Run& run)
+{
+	return m_transforms[run.sprites->transform].m;
+}
+
+template<unsigned int Id>
+void
+Renderer::DrawRunGLES2(const Run& run, const unsigned char* stream)
+{
+	typedef Pipeline<Id> P;
+	typedef typename P::Color::Vertex Vertex;
+
+	if (!UseProgram<Id>())
+		return;
+
+	if (P::Transform::kTransformed)
+		glUniformMatrix4fv(m_programs[Id].uniformTransform, 1, GL_FALSE, GetRunTransform(run));
+
+	glUniform1f(m_programs[Id].uniformDepth, run.depth);
+
+	const Vertex* v = (const Vertex*)(stream + run.offset);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), &v->x);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), &v->u);
+	P::Color::BindVertexColor(2, v);
+
+	glBindTexture(GL_TEXTURE_2D, run.sprites->texture);
+	glDrawArrays(GL_TRIANGLES, 0, run.count * 6);
+	m_drawCalls++;
+}
+
+template<unsigned int Id>
+void
+Renderer::DrawRunGLES3(const Run& run, const unsigned char* stream)
+{
+#if defined(WLTK_HAVE_GLES3)
+	typedef Pipeline<Id> P;
+	typedef typename P::Color::Instance Instance;
+
+	if (!UseProgram<Id>())
+		return;
+
+	if (P::Transform::kTransformed)
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(identity), GetRunTransform(run));
+
+	glUniform1f(m_programs[Id].uniformDepth, run.depth);
+
+	/** ES 3.0 has no base instance, each run points the instance attributes at its first sprite */
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const GLvoid*)(run.offset + offsetof(Instance, rect)));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const GLvoid*)(run.offset + offsetof(Instance, uv)));
+	P::Color::BindInstanceColor(3, run.offset);
+
+	glBindTexture(GL_TEXTURE_2D, run.sprites->texture);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, run.count);
+	m_drawCalls++;
+#endif
+}
+
+unsigned int
+Renderer::TakeDrawCalls()
+{
+	unsigned int drawCalls = m_drawCalls;
+
+	m_drawCalls = 0;
+
+	return drawCalls;
+}
+
+float
+Renderer::TakeOverdraw()
+{
+	float coverage = m_coverage;
+
+	m_coverage = 0.0f;
+
+	return coverage;
+}
+
+unsigned int
+Renderer::TakeCulled()
+{
+	unsigned int culled = m_culled;
+
+	m_culled = 0;
+
+	return culled;
+}
+
+} // End-of-namespace WLToolKit
+
@@ -0,0 +1,186 @@
+#ifndef WL_TOOLKIT_RENDERER_HPP
+#define WL_TOOLKIT_RENDERER_HPP
+
+#include "Common.hpp"
+#include "FrameArena.hpp"
+
+namespace WLToolKit {
+
+struct SpriteRecord;
+
+/**
+ * Sprite batcher owned by WindowEGL.
+ *
+ * Texture::Draw() only queues a sprite; Flush() (called by WindowEGL after
+ * Render(), and by anything that draws with GL directly) submits the queue
+ * in order, one draw per run of sprites sharing a texture and pipeline.
+ *
+ * A pipeline is a blend mode plus optional tint and transform. Each of the
+ * combinations has its own shader and its own instantiation of the draw code
+ * (see Pipeline.hpp), built on first use. Opaque sprites draw with blending
+ * off.
+ *
+ * Textures hold premultiplied alpha (cairo's format, and what every
+ * ImageDecoder produces), so kBlendPremultiplied is the default: linear
+ * filtering and downscaling stay correct at transparent edges, and a tint's
+ * alpha fades the whole sprite. kBlendAlpha is for straight alpha textures
+ * uploaded by hand.
+ *
+ * Overdraw: untransformed sprites fully hidden behind a later opaque one, or
+ * outside the viewport, are dropped. With a depth buffer every run gets its
+ * own depth, opaque runs are drawn front to back so early-Z rejects what they
+ * hide, then blended runs in order against that depth. The frame's clear is
+ * done by the first Flush() and skipped when an opaque sprite covers the
+ * whole viewport, so nothing may draw with GL before flushing.
+ *
+ * GLES3: a static unit quad plus a per-instance buffer in a VAO, one
+ *        glDrawArraysInstanced per run, frame constants in a uniform buffer.
+ * GLES2: the runs are expanded into a client-side triangle list.
+ *
+ * The queue and the streams built from it live on the window's FrameArena.
+ */
+class Renderer {
+public:
+	enum Blend {
+		kBlendOpaque,			/** no blending, alpha is written as 1 */
+		kBlendAlpha,			/** GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, straight alpha */
+		kBlendPremultiplied,	/** GL_ONE, GL_ONE_MINUS_SRC_ALPHA, what Texture uses */
+		kNumBlends
+	};
+
+	/** A pipeline id is the blend times 4 plus these flags */
+	enum {
+		kPipelineTinted			= 1,
+		kPipelineTransformed	= 2,
+		kNumPipelines			= kNumBlends * 4
+	};
+
+	Renderer(FrameArena* arena);
+	virtual ~Renderer();
+
+	bool Init(bool bGLES3);
+
+	bool IsGLES3() { return m_bGLES3; }
+
+	/** Forgets the transform and schedules the clear, called by WindowEGL after the arena moved on */
+	void BeginFrame();
+
+	/**
+	 * rect is left, top, right, bottom in NDC, uv is u0, v0, u1, v1.
+	 * color is 0xAARRGGBB and multiplies the texture, opaque white draws
+	 * with an untinted pipeline. kBlendOpaque with a color alpha below 0xff
+	 * draws as kBlendPremultiplied.
+	 */
+	void AddSprite(GLuint texture, const GLfloat* rect, const GLfloat* uv,
+		Blend blend = kBlendPremultiplied, uint32_t color = 0xffffffff);
+
+	/** Column-major 4x4 applied to the sprites added until ResetTransform() or the end of the frame */
+	void SetTransform(const GLfloat* matrix);
+	void ResetTransform();
+
+	/** Whether sprites added now get a transform, their screen rect is not known then */
+	bool IsTransformed();
+
+	void Flush();
+
+	/** Draw calls issued since the last call */
+	unsigned int TakeDrawCalls();
+
+	/**
+	 * Viewport coverage submitted since the last call, clear included:
+	 * 1.0 means every pixel was written once. Fragments early-Z rejects
+	 * still count, transformed sprites count their untransformed area.
+	 */
+	float TakeOverdraw();
+
+	/** Sprites dropped as hidden since the last call */
+	unsigned int TakeCulled();
+
+	bool HasDepth() { return m_bDepth; }
+
+	static unsigned int GetPipeline(Blend blend, unsigned int flags) { return blend * 4 + flags; }
+
+	/** GLES2 premultiplied transformed sprite program, also what WindowEGL exposes */
+	GLuint GetProgram() { return m_program; }
+	GLuint GetVertexAttribute() { return 0; }
+	GLuint GetTexCoordAttribute() { return 1; }
+	GLuint GetRotationUniform() { return m_uniformRotation; }
+	GLuint GetTextureUniform() { return m_uniformTexture; }
+
+protected:
+	struct Program {
+		GLuint program;
+		GLint uniformTransform;
+		GLint uniformDepth;
+		bool bFailed;
+	};
+
+	struct Matrix {
+		GLfloat m[16];
+	};
+
+	/** consecutive sprites sharing texture, pipeline and transform */
+	struct Run {
+		const SpriteRecord* sprites;
+		size_t count;
+		size_t offset;		/** bytes into the vertex or instance stream */
+		GLfloat depth;		/** NDC, smaller is in front */
+	};
+
+	typedef void (Renderer::*DrawFunc)(const Run& run, const unsigned char* stream);
+
+	template<unsigned int Id> void DrawRunGLES2(const Run& run, const unsigned char* stream);
+	template<unsigned int Id> void DrawRunGLES3(const Run& run, const unsigned char* stream);
+	template<unsigned int Id> bool UseProgram();
+
+	static bool BuildProgram(bool bGLES3, const char* blend, const char* color, const char* transform, Program* program);
+	void SetBlend(int blend);
+	const GLfloat* GetRunTransform(const Run& run);
+
+	size_t CullSprites(SpriteRecord* sprites, size_t count, bool* pbCoversViewport);
+	void DrawRuns(const Run* runs, size_t numRuns, const unsigned char* stream, bool bDepth);
+	void Clear(bool bColor);
+
+	bool InitGLES3();
+	void DeinitGLES3();
+
+	static const DrawFunc s_drawGLES2[kNumPipelines];
+	static const DrawFunc s_drawGLES3[kNumPipelines];
+
+protected:
+	bool m_bGLES3;
+
+	FrameArena* m_arena;
+	FrameVector<SpriteRecord> m_sprites;
+	FrameVector<Matrix> m_transforms;
+	int m_transform;
+	unsigned int m_drawCalls;
+	unsigned int m_culled;
+	float m_coverage;
+
+	bool m_bDepth;
+	bool m_bClearPending;
+	unsigned int m_depthLayer;	/** runs given a depth so far this frame */
+
+	Program m_programs[kNumPipelines];
+
+	/** GL state during Flush(), anything may change it between flushes */
+	GLuint m_currentProgram;
+	int m_currentBlend;
+
+	/** GLES2 */
+	GLuint m_program;
+	GLint m_uniformRotation;
+	GLint m_uniformTexture;
+
+	/** GLES3 */
+	GLuint m_vao;
+	GLuint m_quadBuffer;
+	GLuint m_instanceBuffer;
+	GLuint m_uniformBuffer;
+	size_t m_instanceCapacity;
+}; // End-of-class Renderer
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_RENDERER_HPP */
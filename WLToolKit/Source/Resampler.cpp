@@ -0,0 +1,638 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <list>
+#include <map>
+
+extern "C" {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+}
+
+#include "Resampler.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+/** weights are 1.14 fixed point, two of them times a pixel still fit madd's int16 */
+#define PRECISION_BITS		14
+#define MAX_THREADS			4
+
+/** fewer output pixels than this are not worth a thread */
+#define MIN_PIXELS_PER_THREAD	(32 * 1024)
+
+static int s_threads = 0;
+
+/** first input pixel and tap count per output pixel, then the taps, size per output */
+struct Coefficients {
+	int size;
+	std::vector<int> bounds;
+	std::vector<int16_t> weights;
+};
+
+static double
+BoxFilter(double x)
+{
+	return ((x >= -0.5) && (x < 0.5)) ? 1.0 : 0.0;
+}
+
+static double
+TriangleFilter(double x)
+{
+	if (x < 0.0)
+		x = -x;
+
+	return (x < 1.0) ? 1.0 - x : 0.0;
+}
+
+static double
+Sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+
+	x *= M_PI;
+
+	return sin(x) / x;
+}
+
+static double
+Lanczos3Filter(double x)
+{
+	if ((x <= -3.0) || (x >= 3.0))
+		return 0.0;
+
+	return Sinc(x) * Sinc(x / 3.0);
+}
+
+/**
+ * Taps of each output pixel. When shrinking the filter is stretched by the
+ * scale factor so every input pixel contributes.
+ */
+static void
+ComputeCoefficients(int inSize, int outSize, Resampler::Filter filter, Coefficients* c)
+{
+	double (*func)(double) = BoxFilter;
+	double support = 0.5;
+
+	if (filter == Resampler::kBilinear) {
+		func = TriangleFilter;
+		support = 1.0;
+	} else if (filter == Resampler::kLanczos3) {
+		func = Lanczos3Filter;
+		support = 3.0;
+	}
+
+	double scale = (double)inSize / outSize;
+	double filterScale = (scale > 1.0) ? scale : 1.0;
+
+	support *= filterScale;
+
+	c->size = (int)ceil(support) * 2 + 1;
+	c->bounds.assign(outSize * 2, 0);
+	c->weights.assign(outSize * c->size, 0);
+
+	std::vector<double> w(c->size);
+
+	for (int out = 0; out < outSize; out++) {
+		double center = (out + 0.5) * scale;
+
+		int first = (int)(center - support + 0.5);
+		int last = (int)(center + support + 0.5);
+		if (first < 0)
+			first = 0;
+		if (last > inSize)
+			last = inSize;
+
+		int count = last - first;
+		if (count > c->size)
+			count = c->size;
+
+		double total = 0.0;
+		for (int i = 0; i < count; i++) {
+			w[i] = func((first + i - center + 0.5) / filterScale);
+			total += w[i];
+		}
+
+		/** box and an exact half-pixel center can leave nothing, take the nearest pixel */
+		if (total == 0.0) {
+			w[0] = 1.0;
+			count = 1;
+			total = 1.0;
+		}
+
+		int16_t* k = &c->weights[out * c->size];
+		int sum = 0;
+		int largest = 0;
+
+		for (int i = 0; i < count; i++) {
+			double v = w[i] / total * (1 << PRECISION_BITS);
+
+			k[i] = (int16_t)((v < 0.0) ? -floor(-v + 0.5) : floor(v + 0.5));
+			sum += k[i];
+
+			if (k[i] > k[largest])
+				largest = i;
+		}
+
+		/** flat areas stay exactly flat */
+		k[largest] += (1 << PRECISION_BITS) - sum;
+
+		c->bounds[out * 2] = first;
+		c->bounds[out * 2 + 1] = count;
+	}
+}
+
+static inline unsigned char
+Clamp8(int v)
+{
+	v >>= PRECISION_BITS;
+
+	return (unsigned char)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+}
+
+/** One output row of the horizontal pass */
+static void
+HorizontalRow(const unsigned char* src, unsigned char* dst, int outWidth, const Coefficients& c)
+{
+	for (int x = 0; x < outWidth; x++, dst += 4) {
+		const unsigned char* s = src + c.bounds[x * 2] * 4;
+		const int16_t* k = &c.weights[x * c.size];
+		int count = c.bounds[x * 2 + 1];
+		int i = 0;
+
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		__m128i sum = _mm_set1_epi32(1 << (PRECISION_BITS - 1));
+
+		/** two pixels per madd: [r0 r1 g0 g1 b0 b1 a0 a1] times [k0 k1 ...] */
+		for (; i + 1 < count; i += 2) {
+			__m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + i * 4)), zero);
+			px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+
+			__m128i w = _mm_set1_epi32((int)(((uint32_t)(uint16_t)k[i + 1] << 16) | (uint16_t)k[i]));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(px, w));
+		}
+
+		if (i < count) {
+			int32_t p;
+			memcpy(&p, s + i * 4, 4);
+
+			__m128i px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p), zero), zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32((uint16_t)k[i])));
+		}
+
+		sum = _mm_srai_epi32(sum, PRECISION_BITS);
+		sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+
+		int32_t out = _mm_cvtsi128_si32(sum);
+		memcpy(dst, &out, 4);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		int32x4_t sum = vdupq_n_s32(1 << (PRECISION_BITS - 1));
+
+		for (; i < count; i++) {
+			uint32_t p;
+			memcpy(&p, s + i * 4, 4);
+
+			int16x4_t px = vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(p)))));
+			sum = vmlal_n_s16(sum, px, k[i]);
+		}
+
+		int16x4_t narrow = vqshrn_n_s32(sum, PRECISION_BITS);
+		uint8x8_t out = vqmovun_s16(vcombine_s16(narrow, narrow));
+
+		vst1_lane_u32((uint32_t*)(void*)dst, vreinterpret_u32_u8(out), 0);
+#else
+		int sum[4] = {
+			1 << (PRECISION_BITS - 1), 1 << (PRECISION_BITS - 1),
+			1 << (PRECISION_BITS - 1), 1 << (PRECISION_BITS - 1)
+		};
+
+		for (; i < count; i++) {
+			sum[0] += s[i * 4 + 0] * k[i];
+			sum[1] += s[i * 4 + 1] * k[i];
+			sum[2] += s[i * 4 + 2] * k[i];
+			sum[3] += s[i * 4 + 3] * k[i];
+		}
+
+		dst[0] = Clamp8(sum[0]);
+		dst[1] = Clamp8(sum[1]);
+		dst[2] = Clamp8(sum[2]);
+		dst[3] = Clamp8(sum[3]);
+#endif
+	}
+}
+
+/** One output row of the vertical pass, bytes is width times 4 */
+static void
+VerticalRow(const unsigned char* src, int stride, unsigned char* dst, int bytes, const int16_t* k, int count)
+{
+	int x = 0;
+
+#if defined(__AVX2__)
+	const __m256i zero256 = _mm256_setzero_si256();
+
+	/** the unpacks and packs work per 128 bit lane and undo each other, the order is kept */
+	for (; x + 32 <= bytes; x += 32) {
+		__m256i s0 = _mm256_set1_epi32(1 << (PRECISION_BITS - 1));
+		__m256i s1 = s0, s2 = s0, s3 = s0;
+		int i = 0;
+
+		for (; i < count; i += 2) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)(src + i * stride + x));
+			__m256i b = (i + 1 < count) ? _mm256_loadu_si256((const __m256i*)(src + (i + 1) * stride + x)) : zero256;
+			int16_t k1 = (i + 1 < count) ? k[i + 1] : 0;
+
+			__m256i w = _mm256_set1_epi32((int)(((uint32_t)(uint16_t)k1 << 16) | (uint16_t)k[i]));
+
+			__m256i alo = _mm256_unpacklo_epi8(a, zero256);
+			__m256i ahi = _mm256_unpackhi_epi8(a, zero256);
+			__m256i blo = _mm256_unpacklo_epi8(b, zero256);
+			__m256i bhi = _mm256_unpackhi_epi8(b, zero256);
+
+			s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi16(alo, blo), w));
+			s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi16(alo, blo), w));
+			s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi16(ahi, bhi), w));
+			s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi16(ahi, bhi), w));
+		}
+
+		__m256i lo = _mm256_packs_epi32(_mm256_srai_epi32(s0, PRECISION_BITS), _mm256_srai_epi32(s1, PRECISION_BITS));
+		__m256i hi = _mm256_packs_epi32(_mm256_srai_epi32(s2, PRECISION_BITS), _mm256_srai_epi32(s3, PRECISION_BITS));
+
+		_mm256_storeu_si256((__m256i*)(dst + x), _mm256_packus_epi16(lo, hi));
+	}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 16 <= bytes; x += 16) {
+		__m128i s0 = _mm_set1_epi32(1 << (PRECISION_BITS - 1));
+		__m128i s1 = s0, s2 = s0, s3 = s0;
+		int i = 0;
+
+		/** two rows per madd, a missing second row weighs nothing */
+		for (; i < count; i += 2) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(src + i * stride + x));
+			__m128i b = (i + 1 < count) ? _mm_loadu_si128((const __m128i*)(src + (i + 1) * stride + x)) : zero;
+			int16_t k1 = (i + 1 < count) ? k[i + 1] : 0;
+
+			__m128i w = _mm_set1_epi32((int)(((uint32_t)(uint16_t)k1 << 16) | (uint16_t)k[i]));
+
+			__m128i alo = _mm_unpacklo_epi8(a, zero);
+			__m128i ahi = _mm_unpackhi_epi8(a, zero);
+			__m128i blo = _mm_unpacklo_epi8(b, zero);
+			__m128i bhi = _mm_unpackhi_epi8(b, zero);
+
+			s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), w));
+			s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), w));
+			s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), w));
+			s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), w));
+		}
+
+		__m128i lo = _mm_packs_epi32(_mm_srai_epi32(s0, PRECISION_BITS), _mm_srai_epi32(s1, PRECISION_BITS));
+		__m128i hi = _mm_packs_epi32(_mm_srai_epi32(s2, PRECISION_BITS), _mm_srai_epi32(s3, PRECISION_BITS));
+
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (; x + 8 <= bytes; x += 8) {
+		int32x4_t s0 = vdupq_n_s32(1 << (PRECISION_BITS - 1));
+		int32x4_t s1 = s0;
+
+		for (int i = 0; i < count; i++) {
+			int16x8_t px = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src + i * stride + x)));
+
+			s0 = vmlal_n_s16(s0, vget_low_s16(px), k[i]);
+			s1 = vmlal_n_s16(s1, vget_high_s16(px), k[i]);
+		}
+
+		int16x8_t narrow = vcombine_s16(vqshrn_n_s32(s0, PRECISION_BITS), vqshrn_n_s32(s1, PRECISION_BITS));
+
+		vst1_u8(dst + x, vqmovun_s16(narrow));
+	}
+#endif
+
+	for (; x < bytes; x++) {
+		int sum = 1 << (PRECISION_BITS - 1);
+
+		for (int i = 0; i < count; i++)
+			sum += src[i * stride + x] * k[i];
+
+		dst[x] = Clamp8(sum);
+	}
+}
+
+/** Premultiplied color can not exceed alpha, Lanczos' overshoot can */
+static void
+ClampToAlpha(unsigned char* p, int count)
+{
+	int i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		__m128i px = _mm_loadu_si128((const __m128i*)(p + i * 4));
+
+		/** alpha in all four bytes of each pixel, min() leaves alpha itself alone */
+		__m128i a = _mm_srli_epi32(px, 24);
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+		_mm_storeu_si128((__m128i*)(p + i * 4), _mm_min_epu8(px, a));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t px = vld4_u8(p + i * 4);
+
+		px.val[0] = vmin_u8(px.val[0], px.val[3]);
+		px.val[1] = vmin_u8(px.val[1], px.val[3]);
+		px.val[2] = vmin_u8(px.val[2], px.val[3]);
+
+		vst4_u8(p + i * 4, px);
+	}
+#endif
+
+	for (; i < count; i++) {
+		unsigned char a = p[i * 4 + 3];
+
+		for (int c = 0; c < 3; c++) {
+			if (p[i * 4 + c] > a)
+				p[i * 4 + c] = a;
+		}
+	}
+}
+
+struct Pass {
+	/** horizontal: src rows map 1:1 to dst rows; vertical: c picks the src rows */
+	bool bVertical;
+	const unsigned char* src;
+	int srcStride;
+	unsigned char* dst;
+	int dstStride;
+	int dstWidth;
+	const Coefficients* c;
+	bool bPremultiplied;
+};
+
+struct Slice {
+	const Pass* pass;
+	int first;
+	int last;
+};
+
+static void
+RunSlice(const Pass& pass, int first, int last)
+{
+	for (int y = first; y < last; y++) {
+		unsigned char* dst = pass.dst + y * pass.dstStride;
+
+		if (pass.bVertical) {
+			const Coefficients& c = *pass.c;
+			const unsigned char* src = pass.src + c.bounds[y * 2] * pass.srcStride;
+
+			VerticalRow(src, pass.srcStride, dst, pass.dstWidth * 4, &c.weights[y * c.size], c.bounds[y * 2 + 1]);
+
+			if (pass.bPremultiplied)
+				ClampToAlpha(dst, pass.dstWidth);
+		} else {
+			HorizontalRow(pass.src + y * pass.srcStride, dst, pass.dstWidth, *pass.c);
+		}
+	}
+}
+
+static void*
+_SliceThread(void* data)
+{
+	Slice* slice = (Slice*)data;
+
+	RunSlice(*slice->pass, slice->first, slice->last);
+
+	return NULL;
+}
+
+/** Splits the rows of a pass over the worker threads, the caller takes the first share */
+static void
+RunPass(const Pass& pass, int rows)
+{
+	int threads = Resampler::GetThreadCount();
+	int maxThreads = (int)(((long)rows * pass.dstWidth) / MIN_PIXELS_PER_THREAD);
+
+	if (threads > maxThreads)
+		threads = maxThreads;
+	if (threads > rows)
+		threads = rows;
+
+	if (threads <= 1) {
+		RunSlice(pass, 0, rows);
+		return;
+	}
+
+	Slice slices[MAX_THREADS];
+	pthread_t tids[MAX_THREADS];
+	bool bStarted[MAX_THREADS];
+
+	for (int i = 0; i < threads; i++) {
+		slices[i].pass = &pass;
+		slices[i].first = rows * i / threads;
+		slices[i].last = rows * (i + 1) / threads;
+		bStarted[i] = false;
+	}
+
+	for (int i = 1; i < threads; i++)
+		bStarted[i] = (pthread_create(&tids[i], NULL, _SliceThread, &slices[i]) == 0);
+
+	RunSlice(pass, slices[0].first, slices[0].last);
+
+	for (int i = 1; i < threads; i++) {
+		if (bStarted[i])
+			pthread_join(tids[i], NULL);
+		else
+			RunSlice(pass, slices[i].first, slices[i].last);
+	}
+}
+
+bool
+Resampler::Resize(const unsigned char* src, int srcWidth, int srcHeight, int srcStride,
+	unsigned char* dst, int dstWidth, int dstHeight, int dstStride,
+	Filter filter, bool bPremultiplied)
+{
+	if ((srcWidth <= 0) || (srcHeight <= 0) || (dstWidth <= 0) || (dstHeight <= 0))
+		return false;
+
+	Coefficients horizontal;
+	Coefficients vertical;
+
+	ComputeCoefficients(srcWidth, dstWidth, filter, &horizontal);
+	ComputeCoefficients(srcHeight, dstHeight, filter, &vertical);
+
+	/** only the source rows some output row reads go through the horizontal pass */
+	int firstRow = vertical.bounds[0];
+	int lastRow = vertical.bounds[(dstHeight - 1) * 2] + vertical.bounds[(dstHeight - 1) * 2 + 1];
+
+	for (int y = 0; y < dstHeight; y++)
+		vertical.bounds[y * 2] -= firstRow;
+
+	std::vector<unsigned char> temp((size_t)dstWidth * 4 * (lastRow - firstRow));
+
+	Pass pass;
+
+	pass.bVertical = false;
+	pass.src = src + firstRow * srcStride;
+	pass.srcStride = srcStride;
+	pass.dst = &temp[0];
+	pass.dstStride = dstWidth * 4;
+	pass.dstWidth = dstWidth;
+	pass.c = &horizontal;
+	pass.bPremultiplied = false;
+
+	RunPass(pass, lastRow - firstRow);
+
+	pass.bVertical = true;
+	pass.src = &temp[0];
+	pass.srcStride = dstWidth * 4;
+	pass.dst = dst;
+	pass.dstStride = dstStride;
+	pass.c = &vertical;
+	pass.bPremultiplied = bPremultiplied;
+
+	RunPass(pass, dstHeight);
+
+	return true;
+}
+
+void
+Resampler::SetThreadCount(int count)
+{
+	s_threads = (count < 1) ? 1 : ((count > MAX_THREADS) ? MAX_THREADS : count);
+}
+
+int
+Resampler::GetThreadCount()
+{
+	if (s_threads > 0)
+		return s_threads;
+
+	const char* env = getenv("WLTK_RESAMPLE_THREADS");
+	if (env && (atoi(env) > 0))
+		SetThreadCount(atoi(env));
+	else
+		SetThreadCount((int)sysconf(_SC_NPROCESSORS_ONLN));
+
+	return s_threads;
+}
+
+/** ResampleCache, least recently used at the back */
+typedef std::list<std::pair<std::string, ResampleCache::Entry> > CacheList;
+
+struct ResampleCacheState {
+	ResampleCacheState() : bytes(0), budget(0), bInitialized(false) {}
+
+	CacheList entries;
+	std::map<std::string, CacheList::iterator> index;
+	size_t bytes;
+	size_t budget;
+	bool bInitialized;
+};
+
+static ResampleCacheState s_cache;
+
+static void
+InitializeCache()
+{
+	if (s_cache.bInitialized)
+		return;
+
+	s_cache.bInitialized = true;
+	s_cache.budget = 4 * 1024 * 1024;
+
+	const char* env = getenv("WLTK_RESAMPLE_CACHE_KB");
+	if (env && (env[0] != '\0'))
+		s_cache.budget = (size_t)atoi(env) * 1024;
+}
+
+static void
+EvictLast()
+{
+	CacheList::iterator last = --s_cache.entries.end();
+
+	ResourceRegistry::Untrack(ResourceRegistry::kPixels, (uintptr_t)&last->second);
+
+	s_cache.bytes -= last->second.pixels.size();
+	s_cache.index.erase(last->first);
+	s_cache.entries.erase(last);
+}
+
+std::string
+ResampleCache::MakeKey(const std::string& path, int width, int height, Resampler::Filter filter)
+{
+	char size[48];
+	snprintf(size, sizeof(size), "#%dx%d/%d", width, height, (int)filter);
+
+	return path + size;
+}
+
+const ResampleCache::Entry*
+ResampleCache::Find(const std::string& key)
+{
+	std::map<std::string, CacheList::iterator>::iterator it = s_cache.index.find(key);
+	if (it == s_cache.index.end())
+		return NULL;
+
+	/** most recently used to the front, the iterators stay valid */
+	s_cache.entries.splice(s_cache.entries.begin(), s_cache.entries, it->second);
+
+	return &it->second->second;
+}
+
+void
+ResampleCache::Insert(const std::string& key, const unsigned char* pixels, int width, int height, uint32_t flags)
+{
+	InitializeCache();
+
+	size_t bytes = (size_t)width * height * 4;
+
+	if ((bytes > s_cache.budget) || (s_cache.index.find(key) != s_cache.index.end()))
+		return;
+
+	while (s_cache.bytes + bytes > s_cache.budget)
+		EvictLast();
+
+	s_cache.entries.push_front(std::make_pair(key, Entry()));
+
+	Entry& entry = s_cache.entries.front().second;
+	entry.pixels.assign(pixels, pixels + bytes);
+	entry.width = width;
+	entry.height = height;
+	entry.flags = flags;
+
+	s_cache.index[key] = s_cache.entries.begin();
+	s_cache.bytes += bytes;
+
+	ResourceRegistry::Track(ResourceRegistry::kPixels, (uintptr_t)&entry, bytes, "ResampleCache", key.c_str());
+}
+
+void
+ResampleCache::Clear()
+{
+	while (!s_cache.entries.empty())
+		EvictLast();
+}
+
+size_t
+ResampleCache::GetBytes()
+{
+	return s_cache.bytes;
+}
+
+} // End-of-namespace WLToolKit
@@ -0,0 +1,76 @@
+#ifndef WL_TOOLKIT_RESAMPLER_HPP
+#define WL_TOOLKIT_RESAMPLER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace WLToolKit {
+
+/**
+ * CPU resampling of 8 bit, 4 channel images, used to bring large assets
+ * down to the size they are shown at before they are uploaded.
+ *
+ * Separable: a horizontal pass into a temporary image, then a vertical one,
+ * both with 14 bit fixed point weights computed once per call. The inner
+ * loops use SSE2 (and AVX2 for the vertical pass when built with it) or
+ * NEON where the target has them, and large images are split by rows
+ * over WLTK_RESAMPLE_THREADS threads (the number of CPUs, up to 4, by
+ * default).
+ *
+ * Channels are filtered independently: feed premultiplied alpha to keep
+ * transparent texels from bleeding into their neighbours.
+ */
+class Resampler {
+public:
+	enum Filter {
+		kBox,			/** average of the covered pixels, cheapest */
+		kBilinear,		/** triangle, widened to the scale factor when shrinking */
+		kLanczos3		/** sharpest, some ringing on hard edges */
+	};
+
+	/**
+	 * Resamples src into dst, the two must not overlap. bPremultiplied
+	 * clamps the color channels to alpha after the negative lobes of
+	 * Lanczos. False for empty images.
+	 */
+	static bool Resize(const unsigned char* src, int srcWidth, int srcHeight, int srcStride,
+		unsigned char* dst, int dstWidth, int dstHeight, int dstStride,
+		Filter filter, bool bPremultiplied);
+
+	/** 1 disables the worker threads */
+	static void SetThreadCount(int count);
+	static int GetThreadCount();
+}; // End-of-class Resampler
+
+/**
+ * Resampled images by key (source path and size), least recently used
+ * first out once over the byte budget, WLTK_RESAMPLE_CACHE_KB (4 MB by
+ * default). Loading the same asset at the same size again then costs a
+ * copy instead of a decode and a resample.
+ */
+class ResampleCache {
+public:
+	struct Entry {
+		std::vector<unsigned char> pixels;	/** tightly packed rows */
+		int width;
+		int height;
+		uint32_t flags;						/** whatever the owner needs to rebuild its state */
+	};
+
+	static std::string MakeKey(const std::string& path, int width, int height, Resampler::Filter filter);
+
+	/** NULL on a miss; valid until the next Insert() */
+	static const Entry* Find(const std::string& key);
+
+	static void Insert(const std::string& key, const unsigned char* pixels, int width, int height, uint32_t flags);
+
+	static void Clear();
+	static size_t GetBytes();
+}; // End-of-class ResampleCache
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_RESAMPLER_HPP */
@@ -0,0 +1,260 @@
+#include <map>
+#include <string>
+
+extern "C" {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+}
+
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+struct ResourceEntry {
+	size_t bytes;
+	const char* creator;
+	std::string detail;
+};
+
+typedef std::map<uintptr_t, ResourceEntry> ResourceMap;
+
+struct ResourceRegistryState {
+	ResourceRegistryState()
+	: bInitialized(false), bOverBudget(), alarm(NULL), alarmData(NULL) {
+		memset(totals, 0, sizeof(totals));
+		memset(budgets, 0, sizeof(budgets));
+	}
+
+	bool bInitialized;
+
+	ResourceMap entries[ResourceRegistry::kNumCategories];
+	ResourceRegistry::Totals totals[ResourceRegistry::kNumCategories];
+
+	size_t budgets[ResourceRegistry::kNumCategories];
+	bool bOverBudget[ResourceRegistry::kNumCategories];
+
+	ResourceRegistry::AlarmFunc alarm;
+	void* alarmData;
+};
+
+static ResourceRegistryState s_registry;
+
+static const char* s_categoryNames[ResourceRegistry::kNumCategories] = {
+	"texture",
+	"buffer",
+	"shader",
+	"program",
+	"pixels",
+	"surface",
+};
+
+/** WLTK_RESOURCE_BUDGET is read on first use */
+static void
+Initialize()
+{
+	if (s_registry.bInitialized)
+		return;
+
+	s_registry.bInitialized = true;
+
+	const char* env = getenv("WLTK_RESOURCE_BUDGET");
+	if (!env)
+		return;
+
+	std::string budgets(env);
+	size_t start = 0;
+
+	while (start < budgets.size()) {
+		size_t end = budgets.find(',', start);
+		if (end == std::string::npos)
+			end = budgets.size();
+
+		std::string item = budgets.substr(start, end - start);
+		size_t eq = item.find('=');
+
+		if (eq != std::string::npos) {
+			std::string name = item.substr(0, eq);
+			size_t kb = (size_t)strtoul(item.c_str() + eq + 1, NULL, 10);
+
+			for (int i = 0; i < ResourceRegistry::kNumCategories; i++) {
+				if (name == s_categoryNames[i])
+					s_registry.budgets[i] = kb * 1024;
+			}
+		}
+
+		start = end + 1;
+	}
+}
+
+/** warns once per crossing, re-armed when the category drops below budget */
+static void
+CheckBudget(ResourceRegistry::Category category)
+{
+	size_t budget = s_registry.budgets[category];
+	size_t bytes = s_registry.totals[category].bytes;
+
+	if (!budget)
+		return;
+
+	if (bytes <= budget) {
+		s_registry.bOverBudget[category] = false;
+		return;
+	}
+
+	if (s_registry.bOverBudget[category])
+		return;
+
+	s_registry.bOverBudget[category] = true;
+
+	fprintf(stderr, "[WLToolKit] WARN: %s memory %zu KB is over the %zu KB budget\n",
+		s_categoryNames[category], bytes / 1024, budget / 1024);
+
+	if (s_registry.alarm)
+		s_registry.alarm(s_registry.alarmData, category, bytes, budget);
+}
+
+void
+ResourceRegistry::Track(Category category, uintptr_t id, size_t bytes, const char* creator, const char* detail)
+{
+	Initialize();
+
+	ResourceMap& entries = s_registry.entries[category];
+	Totals& totals = s_registry.totals[category];
+
+	/** a reused name that was never untracked: count the old one as gone */
+	ResourceMap::iterator it = entries.find(id);
+	if (it != entries.end()) {
+		totals.bytes -= it->second.bytes;
+		totals.count--;
+	}
+
+	ResourceEntry& entry = entries[id];
+	entry.bytes = bytes;
+	entry.creator = creator;
+	if (detail)
+		entry.detail = detail;
+	else
+		entry.detail.clear();
+
+	totals.count++;
+	totals.bytes += bytes;
+	if (totals.bytes > totals.peakBytes)
+		totals.peakBytes = totals.bytes;
+
+	CheckBudget(category);
+}
+
+void
+ResourceRegistry::Untrack(Category category, uintptr_t id)
+{
+	ResourceMap& entries = s_registry.entries[category];
+
+	ResourceMap::iterator it = entries.find(id);
+	if (it == entries.end())
+		return;
+
+	s_registry.totals[category].bytes -= it->second.bytes;
+	s_registry.totals[category].count--;
+
+	entries.erase(it);
+
+	CheckBudget(category);
+}
+
+void
+ResourceRegistry::Resize(Category category, uintptr_t id, size_t bytes)
+{
+	ResourceMap& entries = s_registry.entries[category];
+	Totals& totals = s_registry.totals[category];
+
+	ResourceMap::iterator it = entries.find(id);
+	if (it == entries.end())
+		return;
+
+	totals.bytes = totals.bytes - it->second.bytes + bytes;
+	if (totals.bytes > totals.peakBytes)
+		totals.peakBytes = totals.bytes;
+
+	it->second.bytes = bytes;
+
+	CheckBudget(category);
+}
+
+const ResourceRegistry::Totals&
+ResourceRegistry::GetTotals(Category category)
+{
+	return s_registry.totals[category];
+}
+
+void
+ResourceRegistry::SetBudget(Category category, size_t bytes)
+{
+	Initialize();
+
+	s_registry.budgets[category] = bytes;
+	s_registry.bOverBudget[category] = false;
+
+	CheckBudget(category);
+}
+
+void
+ResourceRegistry::SetAlarmCallback(AlarmFunc alarm, void* data)
+{
+	s_registry.alarm = alarm;
+	s_registry.alarmData = data;
+}
+
+void
+ResourceRegistry::Dump(FILE* fp)
+{
+	fprintf(fp, "[WLToolKit] resources: %-8s %6s %10s %10s\n", "category", "live", "KB", "peak KB");
+
+	for (int i = 0; i < kNumCategories; i++) {
+		const Totals& totals = s_registry.totals[i];
+
+		fprintf(fp, "[WLToolKit] resources: %-8s %6u %10zu %10zu\n",
+			s_categoryNames[i], totals.count, totals.bytes / 1024, totals.peakBytes / 1024);
+	}
+}
+
+unsigned int
+ResourceRegistry::DumpLeaks(FILE* fp)
+{
+	unsigned int leaks = 0;
+
+	for (int i = 0; i < kNumCategories; i++) {
+		const ResourceMap& entries = s_registry.entries[i];
+
+		for (ResourceMap::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+			fprintf(fp, "[WLToolKit] ERR: leaked %s %#lx, %zu bytes, from %s%s%s\n",
+				s_categoryNames[i], (unsigned long)it->first, it->second.bytes, it->second.creator,
+				it->second.detail.empty() ? "" : " ", it->second.detail.c_str());
+			leaks++;
+		}
+	}
+
+	return leaks;
+}
+
+void
+ResourceRegistry::OnTeardown()
+{
+	const char* env = getenv("WLTK_RESOURCES");
+	if (env && (env[0] != '\0') && (env[0] != '0'))
+		Dump(stderr);
+
+	DumpLeaks(stderr);
+}
+
+const char*
+ResourceRegistry::GetCategoryName(Category category)
+{
+	if ((category < 0) || (category >= kNumCategories))
+		return "unknown";
+
+	return s_categoryNames[category];
+}
+
+} // End-of-namespace WLToolKit
+
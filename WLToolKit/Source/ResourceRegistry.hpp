@@ -0,0 +1,68 @@
+#ifndef WL_TOOLKIT_RESOURCE_REGISTRY_HPP
+#define WL_TOOLKIT_RESOURCE_REGISTRY_HPP
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Accounting of the GL objects and CPU pixel memory WLToolKit holds.
+ *
+ * Every allocation is registered with its size and creator and removed
+ * again when it is freed, so live totals per category are always known and
+ * whatever is still registered when the Display goes away is a leak.
+ * Registration happens at allocation time only, never per frame.
+ *
+ * Runtime switches:
+ *   WLTK_RESOURCES=1                  print the totals at Display teardown
+ *   WLTK_RESOURCE_BUDGET=name=KB,...  warn when a category goes over budget,
+ *                                     e.g. "texture=16384,pixels=8192"
+ */
+
+namespace WLToolKit {
+
+class ResourceRegistry {
+public:
+	enum Category {
+		kTexture,		/** GL texture objects */
+		kBuffer,		/** GL buffer objects */
+		kShader,
+		kProgram,
+		kPixels,		/** CPU pixel memory: decoded images, cairo surfaces, staging */
+		kSurface,		/** EGL window surfaces, size is an estimate */
+		kNumCategories
+	};
+
+	struct Totals {
+		unsigned int count;
+		size_t bytes;
+		size_t peakBytes;
+	};
+
+	typedef void (*AlarmFunc)(void* data, Category category, size_t bytes, size_t budget);
+
+	/** id is the GL name or the address; creator must be a string literal */
+	static void Track(Category category, uintptr_t id, size_t bytes, const char* creator, const char* detail = NULL);
+	static void Untrack(Category category, uintptr_t id);
+	static void Resize(Category category, uintptr_t id, size_t bytes);
+
+	static const Totals& GetTotals(Category category);
+
+	/** 0 removes the budget */
+	static void SetBudget(Category category, size_t bytes);
+	static void SetAlarmCallback(AlarmFunc alarm, void* data);
+
+	static void Dump(FILE* fp);
+
+	/** Returns the number of live objects listed */
+	static unsigned int DumpLeaks(FILE* fp);
+
+	/** Called by the Display destructor */
+	static void OnTeardown();
+
+	static const char* GetCategoryName(Category category);
+}; // End-of-class ResourceRegistry
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_RESOURCE_REGISTRY_HPP */
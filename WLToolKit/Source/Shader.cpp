@@ -0,0 +1,128 @@
+#include "Common.hpp"
+#include "Shader.hpp"
+#include "StartupTrace.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+static const char *coverage_vert_shader_text =
+	"attribute vec2 pos;\n"
+	"attribute vec2 texcoord;\n"
+	"attribute vec4 color;\n"
+	"varying vec2 v_texcoord;\n"
+	"varying vec4 v_color;\n"
+	"void main() {\n"
+	"  gl_Position = vec4(pos, 0.0, 1.0);\n"
+	"  v_texcoord = texcoord;\n"
+	"  v_color = color;\n"
+	"}\n";
+
+/** premultiplies here, so the quads blend like every sprite */
+static const char *coverage_frag_shader_text =
+	"precision mediump float;\n"
+	"varying vec2 v_texcoord;\n"
+	"varying vec4 v_color;\n"
+	"uniform sampler2D atlas;\n"
+	"void main() {\n"
+	"  float a = v_color.a * texture2D(atlas, v_texcoord).a;\n"
+	"  gl_FragColor = vec4(v_color.rgb * a, a);\n"
+	"}\n";
+
+static const char *coverage_attributes[] = { "pos", "texcoord", "color", NULL };
+
+GLuint
+CreateShader(const char *source, GLenum type)
+{
+	GLuint shader;
+	GLint status;
+
+	shader = glCreateShader(type);
+	assert(shader != 0);
+
+	ResourceRegistry::Track(ResourceRegistry::kShader, shader, 0, "CreateShader",
+		(type == GL_VERTEX_SHADER) ? "vertex" : "fragment");
+
+	glShaderSource(shader, 1, (const char **) &source, NULL);
+	glCompileShader(shader);
+
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		char log[1000];
+		GLsizei len;
+		glGetShaderInfoLog(shader, 1000, &len, log);
+		fprintf(stderr, "[WLToolKit] ERR: compiling %s: %*s\n", ((type == GL_VERTEX_SHADER) ? "vertex" : "fragment"), len, log);
+		DeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+GLuint
+CreateProgram(const char* vertSource, const char* fragSource, const char* const* attributes)
+{
+	GLuint frag, vert;
+	GLuint program;
+	GLint status;
+
+	StartupTrace::Scope scope("shader compile");
+
+	frag = CreateShader(fragSource, GL_FRAGMENT_SHADER);
+	if (!frag)
+		return 0;
+
+	vert = CreateShader(vertSource, GL_VERTEX_SHADER);
+	if (!vert) {
+		DeleteShader(frag);
+		return 0;
+	}
+
+	program = glCreateProgram();
+	ResourceRegistry::Track(ResourceRegistry::kProgram, program, 0, "CreateProgram");
+	glAttachShader(program, frag);
+	glAttachShader(program, vert);
+
+	for (GLuint i = 0; attributes && attributes[i]; i++)
+		glBindAttribLocation(program, i, attributes[i]);
+
+	glLinkProgram(program);
+
+	/** the program keeps the compiled code, the shader objects are not needed anymore */
+	DeleteShader(frag);
+	DeleteShader(vert);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		char log[1000];
+		GLsizei len;
+		glGetProgramInfoLog(program, 1000, &len, log);
+		fprintf(stderr, "[WLToolKit] ERR: linking:\n%*s\n", len, log);
+		DeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+GLuint
+CreateCoverageProgram()
+{
+	return CreateProgram(coverage_vert_shader_text, coverage_frag_shader_text, coverage_attributes);
+}
+
+void
+DeleteShader(GLuint shader)
+{
+	ResourceRegistry::Untrack(ResourceRegistry::kShader, shader);
+	glDeleteShader(shader);
+}
+
+void
+DeleteProgram(GLuint program)
+{
+	ResourceRegistry::Untrack(ResourceRegistry::kProgram, program);
+	glDeleteProgram(program);
+}
+
+} // End-of-namespace WLToolKit
+
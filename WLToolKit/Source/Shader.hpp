@@ -0,0 +1,33 @@
+#ifndef WL_TOOLKIT_SHADER_HPP
+#define WL_TOOLKIT_SHADER_HPP
+
+#include "Common.hpp"
+
+namespace WLToolKit {
+
+/** Returns 0 and prints the info log when compilation fails */
+GLuint CreateShader(const char* source, GLenum type);
+
+/**
+ * Compiles and links a program. attributes is a NULL terminated list,
+ * each name is bound to its index in the list before linking.
+ * Returns 0 and prints the info log on failure.
+ */
+GLuint CreateProgram(const char* vertSource, const char* fragSource, const char* const* attributes);
+
+/**
+ * Program for quads in clip space whose texture (unit 0, uniform "atlas")
+ * only holds coverage in its alpha, tinted by a straight alpha vertex
+ * color: glyphs of the TextRenderer, the PerfHUD. Attributes 0 pos,
+ * 1 texcoord and 2 color. It writes premultiplied color, blend it with
+ * PremultipliedBlend like the Renderer's sprites.
+ */
+GLuint CreateCoverageProgram();
+
+/** Counterparts of the above, keep ResourceRegistry in sync */
+void DeleteShader(GLuint shader);
+void DeleteProgram(GLuint program);
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_SHADER_HPP */
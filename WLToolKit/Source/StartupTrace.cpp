@@ -0,0 +1,228 @@
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+}
+
+#include "Clock.hpp"
+#include "StartupTrace.hpp"
+
+namespace WLToolKit {
+
+struct StartupPhase {
+	std::string name;
+	std::string detail;
+	uint64_t startNs;
+	uint64_t endNs;			/** 0 while open */
+	int depth;
+	bool bInstant;
+};
+
+struct StartupTraceState {
+	StartupTraceState()
+	: bStarted(false), bFinished(false), originNs(0), firstFrameNs(0), depth(0) {}
+
+	bool bStarted;
+	bool bFinished;
+
+	uint64_t originNs;
+	uint64_t firstFrameNs;
+	int depth;
+
+	std::vector<StartupPhase> phases;
+};
+
+static StartupTraceState s_startup;
+
+static void WriteEscaped(FILE* fp, const std::string& str);
+
+void
+StartupTrace::Start()
+{
+	if (s_startup.bStarted)
+		return;
+
+	s_startup.bStarted = true;
+	s_startup.originNs = Clock::NowNs();
+	s_startup.phases.reserve(64);
+}
+
+int
+StartupTrace::BeginPhase(const char* name, const char* detail)
+{
+	if (s_startup.bFinished)
+		return -1;
+
+	Start();
+
+	StartupPhase phase;
+	phase.name = name;
+	if (detail)
+		phase.detail = detail;
+	phase.startNs = Clock::NowNs();
+	phase.endNs = 0;
+	phase.depth = s_startup.depth++;
+	phase.bInstant = false;
+
+	s_startup.phases.push_back(phase);
+
+	return (int)s_startup.phases.size() - 1;
+}
+
+void
+StartupTrace::EndPhase(int index)
+{
+	if ((index < 0) || (index >= (int)s_startup.phases.size()))
+		return;
+
+	s_startup.phases[index].endNs = Clock::NowNs();
+	s_startup.depth--;
+}
+
+void
+StartupTrace::Mark(const char* name)
+{
+	if (s_startup.bFinished)
+		return;
+
+	Start();
+
+	StartupPhase phase;
+	phase.name = name;
+	phase.startNs = Clock::NowNs();
+	phase.endNs = phase.startNs;
+	phase.depth = s_startup.depth;
+	phase.bInstant = true;
+
+	s_startup.phases.push_back(phase);
+}
+
+void
+StartupTrace::Finish()
+{
+	if (s_startup.bFinished || !s_startup.bStarted)
+		return;
+
+	Mark("first frame presented");
+
+	s_startup.bFinished = true;
+	s_startup.firstFrameNs = Clock::NowNs();
+
+	const char* env = getenv("WLTK_STARTUP_TRACE");
+	if (env && (env[0] != '\0') && (env[0] != '0'))
+		Dump(stderr);
+
+	const char* path = getenv("WLTK_STARTUP_TRACE_JSON");
+	if (path && (path[0] != '\0'))
+		WriteJSON(path);
+}
+
+bool
+StartupTrace::IsFinished()
+{
+	return s_startup.bFinished;
+}
+
+uint64_t
+StartupTrace::GetTimeToFirstFrameNs()
+{
+	if (!s_startup.bFinished)
+		return 0;
+
+	return s_startup.firstFrameNs - s_startup.originNs;
+}
+
+void
+StartupTrace::Dump(FILE* fp)
+{
+	fprintf(fp, "[WLToolKit] startup: %.2f ms to first frame\n", GetTimeToFirstFrameNs() / 1000000.0);
+
+	for (size_t i = 0; i < s_startup.phases.size(); i++) {
+		const StartupPhase& phase = s_startup.phases[i];
+		double startMs = (phase.startNs - s_startup.originNs) / 1000000.0;
+
+		fprintf(fp, "[WLToolKit]   %8.2f ms  %*s%s", startMs, phase.depth * 2, "", phase.name.c_str());
+
+		if (!phase.detail.empty())
+			fprintf(fp, " (%s)", phase.detail.c_str());
+
+		if (phase.bInstant)
+			fprintf(fp, "\n");
+		else if (phase.endNs)
+			fprintf(fp, ": %.2f ms\n", (phase.endNs - phase.startNs) / 1000000.0);
+		else
+			fprintf(fp, ": unfinished\n");
+	}
+}
+
+bool
+StartupTrace::WriteJSON(const char* path)
+{
+	FILE* fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "[WLToolKit] ERR: cannot open %s\n", path);
+		return false;
+	}
+
+	int pid = (int)getpid();
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"WLToolKit startup\"}}", pid, pid);
+
+	for (size_t i = 0; i < s_startup.phases.size(); i++) {
+		const StartupPhase& phase = s_startup.phases[i];
+
+		/** timestamps are microseconds relative to Start() */
+		double ts = (phase.startNs - s_startup.originNs) / 1000.0;
+
+		fprintf(fp, ",\n{\"name\":");
+		WriteEscaped(fp, phase.name);
+		fprintf(fp, ",\"cat\":\"startup\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", pid, pid, ts);
+
+		if (phase.bInstant) {
+			fprintf(fp, ",\"ph\":\"i\",\"s\":\"p\"");
+		} else {
+			uint64_t endNs = phase.endNs ? phase.endNs : s_startup.firstFrameNs;
+			fprintf(fp, ",\"ph\":\"X\",\"dur\":%.3f", (endNs - phase.startNs) / 1000.0);
+		}
+
+		if (!phase.detail.empty()) {
+			fprintf(fp, ",\"args\":{\"detail\":");
+			WriteEscaped(fp, phase.detail);
+			fprintf(fp, "}");
+		}
+
+		fprintf(fp, "}");
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	return true;
+}
+
+static void
+WriteEscaped(FILE* fp, const std::string& str)
+{
+	fputc('"', fp);
+
+	for (size_t i = 0; i < str.size(); i++) {
+		unsigned char c = str[i];
+
+		if ((c == '"') || (c == '\\'))
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+
+	fputc('"', fp);
+}
+
+} // End-of-namespace WLToolKit
+
@@ -0,0 +1,59 @@
+#ifndef WL_TOOLKIT_STARTUP_TRACE_HPP
+#define WL_TOOLKIT_STARTUP_TRACE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Startup phase tracing.
+ *
+ * Phases are recorded from Start() (HomeScreen calls it first thing) until
+ * the first frame callback that follows the first eglSwapBuffers(), which
+ * is when the compositor has presented the window. Recording stops there,
+ * so the scopes cost nothing once the application is running.
+ *
+ * Runtime switches:
+ *   WLTK_STARTUP_TRACE=1          print the phase summary to stderr
+ *   WLTK_STARTUP_TRACE_JSON=path  write the phases as Chrome trace JSON,
+ *                                 loadable in chrome://tracing or Perfetto
+ */
+
+namespace WLToolKit {
+
+class StartupTrace {
+public:
+	/** Times the enclosing block; detail ends up in the JSON args */
+	class Scope {
+	public:
+		Scope(const char* name, const char* detail = NULL)
+		: m_index(StartupTrace::BeginPhase(name, detail)) {}
+		~Scope() { StartupTrace::EndPhase(m_index); }
+
+	private:
+		int m_index;
+	}; // End-of-class Scope
+
+	/** Origin of the timeline; the first phase starts it implicitly */
+	static void Start();
+
+	/** Returns -1 when recording has already finished */
+	static int BeginPhase(const char* name, const char* detail = NULL);
+	static void EndPhase(int index);
+
+	/** Instant event */
+	static void Mark(const char* name);
+
+	/** Called by WindowEGL on the first frame callback after the first swap */
+	static void Finish();
+	static bool IsFinished();
+
+	/** 0 until Finish() */
+	static uint64_t GetTimeToFirstFrameNs();
+
+	static void Dump(FILE* fp);
+	static bool WriteJSON(const char* path);
+}; // End-of-class StartupTrace
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_STARTUP_TRACE_HPP */
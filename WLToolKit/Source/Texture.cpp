@@ -2,28 +2,48 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <math.h>
+
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include "Common.hpp"
 #include "WindowEGL.hpp"
 #include "Texture.hpp"
+#include "Renderer.hpp"
+#include "TextureImpl.hpp"
+#include "Resampler.hpp"
+#include "ImageDecoder.hpp"
+#include "Capabilities.hpp"
+#include "StartupTrace.hpp"
+#include "ResourceRegistry.hpp"
 
 namespace WLToolKit {
 
-static bool IsFileExists(const char *filename);
+/** largest @Nx a sized Load() looks for above the asset scale */
+static const int kMaxVariantScale = 4;
 
-struct TextureImpl {
-	TextureImpl() : width(0), height(0), stride(0), pixels(NULL), bLoaded(false) {}
+/** ResampleCache::Entry flags */
+#define CACHED_RGB24	(1 << 0)
 
-	int width;
-	int height;
-	int stride;
-	unsigned char *pixels;
+static int s_assetScale = 1;
 
-	bool bLoaded;
+/** kNumFormats until the environment was read */
+static TextureFormat::Format s_defaultFormat = TextureFormat::kNumFormats;
 
-	GLuint texture;
-};
+static bool IsFileExists(const char *filename);
+static std::string FindVariant(const std::string& filename, int scale, bool bLarger, int* pFound);
+static void SetPixels(TextureImpl *impl, unsigned char *pixels, int width, int height, const std::string& path);
+static bool AllocatePixels(TextureImpl *impl, int width, int height, const std::string& path);
+static void FreePixels(TextureImpl *impl);
+static bool Shrink(TextureImpl *impl, int width, int height, const std::string& path);
+static void AddOpaqueRects(WindowEGL *window, TextureImpl *impl, int x, int y, float scale);
+
+Texture::Texture()
+{
+	m_pImpl = new TextureImpl;
+}
 
 Texture::Texture(const char *filename)
 {
@@ -34,6 +54,8 @@ Texture::Texture(const char *filename)
 
 Texture::~Texture()
 {
+	Release();
+
 	delete m_pImpl;
 }
 
@@ -46,41 +68,138 @@ Texture::IsLoaded()
 bool
 Texture::Load(const char *filename)
 {
-	if (!IsFileExists(filename)) {
+	m_pImpl->targetWidth = 0;
+	m_pImpl->targetHeight = 0;
+
+	return LoadScaled(filename, s_assetScale);
+}
+
+bool
+Texture::Load(const char *filename, int width, int height)
+{
+	if ((width <= 0) || (height <= 0))
+		return Load(filename);
+
+	m_pImpl->targetWidth = width;
+	m_pImpl->targetHeight = height;
+
+	return LoadScaled(filename, s_assetScale);
+}
+
+bool
+Texture::LoadScaled(const char *filename, int scale)
+{
+	/** filename may be our own copy when reloading for another scale */
+	std::string name = filename;
+	bool bSized = (m_pImpl->targetWidth > 0);
+
+	int found = 1;
+	std::string path = FindVariant(name, scale, bSized, &found);
+
+	if (!IsFileExists(path.c_str())) {
 		Release();
+		m_pImpl->filename.clear();
 		return false;
 	}
 
 	Release();
 
-	cairo_surface_t* surface = cairo_image_surface_create_from_png(filename);
+	m_pImpl->filename = name;
+	m_pImpl->path = path;
+	m_pImpl->requestedScale = scale;
 
-	cairo_format_t format = cairo_image_surface_get_format(surface);
-	if ((format != CAIRO_FORMAT_ARGB32) && (format != CAIRO_FORMAT_RGB24)) {
-		fprintf(stderr, "[WLToolKit] ERR: format(%d) is not supported\n", format);
-		return false;
+	StartupTrace::Scope scope("texture load", path.c_str());
+
+	/** in pixels, what the texture would hold at its display size */
+	int pixelWidth = m_pImpl->targetWidth * scale;
+	int pixelHeight = m_pImpl->targetHeight * scale;
+	std::string key;
+	bool bRGB24 = false;
+
+	const ResampleCache::Entry* cached = NULL;
+	if (bSized) {
+		key = ResampleCache::MakeKey(path, pixelWidth, pixelHeight, Resampler::kLanczos3);
+		cached = ResampleCache::Find(key);
 	}
 
-	m_pImpl->width = cairo_image_surface_get_width(surface);
-	m_pImpl->height = cairo_image_surface_get_height(surface);
-	m_pImpl->stride = cairo_image_surface_get_stride(surface);
+	if (cached) {
+		if (!AllocatePixels(m_pImpl, cached->width, cached->height, path))
+			return false;
+
+		memcpy(m_pImpl->pixels, &cached->pixels[0], cached->pixels.size());
+
+		m_pImpl->scale = scale;
+		bRGB24 = (cached->flags & CACHED_RGB24) != 0;
+	} else {
+		/** sized loads let the decoder shrink on the way (JPEG) */
+		DecodedImage image;
+
+		int decodePhase = StartupTrace::BeginPhase("decode");
+		bool bDecoded = ImageDecoder::Load(path.c_str(), bSized ? pixelWidth : 0, bSized ? pixelHeight : 0, &image);
+		StartupTrace::EndPhase(decodePhase);
 
-	unsigned char* data = cairo_image_surface_get_data(surface);
+		if (!bDecoded)
+			return false;
 
-	m_pImpl->pixels = new unsigned char[m_pImpl->stride * m_pImpl->height];
+		SetPixels(m_pImpl, image.pixels, image.width, image.height, path);
+		m_pImpl->scale = found;
+		bRGB24 = image.bOpaque;
 
-	for (int y = 0; y < m_pImpl->height; y++) {
-		for (int x = 0; x < m_pImpl->width; x++) {
-			int idx = (y * m_pImpl->width + x) << 2;
+		/** decoders hand out premultiplied pixels, which is what the filter wants */
+		if (bSized && ((pixelWidth < m_pImpl->width) || (pixelHeight < m_pImpl->height))) {
+			int resamplePhase = StartupTrace::BeginPhase("resample");
 
-			m_pImpl->pixels[idx + 0] = data[idx + 2];
-			m_pImpl->pixels[idx + 1] = data[idx + 1];
-			m_pImpl->pixels[idx + 2] = data[idx + 0];
-			m_pImpl->pixels[idx + 3] = data[idx + 3];
+			if (!Shrink(m_pImpl, pixelWidth, pixelHeight, path)) {
+				FreePixels(m_pImpl);
+				return false;
+			}
+			m_pImpl->scale = scale;
+
+			ResampleCache::Insert(key, m_pImpl->pixels, pixelWidth, pixelHeight, bRGB24 ? CACHED_RGB24 : 0);
+
+			StartupTrace::EndPhase(resamplePhase);
 		}
 	}
 
-	cairo_surface_destroy(surface);
+	/** GL would refuse it; keep the size it is shown at, TiledTexture shows all of its pixels */
+	const Capabilities* caps = Capabilities::GetCurrent();
+	int maxSize = caps ? caps->GetMaxTextureSize() : 0;
+
+	if ((maxSize > 0) && ((m_pImpl->width > maxSize) || (m_pImpl->height > maxSize))) {
+		fprintf(stderr, "[WLToolKit] WARN: %s is %dx%d, more than GL_MAX_TEXTURE_SIZE %d; shrinking it\n",
+			path.c_str(), m_pImpl->width, m_pImpl->height, maxSize);
+
+		if (m_pImpl->targetWidth <= 0) {
+			m_pImpl->targetWidth = m_pImpl->width / m_pImpl->scale;
+			m_pImpl->targetHeight = m_pImpl->height / m_pImpl->scale;
+		}
+
+		float fit = std::min((float)maxSize / m_pImpl->width, (float)maxSize / m_pImpl->height);
+
+		if (!Shrink(m_pImpl, std::max(1, std::min(maxSize, (int)(m_pImpl->width * fit))),
+				std::max(1, std::min(maxSize, (int)(m_pImpl->height * fit))), path)) {
+			FreePixels(m_pImpl);
+			return false;
+		}
+	}
+
+	int opacityPhase = StartupTrace::BeginPhase("opacity");
+
+	/** RGB24 has no alpha at all; tiles only pay off for images spanning a few of them */
+	if (bRGB24) {
+		m_pImpl->opacity.Set(OpacityMap::kOpaque);
+	} else {
+		bool bTiles = (m_pImpl->width >= OpacityMap::kTileSize * 2) || (m_pImpl->height >= OpacityMap::kTileSize * 2);
+
+		m_pImpl->opacity.Classify(m_pImpl->pixels, m_pImpl->width, m_pImpl->height, m_pImpl->width * 4, bTiles);
+	}
+
+	if (!m_pImpl->bOpaqueSet)
+		m_pImpl->bOpaque = (m_pImpl->opacity.GetOpacity() == OpacityMap::kOpaque);
+
+	StartupTrace::EndPhase(opacityPhase);
+
+	StartupTrace::Scope uploadScope("upload");
 
 	glGenTextures(1, &m_pImpl->texture);
 	glBindTexture(GL_TEXTURE_2D, m_pImpl->texture);
@@ -88,18 +207,37 @@ Texture::Load(const char *filename)
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_pImpl->width, m_pImpl->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pImpl->pixels);
+	TextureFormat::Format format = m_pImpl->bFormatSet ? m_pImpl->format : GetDefaultFormat();
+	if (format == TextureFormat::kAuto)
+		format = TextureFormat::Choose(m_pImpl->pixels, m_pImpl->width, m_pImpl->height,
+			m_pImpl->opacity.GetOpacity() == OpacityMap::kOpaque);
+
+	m_pImpl->storedFormat = format;
+
+	if (format == TextureFormat::kRGBA8888) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_pImpl->width, m_pImpl->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pImpl->pixels);
+	} else {
+		/** dithered once here, the CPU copy stays 8 bit */
+		std::vector<uint16_t> converted((size_t)m_pImpl->width * m_pImpl->height);
+		TextureFormat::Convert(m_pImpl->pixels, m_pImpl->width, m_pImpl->height, format, &converted[0]);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+		glTexImage2D(GL_TEXTURE_2D, 0, TextureFormat::GetGLFormat(format), m_pImpl->width, m_pImpl->height, 0,
+			TextureFormat::GetGLFormat(format), TextureFormat::GetGLType(format), &converted[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 
+	ResourceRegistry::Track(ResourceRegistry::kTexture, m_pImpl->texture,
+		(size_t)m_pImpl->width * m_pImpl->height * TextureFormat::GetBytesPerPixel(format), "Texture::Load", path.c_str());
+
 #if 0
-	fprintf(stderr, "[WLToolKit] DBG: filename=%s\n", filename);
+	fprintf(stderr, "[WLToolKit] DBG: filename=%s\n", path.c_str());
 	fprintf(stderr, "[WLToolKit] DBG: width=%d\n", m_pImpl->width);
 	fprintf(stderr, "[WLToolKit] DBG: height=%d\n", m_pImpl->height);
 	fprintf(stderr, "[WLToolKit] DBG: stride=%d\n", m_pImpl->stride);
-	fprintf(stderr, "[WLToolKit] DBG: format=%d\n", format);
 	fprintf(stderr, "[WLToolKit] DBG: texture=%d\n", m_pImpl->texture);
 #endif
 
@@ -115,12 +253,19 @@ Texture::Release()
 		m_pImpl->width = 0;
 		m_pImpl->height = 0;
 		m_pImpl->stride = 0;
+		m_pImpl->scale = 1;
 
+		ResourceRegistry::Untrack(ResourceRegistry::kPixels, (uintptr_t)m_pImpl->pixels);
 		delete[] m_pImpl->pixels;
 		m_pImpl->pixels = NULL;
 
+		m_pImpl->opacity.Set(OpacityMap::kMixed);
+
 		m_pImpl->bLoaded = false;
 
+		/** recycled textures (GridView cells) reload often, do not leak the old name */
+		ResourceRegistry::Untrack(ResourceRegistry::kTexture, m_pImpl->texture);
+		glDeleteTextures(1, &m_pImpl->texture);
 		m_pImpl->texture = 0;
 	}
 }
@@ -128,13 +273,25 @@ Texture::Release()
 int
 Texture::GetWidth()
 {
-	return m_pImpl->width;
+	if (m_pImpl->bLoaded && (m_pImpl->targetWidth > 0))
+		return m_pImpl->targetWidth;
+
+	return m_pImpl->width / m_pImpl->scale;
 }
 
 int
 Texture::GetHeight()
 {
-	return m_pImpl->height;
+	if (m_pImpl->bLoaded && (m_pImpl->targetHeight > 0))
+		return m_pImpl->targetHeight;
+
+	return m_pImpl->height / m_pImpl->scale;
+}
+
+int
+Texture::GetScale()
+{
+	return m_pImpl->scale;
 }
 
 int
@@ -149,12 +306,106 @@ Texture::GetPixels()
 	return m_pImpl->pixels;
 }
 
+void
+Texture::SetOpaque(bool opaque)
+{
+	m_pImpl->bOpaque = opaque;
+	m_pImpl->bOpaqueSet = true;
+}
+
+bool
+Texture::IsOpaque()
+{
+	return m_pImpl->bOpaque;
+}
+
+void
+Texture::SetFormat(TextureFormat::Format format)
+{
+	m_pImpl->format = format;
+	m_pImpl->bFormatSet = true;
+}
+
+TextureFormat::Format
+Texture::GetFormat()
+{
+	return m_pImpl->storedFormat;
+}
+
+void
+Texture::SetDefaultFormat(TextureFormat::Format format)
+{
+	s_defaultFormat = format;
+}
+
+TextureFormat::Format
+Texture::GetDefaultFormat()
+{
+	if (s_defaultFormat == TextureFormat::kNumFormats) {
+		s_defaultFormat = TextureFormat::kAuto;
+
+		const char* env = getenv("WLTK_TEXTURE_FORMAT");
+		if (env && !TextureFormat::Parse(env, &s_defaultFormat))
+			fprintf(stderr, "[WLToolKit] ERR: WLTK_TEXTURE_FORMAT=%s is not a format\n", env);
+	}
+
+	return s_defaultFormat;
+}
+
+OpacityMap::Opacity
+Texture::GetOpacity()
+{
+	return m_pImpl->opacity.GetOpacity();
+}
+
+const OpacityMap&
+Texture::GetOpacityMap()
+{
+	return m_pImpl->opacity;
+}
+
 void
 Texture::Draw(WindowEGL *window, int x, int y)
+{
+	QueueSprite(window, x, y, 1.0f, 0xffffffff);
+}
+
+void
+Texture::Draw(WindowEGL *window, int x, int y, float scale)
+{
+	QueueSprite(window, x, y, scale, 0xffffffff);
+}
+
+void
+Texture::Draw(WindowEGL *window, int x, int y, float scale, uint32_t color)
+{
+	QueueSprite(window, x, y, scale, color);
+}
+
+void
+Texture::QueueSprite(WindowEGL *window, int x, int y, float scale, uint32_t color)
 {
 	if (!IsLoaded())
 		return;
 
+	/** the window moved to an output of another scale, use the asset made for it */
+	if (!m_pImpl->filename.empty() && (window->GetBufferScale() != m_pImpl->requestedScale)) {
+		int found;
+		std::string path = FindVariant(m_pImpl->filename, window->GetBufferScale(), m_pImpl->targetWidth > 0, &found);
+
+		if (path != m_pImpl->path)
+			LoadScaled(m_pImpl->filename.c_str(), window->GetBufferScale());
+		else
+			m_pImpl->requestedScale = window->GetBufferScale();
+
+		if (!IsLoaded())
+			return;
+	}
+
+	/** nothing to see, unless the caller insists */
+	if (!m_pImpl->bOpaque && (m_pImpl->opacity.GetOpacity() == OpacityMap::kTransparent))
+		return;
+
 	GLfloat left	= ((float)x / window->GetWidth()) * 2.0f - 1.0f;
 	GLfloat top		= ((float)y / window->GetHeight()) * 2.0f - 1.0f;
 	GLfloat right	= ((float)(x + GetWidth()) / window->GetWidth()) * 2.0f - 1.0f;
@@ -162,141 +413,231 @@ Texture::Draw(WindowEGL *window, int x, int y)
 	top = -top;
 	bottom = -bottom;
 
-	GLfloat vertices[] = {
-		left,  top,
-		left,  bottom,
-		right, top,
-		right, bottom,
+	/** scales around the window center, as the rotation matrix used to */
+	const GLfloat rect[] = {
+		left * scale,
+		top * scale,
+		right * scale,
+		bottom * scale,
 	};
 
-	GLfloat texCoords[] = {
+	static const GLfloat uv[] = {
 		0.0f, 0.0f,		// left top
-		0.0f, 1.0f,		// left bottom
-		1.0f, 0.0f,		// right top
 		1.0f, 1.0f,		// right bottom
 	};
 
-	GLfloat matrix[] = {
-		1.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, 1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f, 1.0f, 0.0f,
-		0.0f, 0.0f, 0.0f, 1.0f,
-	};
+	/** batched, the GL work happens in Renderer::Flush(); a fade of an opaque texture blends */
+	Renderer::Blend blend = (m_pImpl->bOpaque && ((color >> 24) == 0xff)) ? Renderer::kBlendOpaque : Renderer::kBlendPremultiplied;
 
-	glUniformMatrix4fv(window->GetRotationUniform(), 1, GL_FALSE, matrix);
+	window->GetRenderer()->AddSprite(m_pImpl->texture, rect, uv, blend, color);
 
-	glVertexAttribPointer(window->GetVertexAttribute(),		2, GL_FLOAT, GL_FALSE, 0, vertices);
-	glVertexAttribPointer(window->GetTexCoordAttribute(),	2, GL_FLOAT, GL_FALSE, 0, texCoords);
+	/** a translucent tint or a transform hides where the opaque pixels end up */
+	if (((color >> 24) == 0xff) && !window->GetRenderer()->IsTransformed())
+		AddOpaqueRects(window, m_pImpl, x, y, scale);
+}
 
-	glEnableVertexAttribArray(window->GetVertexAttribute());
-	glEnableVertexAttribArray(window->GetTexCoordAttribute());
-	glEnableVertexAttribArray(GL_TEXTURE_2D);
+void
+Texture::SetAssetScale(int scale)
+{
+	s_assetScale = (scale > 0) ? scale : 1;
+}
 
-	glBindTexture(GL_TEXTURE_2D, m_pImpl->texture);
+int
+Texture::GetAssetScale()
+{
+	return s_assetScale;
+}
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_BLEND);
+size_t
+Texture::GetTotalMemory()
+{
+	return ResourceRegistry::GetTotals(ResourceRegistry::kTexture).bytes;
+}
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+static bool
+IsOpaqueTile(const OpacityMap& map, int column, int row)
+{
+	if ((column < 0) || (row < 0) || (column >= map.GetColumns()) || (row >= map.GetRows()))
+		return false;
 
-	glDisable(GL_BLEND);
+	return map.GetTile(column, row) == OpacityMap::kOpaque;
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+/** Shrinks to whole window pixels, partly covered edge pixels are blended */
+static void
+AddInnerRect(WindowEGL *window, float left, float top, float right, float bottom)
+{
+	int x0 = (int)ceilf(left);
+	int y0 = (int)ceilf(top);
+	int x1 = (int)floorf(right);
+	int y1 = (int)floorf(bottom);
 
-	glDisableVertexAttribArray(GL_TEXTURE_2D);
-	glDisableVertexAttribArray(window->GetTexCoordAttribute());
-	glDisableVertexAttribArray(window->GetVertexAttribute());
+	window->AddOpaqueRect(x0, y0, x1 - x0, y1 - y0);
 }
 
-void
-Texture::Draw(WindowEGL *window, int x, int y, float scale)
+/** Reports the window pixels a sprite covers with opaque texels */
+static void
+AddOpaqueRects(WindowEGL *window, TextureImpl *impl, int x, int y, float scale)
 {
-	if (!IsLoaded())
+	/** same scaling around the window center as the sprite rect */
+	float cx = window->GetWidth() * 0.5f;
+	float cy = window->GetHeight() * 0.5f;
+	float left = cx + (x - cx) * scale;
+	float top = cy + (y - cy) * scale;
+
+	/** window units per texel, a sized texture may be stretched unevenly */
+	float scaleX = scale / impl->scale;
+	float scaleY = scaleX;
+	if (impl->targetWidth > 0) {
+		scaleX = scale * impl->targetWidth / impl->width;
+		scaleY = scale * impl->targetHeight / impl->height;
+	}
+
+	if (impl->bOpaque) {
+		AddInnerRect(window, left, top, left + impl->width * scaleX, top + impl->height * scaleY);
 		return;
+	}
 
-#if 1
-	GLfloat left	= ((float)x / window->GetWidth()) * 2.0f - 1.0f;
-	GLfloat top		= ((float)y / window->GetHeight()) * 2.0f - 1.0f;
-	GLfloat right	= ((float)(x + GetWidth()) / window->GetWidth()) * 2.0f - 1.0f;
-	GLfloat bottom	= ((float)(y + GetHeight()) / window->GetHeight()) * 2.0f - 1.0f;
-	top = -top;
-	bottom = -bottom;
+	const OpacityMap& map = impl->opacity;
+	const int tile = OpacityMap::kTileSize;
+
+	for (int row = 0; row < map.GetRows(); row++) {
+		int column = 0;
+
+		while (column < map.GetColumns()) {
+			if (!IsOpaqueTile(map, column, row)) {
+				column++;
+				continue;
+			}
+
+			int start = column;
+			while (IsOpaqueTile(map, column, row))
+				column++;
+
+			/**
+			 * linear filtering pulls in the texel next door, back off by one
+			 * where the neighbouring tile is not opaque
+			 */
+			bool bOpaqueAbove = true;
+			bool bOpaqueBelow = true;
+			for (int c = start; c < column; c++) {
+				bOpaqueAbove = bOpaqueAbove && IsOpaqueTile(map, c, row - 1);
+				bOpaqueBelow = bOpaqueBelow && IsOpaqueTile(map, c, row + 1);
+			}
+
+			float x0 = start * tile + 1.0f;
+			float x1 = std::min(column * tile, impl->width) - 1.0f;
+			float y0 = row * tile + (bOpaqueAbove ? 0.0f : 1.0f);
+			float y1 = std::min((row + 1) * tile, impl->height) - (bOpaqueBelow ? 0.0f : 1.0f);
+
+			AddInnerRect(window, left + x0 * scaleX, top + y0 * scaleY, left + x1 * scaleX, top + y1 * scaleY);
+		}
+	}
+}
 
-	left *= scale;
-	top *= scale;
-	right *= scale;
-	bottom *= scale;
+/**
+ * name@Nx.ext for the largest N <= scale that exists, filename itself
+ * otherwise. bLarger tries N above scale before the smaller ones, the
+ * caller shrinks them to size.
+ */
+static std::string
+FindVariant(const std::string& filename, int scale, bool bLarger, int* pFound)
+{
+	size_t dot = filename.rfind('.');
+	size_t slash = filename.rfind('/');
 
-	GLfloat vertices[] = {
-		left,  top,
-		left,  bottom,
-		right, top,
-		right, bottom,
-	};
+	if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+		dot = filename.size();
 
-#else
+	std::vector<int> order;
+	order.push_back(scale);
+	for (int s = scale + 1; bLarger && (s <= kMaxVariantScale); s++)
+		order.push_back(s);
+	for (int s = scale - 1; s > 0; s--)
+		order.push_back(s);
 
-	GLfloat dx = (float)x / window->GetWidth();
-	GLfloat dy = (float)y / window->GetHeight();
+	for (size_t i = 0; i < order.size(); i++) {
+		int s = order[i];
 
-	GLfloat w = 2.0f * ((float)GetWidth() / window->GetWidth());
-	GLfloat h = 2.0f * ((float)GetHeight() / window->GetHeight());
+		/** scale 1 is the file itself */
+		if (s == 1)
+			break;
 
-	GLfloat vertices[] = {
-		-1.0f,		1.0f,
-		-1.0f,		1.0f - h,
-		-1.0f + w,	1.0f,
-		-1.0f + w,	1.0f - h,
-	};
-#endif
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "@%dx", s);
 
-	GLfloat texCoords[] = {
-		0.0f, 0.0f,		// left top
-		0.0f, 1.0f,		// left bottom
-		1.0f, 0.0f,		// right top
-		1.0f, 1.0f,		// right bottom
-	};
+		std::string path = filename.substr(0, dot) + suffix + filename.substr(dot);
+		if (IsFileExists(path.c_str())) {
+			*pFound = s;
+			return path;
+		}
+	}
 
-	GLfloat matrix[] = {
-		1.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, 1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f, 1.0f, 0.0f,
-		0.0f, 0.0f, 0.0f, 1.0f,
-	};
+	*pFound = 1;
+	return filename;
+}
 
-#if 0
-	matrix[3] = dx;
-	matrix[7] = dy;
-#endif
+/** Takes over a new[] buffer of tight rows, the old buffer is up to the caller */
+static void
+SetPixels(TextureImpl *impl, unsigned char *pixels, int width, int height, const std::string& path)
+{
+	impl->width = width;
+	impl->height = height;
+	impl->stride = width * 4;
+	impl->pixels = pixels;
 
-#if 0
-	matrix[0] = scale;
-	matrix[5] = scale;
-#endif
+	ResourceRegistry::Track(ResourceRegistry::kPixels, (uintptr_t)impl->pixels,
+		(size_t)impl->stride * impl->height, "Texture::Load", path.c_str());
+}
 
-	glUniformMatrix4fv(window->GetRotationUniform(), 1, GL_FALSE, matrix);
+/** False with a message when the size overflows or memory runs out, impl is left alone then */
+static bool
+AllocatePixels(TextureImpl *impl, int width, int height, const std::string& path)
+{
+	DecodedImage image;
 
-	glVertexAttribPointer(window->GetVertexAttribute(),		2, GL_FLOAT, GL_FALSE, 0, vertices);
-	glVertexAttribPointer(window->GetTexCoordAttribute(),	2, GL_FLOAT, GL_FALSE, 0, texCoords);
+	if (!ImageDecoder::AllocatePixels(&image, width, height)) {
+		fprintf(stderr, "[WLToolKit] ERR: can not load %s\n", path.c_str());
+		return false;
+	}
 
-	glEnableVertexAttribArray(window->GetVertexAttribute());
-	glEnableVertexAttribArray(window->GetTexCoordAttribute());
-	glEnableVertexAttribArray(GL_TEXTURE_2D);
+	SetPixels(impl, image.pixels, width, height, path);
 
-	glBindTexture(GL_TEXTURE_2D, m_pImpl->texture);
+	return true;
+}
+
+/** The pixels of a load that failed half way, Release() only frees loaded textures */
+static void
+FreePixels(TextureImpl *impl)
+{
+	ResourceRegistry::Untrack(ResourceRegistry::kPixels, (uintptr_t)impl->pixels);
+	delete[] impl->pixels;
+	impl->pixels = NULL;
+
+	impl->width = 0;
+	impl->height = 0;
+	impl->stride = 0;
+	impl->scale = 1;
+}
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_BLEND);
+/** Resamples impl->pixels to width x height pixels; false keeps them as they were */
+static bool
+Shrink(TextureImpl *impl, int width, int height, const std::string& path)
+{
+	unsigned char* source = impl->pixels;
+	int sourceWidth = impl->width;
+	int sourceHeight = impl->height;
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	if (!AllocatePixels(impl, width, height, path))
+		return false;
 
-	glDisable(GL_BLEND);
+	Resampler::Resize(source, sourceWidth, sourceHeight, sourceWidth * 4,
+		impl->pixels, width, height, impl->stride, Resampler::kLanczos3, true);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	ResourceRegistry::Untrack(ResourceRegistry::kPixels, (uintptr_t)source);
+	delete[] source;
 
-	glDisableVertexAttribArray(GL_TEXTURE_2D);
-	glDisableVertexAttribArray(window->GetTexCoordAttribute());
-	glDisableVertexAttribArray(window->GetVertexAttribute());
+	return true;
 }
 
 static bool
@@ -1,6 +1,12 @@
 #ifndef WL_TOOLKIT_TEXTURE_HPP
 #define WL_TOOLKIT_TEXTURE_HPP
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Opacity.hpp"
+#include "TextureFormat.hpp"
+
 namespace WLToolKit {
 
 class WindowEGL;
@@ -8,22 +14,84 @@ struct TextureImpl;
 
 class Texture {
 public:
+	/** Empty until Load() */
+	Texture();
 	Texture(const char *filename);
 	virtual ~Texture();
 
 	bool IsLoaded();
 
+	/**
+	 * PNG, or JPEG and WebP where built in, told apart by their content
+	 * (see ImageDecoder).
+	 * Prefers name@Nx.png for the current asset scale N, then smaller
+	 * variants, then the file itself. Drawing into a window of another
+	 * buffer scale loads that scale's variant, so a texture is sampled 1:1
+	 * whenever a matching asset exists.
+	 */
 	bool Load(const char *filename);
+
+	/**
+	 * Loads for display at width x height window units. A source with more
+	 * pixels than that times the asset scale is shrunk on the CPU (Lanczos,
+	 * see Resampler) before the upload, so large assets cost neither the
+	 * texture memory nor the minification aliasing of their full size;
+	 * smaller ones are stretched by the GPU. Larger @Nx variants are
+	 * preferred over smaller ones here. Results are kept in ResampleCache.
+	 */
+	bool Load(const char *filename, int width, int height);
 	void Release();
 
+	/** In window units, the pixels are GetScale() times as many unless Load() got a size */
 	int GetWidth();
 	int GetHeight();
-	int GetStride();
+	int GetScale();
 
+	int GetStride();
 	unsigned char *GetPixels();
 
-	void Draw(WindowEGL *window, int x, int y);
-	void Draw(WindowEGL *window, int x, int y, float scale);
+	/** Scale Load() looks for, WindowEGL keeps it at its buffer scale */
+	static void SetAssetScale(int scale);
+	static int GetAssetScale();
+
+	/**
+	 * GPU storage for the next Load(), the pixels kept on the CPU stay
+	 * RGBA8888. The default comes from SetDefaultFormat(), or
+	 * WLTK_TEXTURE_FORMAT (a TextureFormat name), and is kAuto.
+	 */
+	void SetFormat(TextureFormat::Format format);
+
+	/** What the loaded texture is stored as, never kAuto */
+	TextureFormat::Format GetFormat();
+
+	static void SetDefaultFormat(TextureFormat::Format format);
+	static TextureFormat::Format GetDefaultFormat();
+
+	/** Opaque textures draw without blending, Load() marks images without a translucent pixel */
+	void SetOpaque(bool opaque);
+	bool IsOpaque();
+
+	/**
+	 * What Load() found in the alpha channel. Fully transparent images are
+	 * not drawn, opaque tiles of large mixed images still end up in the
+	 * window's opaque region.
+	 */
+	OpacityMap::Opacity GetOpacity();
+	const OpacityMap& GetOpacityMap();
+
+	virtual void Draw(WindowEGL *window, int x, int y);
+	virtual void Draw(WindowEGL *window, int x, int y, float scale);
+
+	/** color is 0xAARRGGBB and multiplies the texture */
+	virtual void Draw(WindowEGL *window, int x, int y, float scale, uint32_t color);
+
+	/** Bytes of texture memory held by all GL textures, see ResourceRegistry */
+	static size_t GetTotalMemory();
+
+protected:
+	/** Keeps the display size of the last Load() */
+	bool LoadScaled(const char *filename, int scale);
+	void QueueSprite(WindowEGL *window, int x, int y, float scale, uint32_t color);
 
 protected:
 	struct TextureImpl *m_pImpl;
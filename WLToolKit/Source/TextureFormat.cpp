@@ -0,0 +1,255 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <string.h>
+}
+
+#include "TextureFormat.hpp"
+
+namespace WLToolKit {
+
+static const char* s_names[TextureFormat::kNumFormats] = {
+	"auto",
+	"rgba8888",
+	"rgb565",
+	"rgba4444",
+	"rgba5551",
+};
+
+/** largest value and bit position of r, g, b, a; alpha 0 means the format has none */
+struct Layout {
+	int max[4];
+	int shift[4];
+};
+
+static const Layout s_rgb565 = { { 31, 63, 31, 0 }, { 11, 5, 0, 0 } };
+static const Layout s_rgba4444 = { { 15, 15, 15, 15 }, { 12, 8, 4, 0 } };
+static const Layout s_rgba5551 = { { 31, 31, 31, 1 }, { 11, 6, 1, 0 } };
+
+/** 4x4 Bayer matrix */
+static const int s_bayer[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+/** alpha is rounded, halfway through a step */
+#define ALPHA_THRESHOLD		127
+
+/** floor(x / 255) for 0 <= x < 65535 */
+static inline int
+Div255(int x)
+{
+	return (x + 1 + (x >> 8)) >> 8;
+}
+
+/** 0..255 to spread the dither evenly over one quantization step */
+static inline int
+GetThreshold(int x, int y)
+{
+	return s_bayer[y & 3][x & 3] * 16 + 8;
+}
+
+static inline uint16_t
+PackPixel(const unsigned char* p, int threshold, const Layout& layout)
+{
+	int q[4];
+
+	for (int c = 0; c < 3; c++)
+		q[c] = Div255(p[c] * layout.max[c] + threshold);
+
+	q[3] = Div255(p[3] * layout.max[3] + ALPHA_THRESHOLD);
+
+	/** premultiplied: a color can not be brighter than its alpha allows */
+	if (layout.max[3]) {
+		int limit = q[3] * (layout.max[0] / layout.max[3]);
+
+		for (int c = 0; c < 3; c++) {
+			if (q[c] > limit)
+				q[c] = limit;
+		}
+	}
+
+	return (uint16_t)((q[0] << layout.shift[0]) | (q[1] << layout.shift[1]) |
+		(q[2] << layout.shift[2]) | (q[3] << layout.shift[3]));
+}
+
+static void
+ConvertRow(const unsigned char* src, uint16_t* dst, int width, int y, const Layout& layout)
+{
+	int x = 0;
+
+#if defined(__SSE2__)
+	/** x steps by 4, so each of the two halves always sees the same two columns of the matrix */
+	const int* bayer = s_bayer[y & 3];
+	int ratio = layout.max[3] ? layout.max[0] / layout.max[3] : 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i max = _mm_set_epi16(layout.max[3], layout.max[2], layout.max[1], layout.max[0],
+		layout.max[3], layout.max[2], layout.max[1], layout.max[0]);
+	const __m128i limitRatio = _mm_set_epi16(1, ratio, ratio, ratio, 1, ratio, ratio, ratio);
+	const __m128i bits = _mm_set_epi16(1 << layout.shift[3], 1 << layout.shift[2], 1 << layout.shift[1], 1 << layout.shift[0],
+		1 << layout.shift[3], 1 << layout.shift[2], 1 << layout.shift[1], 1 << layout.shift[0]);
+
+	__m128i threshold[2];
+	for (int i = 0; i < 2; i++) {
+		int t0 = bayer[i * 2] * 16 + 8;
+		int t1 = bayer[i * 2 + 1] * 16 + 8;
+
+		threshold[i] = _mm_set_epi16(ALPHA_THRESHOLD, t1, t1, t1, ALPHA_THRESHOLD, t0, t0, t0);
+	}
+
+	for (; x + 4 <= width; x += 4) {
+		__m128i px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+		__m128i half[2] = { _mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero) };
+
+		for (int i = 0; i < 2; i++) {
+			__m128i v = _mm_add_epi16(_mm_mullo_epi16(half[i], max), threshold[i]);
+			v = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, one), _mm_srli_epi16(v, 8)), 8);
+
+			if (ratio) {
+				__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xff), 0xff);
+				v = _mm_min_epi16(v, _mm_mullo_epi16(alpha, limitRatio));
+			}
+
+			/** r|g and b|a of each pixel as 32 bit sums, then the two sums added */
+			v = _mm_madd_epi16(v, bits);
+			v = _mm_add_epi32(v, _mm_srli_epi64(v, 32));
+			half[i] = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+		}
+
+		/** sign extend so the saturating pack keeps all 16 bits */
+		__m128i packed = _mm_unpacklo_epi64(half[0], half[1]);
+		packed = _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+
+		_mm_storel_epi64((__m128i*)(dst + x), _mm_packs_epi32(packed, packed));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	/** x steps by 8, twice through the row of the matrix */
+	const int* bayer = s_bayer[y & 3];
+	int ratio = layout.max[3] ? layout.max[0] / layout.max[3] : 0;
+
+	uint16_t thresholds[8];
+	for (int i = 0; i < 8; i++)
+		thresholds[i] = bayer[i & 3] * 16 + 8;
+
+	const uint16x8_t threshold = vld1q_u16(thresholds);
+	const uint16x8_t alphaThreshold = vdupq_n_u16(ALPHA_THRESHOLD);
+	const uint16x8_t one = vdupq_n_u16(1);
+
+	for (; x + 8 <= width; x += 8) {
+		uint8x8x4_t px = vld4_u8(src + x * 4);
+		uint16x8_t q[4];
+
+		for (int c = 0; c < 4; c++) {
+			uint16x8_t v = vmull_u8(px.val[c], vdup_n_u8(layout.max[c]));
+			v = vaddq_u16(v, (c == 3) ? alphaThreshold : threshold);
+			q[c] = vshrq_n_u16(vaddq_u16(vaddq_u16(v, one), vshrq_n_u16(v, 8)), 8);
+		}
+
+		uint16x8_t out = vdupq_n_u16(0);
+
+		for (int c = 0; c < 4; c++) {
+			if (ratio && (c < 3))
+				q[c] = vminq_u16(q[c], vmulq_n_u16(q[3], ratio));
+
+			out = vorrq_u16(out, vshlq_u16(q[c], vdupq_n_s16(layout.shift[c])));
+		}
+
+		vst1q_u16(dst + x, out);
+	}
+#endif
+
+	for (; x < width; x++)
+		dst[x] = PackPixel(src + x * 4, GetThreshold(x, y), layout);
+}
+
+const char*
+TextureFormat::GetName(Format format)
+{
+	return ((format >= 0) && (format < kNumFormats)) ? s_names[format] : "unknown";
+}
+
+bool
+TextureFormat::Parse(const char* name, Format* pFormat)
+{
+	for (int i = 0; i < kNumFormats; i++) {
+		if (strcmp(name, s_names[i]) == 0) {
+			*pFormat = (Format)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int
+TextureFormat::GetBytesPerPixel(Format format)
+{
+	return ((format == kRGB565) || (format == kRGBA4444) || (format == kRGBA5551)) ? 2 : 4;
+}
+
+GLenum
+TextureFormat::GetGLFormat(Format format)
+{
+	return (format == kRGB565) ? GL_RGB : GL_RGBA;
+}
+
+GLenum
+TextureFormat::GetGLType(Format format)
+{
+	switch (format) {
+	case kRGB565:
+		return GL_UNSIGNED_SHORT_5_6_5;
+	case kRGBA4444:
+		return GL_UNSIGNED_SHORT_4_4_4_4;
+	case kRGBA5551:
+		return GL_UNSIGNED_SHORT_5_5_5_1;
+	default:
+		return GL_UNSIGNED_BYTE;
+	}
+}
+
+TextureFormat::Format
+TextureFormat::Choose(const unsigned char* rgba, int width, int height, bool bOpaque)
+{
+	if (bOpaque)
+		return kRGB565;
+
+	bool bBinary = true;
+	size_t count = (size_t)width * height;
+
+	/** 0 and 255 are levels of 4444 as well, one alpha off the grid settles it */
+	for (size_t i = 0; i < count; i++) {
+		unsigned char a = rgba[i * 4 + 3];
+
+		if ((a % 17) != 0)
+			return kRGBA8888;
+
+		if ((a != 0) && (a != 255))
+			bBinary = false;
+	}
+
+	return bBinary ? kRGBA5551 : kRGBA4444;
+}
+
+void
+TextureFormat::Convert(const unsigned char* rgba, int width, int height, Format format, uint16_t* dst)
+{
+	const Layout* layout = &s_rgb565;
+	if (format == kRGBA4444)
+		layout = &s_rgba4444;
+	else if (format == kRGBA5551)
+		layout = &s_rgba5551;
+
+	for (int y = 0; y < height; y++)
+		ConvertRow(rgba + (size_t)y * width * 4, dst + (size_t)y * width, width, y, *layout);
+}
+
+} // End-of-namespace WLToolKit
@@ -0,0 +1,58 @@
+#ifndef WL_TOOLKIT_TEXTURE_FORMAT_HPP
+#define WL_TOOLKIT_TEXTURE_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+#include <GLES2/gl2.h>
+}
+
+namespace WLToolKit {
+
+/**
+ * How a Texture stores its pixels on the GPU. The 16 bit formats halve
+ * texture memory and sampling bandwidth; Convert() dithers the colors
+ * (4x4 ordered, SSE2 or NEON where available) so gradients do not band.
+ *
+ * kAuto looks at the image: RGB565 when it is opaque, RGBA5551 when alpha
+ * is only ever 0 or 255, RGBA4444 when every alpha is one of its 16
+ * levels, RGBA8888 otherwise.
+ */
+class TextureFormat {
+public:
+	enum Format {
+		kAuto,
+		kRGBA8888,
+		kRGB565,
+		kRGBA4444,
+		kRGBA5551,
+
+		kNumFormats
+	};
+
+	static const char* GetName(Format format);
+
+	/** GetName() spellings, false for anything else */
+	static bool Parse(const char* name, Format* pFormat);
+
+	static int GetBytesPerPixel(Format format);
+
+	/** glTexImage2D() format and type */
+	static GLenum GetGLFormat(Format format);
+	static GLenum GetGLType(Format format);
+
+	/** kAuto resolved for rgba, tight premultiplied RGBA rows; bOpaque skips the alpha scan */
+	static Format Choose(const unsigned char* rgba, int width, int height, bool bOpaque);
+
+	/**
+	 * Tight RGBA8888 rows into tight 16 bit rows of a 16 bit format.
+	 * Alpha is rounded, not dithered, and colors stay below it, so
+	 * premultiplied input stays premultiplied.
+	 */
+	static void Convert(const unsigned char* rgba, int width, int height, Format format, uint16_t* dst);
+}; // End-of-class TextureFormat
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_TEXTURE_FORMAT_HPP */
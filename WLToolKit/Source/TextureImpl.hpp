@@ -0,0 +1,53 @@
+#ifndef WL_TOOLKIT_TEXTURE_IMPL_HPP
+#define WL_TOOLKIT_TEXTURE_IMPL_HPP
+
+#include <string>
+
+#include "Common.hpp"
+#include "Opacity.hpp"
+#include "TextureFormat.hpp"
+
+namespace WLToolKit {
+
+/** Shared by Texture and its subclasses, not part of the public API */
+struct TextureImpl {
+	TextureImpl()
+	: width(0), height(0), stride(0), scale(1), requestedScale(1), targetWidth(0), targetHeight(0), pixels(NULL),
+	  bLoaded(false), bOpaque(false), bOpaqueSet(false), texture(0),
+	  format(TextureFormat::kAuto), bFormatSet(false), storedFormat(TextureFormat::kRGBA8888) {}
+
+	/** in pixels, scale pixels per window unit */
+	int width;
+	int height;
+	int stride;
+	int scale;
+
+	/** what Load() was asked for, the file picked for requestedScale */
+	std::string filename;
+	std::string path;
+	int requestedScale;
+
+	/** display size in window units asked for by Load(), 0 for the natural size */
+	int targetWidth;
+	int targetHeight;
+
+	unsigned char *pixels;
+
+	bool bLoaded;
+	bool bOpaque;
+	bool bOpaqueSet;		/** SetOpaque() wins over what Load() finds */
+
+	/** classified by Load(), mixed for anything else */
+	OpacityMap opacity;
+
+	GLuint texture;
+
+	/** SetFormat(), or the default while not set; what the texture ended up as */
+	TextureFormat::Format format;
+	bool bFormatSet;
+	TextureFormat::Format storedFormat;
+};
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_TEXTURE_IMPL_HPP */
@@ -0,0 +1,706 @@
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+#include "WindowEGL.hpp"
+#include "Renderer.hpp"
+#include "Texture.hpp"
+#include "TiledTexture.hpp"
+#include "Opacity.hpp"
+#include "ImageDecoder.hpp"
+#include "Capabilities.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace WLToolKit {
+
+#define DEFAULT_TILE_SIZE		256
+
+/** texels of the neighbouring tiles around each slot, linear filtering reads them at the tile edges */
+#define GUTTER					1
+
+/** rows of visible tiles are uploaded as long as the atlas has room, rows of only margin this many per Draw() */
+#define MAX_PREFETCH_ROWS_PER_FRAME	1
+
+/** without a probed context, the GLES2 minimum */
+#define FALLBACK_MAX_TEXTURE_SIZE	2048
+
+struct TiledTextureImpl {
+	TiledTextureImpl()
+	: bLoaded(false), reader(NULL), pixels(NULL), width(0), height(0), bOpaque(false),
+	  tileSize(DEFAULT_TILE_SIZE), nextTileSize(DEFAULT_TILE_SIZE), margin(-1), maxAtlasSize(0),
+	  format(TextureFormat::kAuto), bFormatSet(false), storedFormat(TextureFormat::kRGBA8888),
+	  columns(0), rows(0), atlasWidth(0), slotColumns(0), slotsPerPage(0), frame(0),
+	  bandX(0), bandY(0), bandWidth(0), bandHeight(0) {}
+
+	std::string path;
+	bool bLoaded;
+
+	/** decodes bands of tiles from the file; NULL when it can not, the image is in pixels then */
+	ImageRegionReader *reader;
+
+	/** RGBA, premultiplied, tight rows */
+	unsigned char *pixels;
+	int width;
+	int height;
+	bool bOpaque;
+
+	int tileSize;
+	int nextTileSize;		/** SetTileSize(), taken by Load() */
+	int margin;				/** -1 for one tile */
+	int maxAtlasSize;		/** 0 for GL_MAX_TEXTURE_SIZE */
+
+	TextureFormat::Format format;
+	bool bFormatSet;
+	TextureFormat::Format storedFormat;
+
+	/** tiles of the image, and the slot each is in, -1 when not resident */
+	int columns;
+	int rows;
+	std::vector<int> tileSlot;
+
+	/** atlas textures of equal width, full but for the last; slot n is in page n / slotsPerPage */
+	std::vector<GLuint> pages;
+	std::vector<int> pageHeights;
+	int atlasWidth;
+	int slotColumns;
+	int slotsPerPage;
+
+	/** tile in each slot, -1 when free, and the Draw() that last used it */
+	std::vector<int> slotTile;
+	std::vector<unsigned int> slotFrame;
+	unsigned int frame;
+
+	/** the rows of the tiles being uploaded, read without resident pixels, and where they are */
+	std::vector<unsigned char> band;
+	std::vector<unsigned char> nextBand;
+	int bandX;
+	int bandY;
+	int bandWidth;
+	int bandHeight;
+
+	/** rows Draw() uploads tiles of */
+	std::vector<int> pendingRows;
+
+	std::vector<unsigned char> staging;
+	std::vector<uint16_t> converted;
+};
+
+/** Decoded pixels holding the tiles being uploaded, x, y is their place in the image */
+struct TileSource {
+	const unsigned char *pixels;
+	size_t stride;
+	int x;
+	int y;
+};
+
+static inline int
+FloorDiv(int a, int b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int
+GetSlotSize(TiledTextureImpl *impl)
+{
+	return impl->tileSize + GUTTER * 2;
+}
+
+static void
+DestroyAtlas(TiledTextureImpl *impl)
+{
+	for (size_t page = 0; page < impl->pages.size(); page++) {
+		ResourceRegistry::Untrack(ResourceRegistry::kTexture, impl->pages[page]);
+		glDeleteTextures(1, &impl->pages[page]);
+	}
+
+	impl->pages.clear();
+	impl->pageHeights.clear();
+	impl->atlasWidth = 0;
+	impl->slotColumns = 0;
+	impl->slotsPerPage = 0;
+	impl->slotTile.clear();
+	impl->slotFrame.clear();
+	impl->tileSlot.assign(impl->columns * impl->rows, -1);
+}
+
+/**
+ * Room for at least slots tiles. Pages are as large as the texture size
+ * limit allows, and there are as many of them as it takes.
+ */
+static bool
+CreateAtlas(TiledTextureImpl *impl, int slots)
+{
+	DestroyAtlas(impl);
+
+	const Capabilities *caps = Capabilities::GetCurrent();
+	int maxSize = (caps && caps->GetMaxTextureSize()) ? caps->GetMaxTextureSize() : FALLBACK_MAX_TEXTURE_SIZE;
+	if (impl->maxAtlasSize > 0)
+		maxSize = std::min(maxSize, impl->maxAtlasSize);
+
+	int slotSize = GetSlotSize(impl);
+	int maxColumns = maxSize / slotSize;
+	if (maxColumns < 1) {
+		fprintf(stderr, "[WLToolKit] ERR: %d pixel tiles do not fit atlas pages of %d\n", impl->tileSize, maxSize);
+		return false;
+	}
+
+	int columns = std::min(maxColumns, (int)ceil(sqrt((double)slots)));
+
+	impl->slotColumns = columns;
+	impl->slotsPerPage = columns * maxColumns;
+	impl->atlasWidth = columns * slotSize;
+
+	int numPages = (slots + impl->slotsPerPage - 1) / impl->slotsPerPage;
+	if (numPages > 1) {
+		fprintf(stderr, "[WLToolKit] WARN: %s: %d tile slots take %d atlas pages of %d, one draw call each\n",
+			impl->path.c_str(), slots, numPages, maxSize);
+	}
+
+	GLenum format = TextureFormat::GetGLFormat(impl->storedFormat);
+	int total = 0;
+
+	for (int page = 0; page < numPages; page++) {
+		int pageSlots = std::min(impl->slotsPerPage, slots - page * impl->slotsPerPage);
+		int rows = (pageSlots + columns - 1) / columns;
+		GLuint texture;
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, format, impl->atlasWidth, rows * slotSize, 0,
+			format, TextureFormat::GetGLType(impl->storedFormat), NULL);
+
+		ResourceRegistry::Track(ResourceRegistry::kTexture, texture,
+			(size_t)impl->atlasWidth * rows * slotSize * TextureFormat::GetBytesPerPixel(impl->storedFormat),
+			"TiledTexture", impl->path.c_str());
+
+		impl->pages.push_back(texture);
+		impl->pageHeights.push_back(rows * slotSize);
+
+		/** the last page may have a few slots more than asked for, they are used as well */
+		total = page * impl->slotsPerPage + rows * columns;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	impl->slotTile.assign(total, -1);
+	impl->slotFrame.assign(total, 0);
+
+	return true;
+}
+
+/** Page of the slot and where in it the slot's gutter starts */
+static void
+GetSlotOrigin(TiledTextureImpl *impl, int slot, int *page, int *x, int *y)
+{
+	int slotSize = GetSlotSize(impl);
+	int index = slot % impl->slotsPerPage;
+
+	*page = slot / impl->slotsPerPage;
+	*x = (index % impl->slotColumns) * slotSize;
+	*y = (index / impl->slotColumns) * slotSize;
+}
+
+/**
+ * The pixels the tiles column0 to column1 of row need, gutters included:
+ * the resident image, or those rows and columns read into impl->band.
+ */
+static bool
+GetTileSource(TiledTextureImpl *impl, int row, int column0, int column1, TileSource *source)
+{
+	if (impl->pixels) {
+		source->pixels = impl->pixels;
+		source->stride = (size_t)impl->width * 4;
+		source->x = 0;
+		source->y = 0;
+		return true;
+	}
+
+	int left = std::max(column0 * impl->tileSize - GUTTER, 0);
+	int top = std::max(row * impl->tileSize - GUTTER, 0);
+	int right = std::min((column1 + 1) * impl->tileSize + GUTTER, impl->width);
+	int bottom = std::min((row + 1) * impl->tileSize + GUTTER, impl->height);
+	size_t stride = (size_t)(right - left) * 4;
+
+	/** the band of the row above ends in the gutter rows of this one, the reader has passed them */
+	int kept = 0;
+	if ((left >= impl->bandX) && (right <= impl->bandX + impl->bandWidth) &&
+		(top >= impl->bandY) && (top < impl->bandY + impl->bandHeight) && (impl->bandY + impl->bandHeight < bottom))
+		kept = impl->bandY + impl->bandHeight - top;
+
+	impl->nextBand.resize(stride * (bottom - top));
+
+	for (int y = 0; y < kept; y++) {
+		memcpy(&impl->nextBand[y * stride],
+			&impl->band[((size_t)(top + y - impl->bandY) * impl->bandWidth + (left - impl->bandX)) * 4], stride);
+	}
+
+	if (!impl->reader->Read(left, top + kept, right - left, bottom - top - kept, &impl->nextBand[kept * stride], stride)) {
+		fprintf(stderr, "[WLToolKit] ERR: %s: decoding tiles %d-%d of row %d failed\n", impl->path.c_str(), column0, column1, row);
+		impl->bandHeight = 0;
+		return false;
+	}
+
+	impl->band.swap(impl->nextBand);
+	impl->bandX = left;
+	impl->bandY = top;
+	impl->bandWidth = right - left;
+	impl->bandHeight = bottom - top;
+
+	source->pixels = &impl->band[0];
+	source->stride = stride;
+	source->x = left;
+	source->y = top;
+
+	return true;
+}
+
+/** Copies the tile and its gutter, clamped at the image edges, from source into its slot */
+static void
+UploadTile(TiledTextureImpl *impl, int tile, int slot, const TileSource& source)
+{
+	int tileX = (tile % impl->columns) * impl->tileSize;
+	int tileY = (tile / impl->columns) * impl->tileSize;
+	int width = std::min(impl->tileSize, impl->width - tileX) + GUTTER * 2;
+	int height = std::min(impl->tileSize, impl->height - tileY) + GUTTER * 2;
+
+	impl->staging.resize((size_t)width * height * 4);
+
+	for (int y = 0; y < height; y++) {
+		int srcY = std::min(std::max(tileY + y - GUTTER, 0), impl->height - 1);
+		const unsigned char *src = source.pixels + (size_t)(srcY - source.y) * source.stride - (size_t)source.x * 4;
+		unsigned char *dst = &impl->staging[(size_t)y * width * 4];
+
+		/** the inner run in one go, the gutter columns one by one */
+		int first = std::max(tileX - GUTTER, 0);
+		int last = std::min(tileX + width - GUTTER, impl->width);
+		int offset = first - (tileX - GUTTER);
+
+		memcpy(dst + offset * 4, src + first * 4, (last - first) * 4);
+
+		for (int x = 0; x < offset; x++)
+			memcpy(dst + x * 4, src + first * 4, 4);
+		for (int x = offset + last - first; x < width; x++)
+			memcpy(dst + x * 4, src + (last - 1) * 4, 4);
+	}
+
+	int page, slotX, slotY;
+	GetSlotOrigin(impl, slot, &page, &slotX, &slotY);
+
+	GLenum format = TextureFormat::GetGLFormat(impl->storedFormat);
+
+	glBindTexture(GL_TEXTURE_2D, impl->pages[page]);
+
+	if (impl->storedFormat == TextureFormat::kRGBA8888) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, slotX, slotY, width, height, format, GL_UNSIGNED_BYTE, &impl->staging[0]);
+	} else {
+		impl->converted.resize((size_t)width * height);
+		TextureFormat::Convert(&impl->staging[0], width, height, impl->storedFormat, &impl->converted[0]);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, slotX, slotY, width, height,
+			format, TextureFormat::GetGLType(impl->storedFormat), &impl->converted[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/** A free slot, or the least recently drawn one not used by this Draw(); -1 if there is none */
+static int
+AcquireSlot(TiledTextureImpl *impl)
+{
+	int victim = -1;
+
+	for (size_t i = 0; i < impl->slotTile.size(); i++) {
+		if (impl->slotTile[i] < 0)
+			return (int)i;
+
+		if (impl->slotFrame[i] == impl->frame)
+			continue;
+
+		if ((victim < 0) || (impl->slotFrame[i] < impl->slotFrame[victim]))
+			victim = (int)i;
+	}
+
+	if (victim >= 0) {
+		impl->tileSlot[impl->slotTile[victim]] = -1;
+		impl->slotTile[victim] = -1;
+	}
+
+	return victim;
+}
+
+/** The first and last of the tiles column0 to column1 of row that are not resident, false for none */
+static bool
+FindMissing(TiledTextureImpl *impl, int row, int column0, int column1, int *first, int *last)
+{
+	*first = -1;
+
+	for (int column = column0; column <= column1; column++) {
+		if (impl->tileSlot[row * impl->columns + column] < 0) {
+			if (*first < 0)
+				*first = column;
+			*last = column;
+		}
+	}
+
+	return (*first >= 0);
+}
+
+/**
+ * Uploads the tiles column0 to column1 of row that are not resident yet
+ * from one band over all of those columns. False when any is left out,
+ * because decoding failed or the atlas is full of tiles of this Draw().
+ */
+static bool
+MakeResident(TiledTextureImpl *impl, int row, int column0, int column1)
+{
+	int first, last;
+	if (!FindMissing(impl, row, column0, column1, &first, &last))
+		return true;
+
+	TileSource source;
+	if (!GetTileSource(impl, row, column0, column1, &source))
+		return false;
+
+	for (int column = first; column <= last; column++) {
+		int tile = row * impl->columns + column;
+		if (impl->tileSlot[tile] >= 0)
+			continue;
+
+		int slot = AcquireSlot(impl);
+		if (slot < 0)
+			return false;
+
+		UploadTile(impl, tile, slot, source);
+
+		impl->tileSlot[tile] = slot;
+		impl->slotTile[slot] = tile;
+		impl->slotFrame[slot] = impl->frame;
+	}
+
+	return true;
+}
+
+TiledTexture::TiledTexture()
+{
+	m_pImpl = new TiledTextureImpl;
+}
+
+TiledTexture::~TiledTexture()
+{
+	Release();
+
+	delete m_pImpl;
+}
+
+bool
+TiledTexture::Load(const char *filename)
+{
+	Release();
+
+	ImageDecoder *decoder = ImageDecoder::Find(filename);
+	if (!decoder) {
+		fprintf(stderr, "[WLToolKit] ERR: no decoder for %s\n", filename);
+		return false;
+	}
+
+	m_pImpl->path = filename;
+	m_pImpl->reader = decoder->OpenRegions(filename, &m_pImpl->width, &m_pImpl->height, &m_pImpl->bOpaque);
+
+	if (!m_pImpl->reader) {
+		/** the fallback for decoders that can only decode everything (PNG): the image stays in memory */
+		DecodedImage image;
+		if (!ImageDecoder::Load(filename, 0, 0, &image))
+			return false;
+
+		m_pImpl->pixels = image.pixels;
+		m_pImpl->width = image.width;
+		m_pImpl->height = image.height;
+
+		ResourceRegistry::Track(ResourceRegistry::kPixels, (uintptr_t)m_pImpl->pixels,
+			(size_t)m_pImpl->width * m_pImpl->height * 4, "TiledTexture", filename);
+
+		if (image.bOpaque) {
+			m_pImpl->bOpaque = true;
+		} else {
+			OpacityMap map;
+			m_pImpl->bOpaque = (map.Classify(m_pImpl->pixels, m_pImpl->width, m_pImpl->height, m_pImpl->width * 4, false) == OpacityMap::kOpaque);
+		}
+	}
+
+	/** without the pixels at hand only the file's alpha channel tells */
+	TextureFormat::Format format = m_pImpl->bFormatSet ? m_pImpl->format : Texture::GetDefaultFormat();
+	if (format == TextureFormat::kAuto) {
+		if (m_pImpl->pixels)
+			format = TextureFormat::Choose(m_pImpl->pixels, m_pImpl->width, m_pImpl->height, m_pImpl->bOpaque);
+		else
+			format = m_pImpl->bOpaque ? TextureFormat::kRGB565 : TextureFormat::kRGBA8888;
+	}
+
+	m_pImpl->storedFormat = format;
+
+	m_pImpl->tileSize = m_pImpl->nextTileSize;
+	m_pImpl->columns = (m_pImpl->width + m_pImpl->tileSize - 1) / m_pImpl->tileSize;
+	m_pImpl->rows = (m_pImpl->height + m_pImpl->tileSize - 1) / m_pImpl->tileSize;
+	m_pImpl->tileSlot.assign(m_pImpl->columns * m_pImpl->rows, -1);
+
+	m_pImpl->bLoaded = true;
+
+	return true;
+}
+
+void
+TiledTexture::Release()
+{
+	if (!m_pImpl->bLoaded)
+		return;
+
+	DestroyAtlas(m_pImpl);
+
+	if (m_pImpl->pixels) {
+		ResourceRegistry::Untrack(ResourceRegistry::kPixels, (uintptr_t)m_pImpl->pixels);
+		delete[] m_pImpl->pixels;
+		m_pImpl->pixels = NULL;
+	}
+
+	delete m_pImpl->reader;
+	m_pImpl->reader = NULL;
+	m_pImpl->bLoaded = false;
+
+	/** a band is a screen width of tiles, another image may never need one */
+	std::vector<unsigned char>().swap(m_pImpl->band);
+	std::vector<unsigned char>().swap(m_pImpl->nextBand);
+	m_pImpl->bandHeight = 0;
+
+	m_pImpl->width = 0;
+	m_pImpl->height = 0;
+	m_pImpl->columns = 0;
+	m_pImpl->rows = 0;
+	m_pImpl->tileSlot.clear();
+}
+
+bool
+TiledTexture::IsLoaded()
+{
+	return m_pImpl->bLoaded;
+}
+
+int
+TiledTexture::GetWidth()
+{
+	return m_pImpl->width;
+}
+
+int
+TiledTexture::GetHeight()
+{
+	return m_pImpl->height;
+}
+
+void
+TiledTexture::SetTileSize(int size)
+{
+	m_pImpl->nextTileSize = (size >= 16) ? size : 16;
+}
+
+void
+TiledTexture::SetPrefetchMargin(int pixels)
+{
+	m_pImpl->margin = (pixels >= 0) ? pixels : 0;
+}
+
+void
+TiledTexture::SetMaxAtlasSize(int pixels)
+{
+	m_pImpl->maxAtlasSize = (pixels > 0) ? pixels : 0;
+
+	/** rebuilt by the next Draw() */
+	DestroyAtlas(m_pImpl);
+}
+
+void
+TiledTexture::SetFormat(TextureFormat::Format format)
+{
+	m_pImpl->format = format;
+	m_pImpl->bFormatSet = true;
+}
+
+void
+TiledTexture::Draw(WindowEGL *window, int x, int y)
+{
+	if (!IsLoaded())
+		return;
+
+	TiledTextureImpl *impl = m_pImpl;
+	int tileSize = impl->tileSize;
+	int margin = (impl->margin < 0) ? tileSize : impl->margin;
+	int windowWidth = window->GetWidth();
+	int windowHeight = window->GetHeight();
+
+	impl->frame++;
+
+	/** as many slots as a window plus margin, at any offset, touches */
+	int needed = ((windowWidth + margin * 2 + tileSize - 1) / tileSize + 1) *
+		((windowHeight + margin * 2 + tileSize - 1) / tileSize + 1);
+	needed = std::min(needed, impl->columns * impl->rows);
+
+	if ((int)impl->slotTile.size() < needed) {
+		if (!CreateAtlas(impl, needed))
+			return;
+	}
+
+	/** visible tiles, and with the margin */
+	int c0 = std::max(FloorDiv(-x, tileSize), 0);
+	int r0 = std::max(FloorDiv(-y, tileSize), 0);
+	int c1 = std::min(FloorDiv(windowWidth - x - 1, tileSize), impl->columns - 1);
+	int r1 = std::min(FloorDiv(windowHeight - y - 1, tileSize), impl->rows - 1);
+
+	if ((c0 > c1) || (r0 > r1))
+		return;
+
+	int pc0 = std::max(FloorDiv(-x - margin, tileSize), 0);
+	int pr0 = std::max(FloorDiv(-y - margin, tileSize), 0);
+	int pc1 = std::min(FloorDiv(windowWidth + margin - x - 1, tileSize), impl->columns - 1);
+	int pr1 = std::min(FloorDiv(windowHeight + margin - y - 1, tileSize), impl->rows - 1);
+
+	/** all resident ones are taken first, uploading one row must not evict a tile of another */
+	for (int row = pr0; row <= pr1; row++) {
+		for (int column = pc0; column <= pc1; column++) {
+			int slot = impl->tileSlot[row * impl->columns + column];
+			if (slot >= 0)
+				impl->slotFrame[slot] = impl->frame;
+		}
+	}
+
+	/**
+	 * Then the rows missing tiles, top to bottom and each over the same
+	 * columns: a reader decoding the file carries on from one band to the
+	 * next instead of starting over.
+	 */
+	int mc0 = pc1 + 1;
+	int mc1 = pc0 - 1;
+	int prefetched = 0;
+
+	impl->pendingRows.clear();
+
+	for (int row = pr0; row <= pr1; row++) {
+		int first, last;
+		if (!FindMissing(impl, row, pc0, pc1, &first, &last))
+			continue;
+
+		int visibleFirst, visibleLast;
+		bool bVisible = (row >= r0) && (row <= r1) && FindMissing(impl, row, c0, c1, &visibleFirst, &visibleLast);
+
+		if (!bVisible) {
+			if (prefetched == MAX_PREFETCH_ROWS_PER_FRAME)
+				continue;
+			prefetched++;
+		}
+
+		impl->pendingRows.push_back(row);
+		mc0 = std::min(mc0, first);
+		mc1 = std::max(mc1, last);
+	}
+
+	bool bComplete = true;
+	for (size_t i = 0; i < impl->pendingRows.size(); i++) {
+		int row = impl->pendingRows[i];
+
+		if (!MakeResident(impl, row, mc0, mc1) && (row >= r0) && (row <= r1))
+			bComplete = false;
+	}
+
+	/** one texture and one pipeline per page: the Renderer makes each page one run */
+	Renderer *renderer = window->GetRenderer();
+	Renderer::Blend blend = impl->bOpaque ? Renderer::kBlendOpaque : Renderer::kBlendPremultiplied;
+
+	for (int page = 0; page < (int)impl->pages.size(); page++) {
+		for (int row = r0; row <= r1; row++) {
+			for (int column = c0; column <= c1; column++) {
+				int tile = row * impl->columns + column;
+				int slot = impl->tileSlot[tile];
+				if ((slot < 0) || (slot / impl->slotsPerPage != page))
+					continue;
+
+				int width = std::min(tileSize, impl->width - column * tileSize);
+				int height = std::min(tileSize, impl->height - row * tileSize);
+				float left = (float)(x + column * tileSize);
+				float top = (float)(y + row * tileSize);
+
+				const GLfloat rect[] = {
+					(left / windowWidth) * 2.0f - 1.0f,
+					-((top / windowHeight) * 2.0f - 1.0f),
+					((left + width) / windowWidth) * 2.0f - 1.0f,
+					-(((top + height) / windowHeight) * 2.0f - 1.0f),
+				};
+
+				int slotPage, slotX, slotY;
+				GetSlotOrigin(impl, slot, &slotPage, &slotX, &slotY);
+
+				float u = (float)(slotX + GUTTER);
+				float v = (float)(slotY + GUTTER);
+				float pageHeight = (float)impl->pageHeights[page];
+
+				const GLfloat uv[] = {
+					u / impl->atlasWidth,
+					v / pageHeight,
+					(u + width) / impl->atlasWidth,
+					(v + height) / pageHeight,
+				};
+
+				renderer->AddSprite(impl->pages[page], rect, uv, blend);
+			}
+		}
+	}
+
+	if (impl->bOpaque && bComplete && !renderer->IsTransformed()) {
+		int left = std::max(x, 0);
+		int top = std::max(y, 0);
+		int right = std::min(x + impl->width, windowWidth);
+		int bottom = std::min(y + impl->height, windowHeight);
+
+		window->AddOpaqueRect(left, top, right - left, bottom - top);
+	}
+}
+
+int
+TiledTexture::GetResidentTiles()
+{
+	int count = 0;
+
+	for (size_t i = 0; i < m_pImpl->slotTile.size(); i++) {
+		if (m_pImpl->slotTile[i] >= 0)
+			count++;
+	}
+
+	return count;
+}
+
+int
+TiledTexture::GetAtlasPages()
+{
+	return (int)m_pImpl->pages.size();
+}
+
+size_t
+TiledTexture::GetTextureMemory()
+{
+	size_t bytes = 0;
+
+	for (size_t page = 0; page < m_pImpl->pageHeights.size(); page++)
+		bytes += (size_t)m_pImpl->atlasWidth * m_pImpl->pageHeights[page] * TextureFormat::GetBytesPerPixel(m_pImpl->storedFormat);
+
+	return bytes;
+}
+
+} // End-of-namespace WLToolKit
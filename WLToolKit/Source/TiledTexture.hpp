@@ -0,0 +1,79 @@
+#ifndef WL_TOOLKIT_TILED_TEXTURE_HPP
+#define WL_TOOLKIT_TILED_TEXTURE_HPP
+
+#include <stddef.h>
+
+#include "TextureFormat.hpp"
+
+namespace WLToolKit {
+
+class WindowEGL;
+struct TiledTextureImpl;
+
+/**
+ * An image of any size, panoramas and wallpapers larger than
+ * GL_MAX_TEXTURE_SIZE included, shown one window-sized piece at a time.
+ *
+ * The image is cut into square tiles. Draw() uploads the tiles the window
+ * shows, and a few per frame of the prefetch margin around them, into
+ * slots of an atlas texture, so all visible tiles go out as a single
+ * sprite run (one draw call). The atlas holds as many slots as a window
+ * plus the margin can touch; when it is full the least recently drawn
+ * tile gives up its slot. GPU memory therefore follows the window size,
+ * not the image size. Where GL_MAX_TEXTURE_SIZE is too small for all
+ * those slots the atlas takes several pages, one run each, and every
+ * visible tile is still drawn.
+ *
+ * JPEG and WebP tiles are decoded from the file when they are uploaded,
+ * a band of a tile row at a time, so CPU memory follows the window size
+ * as well. A JPEG decoder stays open while scrolling down; scrolling up
+ * or sideways starts it over and passes the rows above the window again,
+ * once per tile row or column. Files whose decoder can only decode all
+ * of them (PNG, progressive JPEG) fall back to keeping the decoded image
+ * in memory.
+ *
+ * Image pixels are window units. The atlas belongs to the context of the
+ * window drawn into first.
+ */
+class TiledTexture {
+public:
+	TiledTexture();
+	virtual ~TiledTexture();
+
+	/** Reads the file (see ImageDecoder), nothing is uploaded before Draw() */
+	bool Load(const char *filename);
+	void Release();
+
+	bool IsLoaded();
+
+	int GetWidth();
+	int GetHeight();
+
+	/** Square tiles, 256 by default; applies from the next Load() */
+	void SetTileSize(int size);
+
+	/** Pixels around the window uploaded ahead of scrolling, one tile by default */
+	void SetPrefetchMargin(int pixels);
+
+	/** Largest side of an atlas page, 0 for GL_MAX_TEXTURE_SIZE; the atlas is rebuilt by the next Draw() */
+	void SetMaxAtlasSize(int pixels);
+
+	/** Storage of the atlas, the default is Texture::GetDefaultFormat(); applies from the next Load() */
+	void SetFormat(TextureFormat::Format format);
+
+	/** x, y is where the image's top-left corner is in the window, usually negative */
+	void Draw(WindowEGL *window, int x, int y);
+
+	int GetResidentTiles();
+	int GetAtlasPages();
+
+	/** Bytes of the atlas textures */
+	size_t GetTextureMemory();
+
+protected:
+	struct TiledTextureImpl *m_pImpl;
+}; // End-of-class TiledTexture
+
+} // End-of-namespace WLToolKit
+
+#endif /* WL_TOOLKIT_TILED_TEXTURE_HPP */
@@ -1,9 +1,25 @@
 #ifndef WL_TOOLKIT_HPP
 #define WL_TOOLKIT_HPP
 
+#include "Capabilities.hpp"
 #include "Display.hpp"
 #include "Window.hpp"
 #include "WindowEGL.hpp"
+#include "RenderTarget.hpp"
+#include "Opacity.hpp"
+#include "ImageDecoder.hpp"
+#include "Resampler.hpp"
+#include "TextureFormat.hpp"
 #include "Texture.hpp"
+#include "TiledTexture.hpp"
+#include "DynamicTexture.hpp"
+#include "FrameArena.hpp"
+#include "IdleScheduler.hpp"
+#include "Font.hpp"
+#include "GridView.hpp"
+#include "GLTrace.hpp"
+#include "StartupTrace.hpp"
+#include "LatencyTracker.hpp"
+#include "ResourceRegistry.hpp"
 
 #endif /* WL_TOOLKIT_HPP */
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Common.hpp"
 #include "Display.hpp"
 #include "Window.hpp"
@@ -6,38 +8,102 @@ namespace WLToolKit {
 
 static void _ButtonHandler(struct widget *widget, struct input *input, uint32_t time, uint32_t button, enum wl_pointer_button_state state, void *data);
 static void _TouchDownHandler(struct widget *widget, struct input *input, uint32_t serial, uint32_t time, int32_t id, float x, float y, void *data);
+static void _TouchMotionHandler(struct widget *widget, struct input *input, uint32_t time, int32_t id, float x, float y, void *data);
+static void _TouchUpHandler(struct widget *widget, struct input *input, uint32_t serial, uint32_t time, int32_t id, void *data);
+static int _MotionHandler(struct widget *widget, struct input *input, uint32_t time, float x, float y, void *data);
+static void _OutputHandler(struct window *window, struct output *output, int enter, void *data);
+static void _ResizeHandler(struct widget *widget, int32_t width, int32_t height, void *data);
 
 Window::Window(Display *display, int width, int height)
-: m_display(display), m_width(width), m_height(height)
+: m_display(display), m_width(width), m_height(height), m_bufferScale(1), m_bForcedScale(false)
 {
 	assert(m_display);
 
+	const char* scale = getenv("WLTK_BUFFER_SCALE");
+	if (scale && (atoi(scale) > 0)) {
+		m_bufferScale = atoi(scale);
+		m_bForcedScale = true;
+	}
+
+	/** offscreen, nothing to receive input or configure events */
+	if (m_display->IsHeadless()) {
+		m_window = NULL;
+		m_widget = NULL;
+		return;
+	}
+
 	m_window = window_create(m_display->GetDisplay());
 	window_set_user_data(m_window, this);
 
 	m_widget = window_add_widget(m_window, this);
 	widget_set_button_handler(m_widget, &_ButtonHandler);
 	widget_set_touch_down_handler(m_widget, &_TouchDownHandler);
+	widget_set_touch_motion_handler(m_widget, &_TouchMotionHandler);
+	widget_set_touch_up_handler(m_widget, &_TouchUpHandler);
+	widget_set_motion_handler(m_widget, &_MotionHandler);
+	widget_set_resize_handler(m_widget, &_ResizeHandler);
+
+	window_set_output_handler(m_window, &_OutputHandler);
 }
 
 Window::~Window()
 {
-	window_destroy(m_window);
+	if (m_window)
+		window_destroy(m_window);
 }
 
 void
 Window::Resize(int width, int height)
 {
+	if (m_window)
+		window_schedule_resize(m_window, width, height);
+
+	OnConfigure(width, height);
+}
+
+void
+Window::OnConfigure(int width, int height)
+{
+	if ((width == m_width) && (height == m_height))
+		return;
+
 	m_width = width;
 	m_height = height;
 
-	window_schedule_resize(m_window, m_width, m_height);
+	OnResize(width, height);
 }
 
 struct wl_surface*
 Window::GetWlSurface()
 {
-	return window_get_wl_surface(m_window);
+	return m_window ? window_get_wl_surface(m_window) : NULL;
+}
+
+void
+Window::OnOutput(struct output* output, bool bEnter)
+{
+	std::vector<struct output*>::iterator it = std::find(m_outputs.begin(), m_outputs.end(), output);
+
+	if (bEnter && (it == m_outputs.end()))
+		m_outputs.push_back(output);
+	else if (!bEnter && (it != m_outputs.end()))
+		m_outputs.erase(it);
+
+	if (m_bForcedScale)
+		return;
+
+	/** straddling a 1x and a 2x output, rendering for the sharper one looks right on both */
+	int scale = 1;
+	for (it = m_outputs.begin(); it != m_outputs.end(); ++it)
+		scale = std::max(scale, output_get_scale(*it));
+
+	/** leaving every output keeps the last scale, the surface is not shown anyway */
+	if (m_outputs.empty() || (scale == m_bufferScale))
+		return;
+
+	m_bufferScale = scale;
+
+	OnBufferScale(scale);
 }
 
 static void
@@ -46,11 +112,18 @@ _ButtonHandler(struct widget *widget, struct input *input, uint32_t time, uint32
 	if (data) {
 		Window* self = (Window*)data;
 
+		self->OnInputEvent(Window::kInputPointerButton, time);
+
 		if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
 			int x, y;
 			input_get_position(input, &x, &y);
 
 			self->OnClick(button, x, y);
+		} else {
+			int x, y;
+			input_get_position(input, &x, &y);
+
+			self->OnRelease(button, x, y);
 		}
 	}
 }
@@ -61,9 +134,66 @@ _TouchDownHandler(struct widget *widget, struct input *input, uint32_t serial, u
 	if (data) {
 		Window* self = (Window*)data;
 
+		self->OnInputEvent(Window::kInputTouchDown, time);
 		self->OnTouchDown((int)x, (int)y);
 	}
 }
 
+static void
+_TouchMotionHandler(struct widget *widget, struct input *input, uint32_t time, int32_t id, float x, float y, void *data)
+{
+	if (data) {
+		Window* self = (Window*)data;
+
+		self->OnInputEvent(Window::kInputTouchMotion, time);
+		self->OnTouchMotion((int)x, (int)y);
+	}
+}
+
+static void
+_TouchUpHandler(struct widget *widget, struct input *input, uint32_t serial, uint32_t time, int32_t id, void *data)
+{
+	if (data) {
+		Window* self = (Window*)data;
+
+		self->OnInputEvent(Window::kInputTouchUp, time);
+		self->OnTouchUp();
+	}
+}
+
+static void
+_OutputHandler(struct window *window, struct output *output, int enter, void *data)
+{
+	if (data) {
+		Window* self = (Window*)data;
+
+		self->OnOutput(output, enter != 0);
+	}
+}
+
+static void
+_ResizeHandler(struct widget *widget, int32_t width, int32_t height, void *data)
+{
+	/** 0x0 leaves the size to us */
+	if (data && (width > 0) && (height > 0)) {
+		Window* self = (Window*)data;
+
+		self->OnConfigure(width, height);
+	}
+}
+
+static int
+_MotionHandler(struct widget *widget, struct input *input, uint32_t time, float x, float y, void *data)
+{
+	if (data) {
+		Window* self = (Window*)data;
+
+		self->OnInputEvent(Window::kInputPointerMotion, time);
+		self->OnPointerMotion((int)x, (int)y);
+	}
+
+	return CURSOR_LEFT_PTR;
+}
+
 } // End-of-namespace WLToolKit
 
@@ -3,9 +3,12 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 struct wl_surface;
 struct window;
 struct widget;
+struct output;
 
 namespace WLToolKit {
 
@@ -13,12 +16,23 @@ class Display;
 
 class Window {
 public:
+	enum InputType {
+		kInputPointerButton,
+		kInputPointerMotion,
+		kInputTouchDown,
+		kInputTouchMotion,
+		kInputTouchUp,
+		kNumInputTypes
+	};
+
 	Window(Display* display, int width, int height);
 	virtual ~Window();
 
+	/** Asks toytoolkit for the size and configures the window with it, see OnConfigure() */
 	void Resize(int width, int height);
 
 	Display* GetDisplay() { return m_display; }
+	/** NULL on a headless Display */
 	struct window* GetWindow() { return m_window; }
 	struct widget* GetWidget() { return m_widget; }
 	struct wl_surface* GetWlSurface();
@@ -26,8 +40,37 @@ public:
 	int GetWidth() { return m_width; }
 	int GetHeight() { return m_height; }
 
+	/**
+	 * Largest wl_output scale among the outputs the surface is on, 1 until
+	 * it entered one. WLTK_BUFFER_SCALE=N pins it for the whole run.
+	 */
+	int GetBufferScale() { return m_bufferScale; }
+
+	/** The buffer scale changed, the next buffer should have scale times the pixels */
+	virtual void OnBufferScale(int scale) {}
+
+	/** Used by the toytoolkit output handler */
+	void OnOutput(struct output* output, bool bEnter);
+
+	/**
+	 * A size from a configure event or Resize(). The base class takes it
+	 * right away and calls OnResize(), WindowEGL defers both to its next
+	 * frame.
+	 */
+	virtual void OnConfigure(int width, int height);
+
+	/** The size changed, GetWidth()/GetHeight() already return the new one */
+	virtual void OnResize(int width, int height) {}
+
+	/** Every input event, before the specific handler; time is the wl_input timestamp in ms */
+	virtual void OnInputEvent(InputType type, uint32_t time) {}
+
 	virtual void OnClick(uint32_t button, int x, int y) {}
+	virtual void OnRelease(uint32_t button, int x, int y) {}
+	virtual void OnPointerMotion(int x, int y) {}
 	virtual void OnTouchDown(int x, int y) {}
+	virtual void OnTouchMotion(int x, int y) {}
+	virtual void OnTouchUp() {}
 
 protected:
 	Display* m_display;
@@ -35,6 +78,10 @@ protected:
 	struct widget* m_widget;
 
 	int m_width, m_height;
+
+	int m_bufferScale;
+	bool m_bForcedScale;
+	std::vector<struct output*> m_outputs;
 }; // End-of-class Window
 
 } // End-of-namespace WLToolKit
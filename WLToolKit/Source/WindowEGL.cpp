@@ -1,33 +1,79 @@
+#include <algorithm>
+
 #include "Common.hpp"
 #include "Display.hpp"
 #include "WindowEGL.hpp"
+#include "GLTrace.hpp"
+#include "Clock.hpp"
+#include "StartupTrace.hpp"
+#include "Renderer.hpp"
+#include "FrameArena.hpp"
+#include "FrameScheduler.hpp"
+#include "IdleScheduler.hpp"
+#include "LatencyTracker.hpp"
+#include "PerfHUD.hpp"
+#include "Texture.hpp"
+#include "RenderTarget.hpp"
+#include "ResourceRegistry.hpp"
 
 namespace WLToolKit {
 
+/** more than this and only the largest rects are kept, the region is a hint */
+#define MAX_OPAQUE_RECTS	32
+
+/** idle time of an offscreen frame, there is no refresh to follow */
+#define OFFSCREEN_FRAME_NS	16666667ULL
+
 class WindowEGLImpl {
 public:
-	WindowEGLImpl(WindowEGL* window);
+	struct Rect {
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	WindowEGLImpl(WindowEGL* window, bool bOpaque);
 	virtual ~WindowEGLImpl();
 
 	void OnRedraw(struct wl_callback* callback, uint32_t time);
+	void DrawFrame();
+
+	void AddOpaqueRect(int x, int y, int width, int height);
+	void UpdateOpaqueRegion();
 
 	static void _RedrawHandler(void* data, struct wl_callback* callback, uint32_t time);
 	static void _ConfigureHandler(void* data, struct wl_callback* callback, uint32_t time);
+	static void _RenderHandler(void* data);
+	static void _PresentHandler(void* data, unsigned int frame, uint64_t presentNs);
 
 protected:
 	bool InitEGL();
 	void DeinitEGL();
+	bool ChooseConfig(const EGLint* attr);
+	bool ChooseConfigWith(const EGLint* attr);
 
 	bool InitGL();
 
 	bool CreateSurface();
+	bool CreateOffscreenSurface();
 	void DestroySurface();
 
-	GLuint CreateShader(const char* source, GLenum type);
+	void ResizeSurface();
 
 public:
 	struct wl_egl_window* m_native;
-	EGLSurface m_eglSurface;
+	EGLSurface m_eglSurface;	/** a 1x1 pbuffer or EGL_NO_SURFACE when offscreen */
+
+	/** headless Display: frames go into m_target and only on RenderFrame() */
+	bool m_bOffscreen;
+	RenderTarget* m_target;
+
+	int m_scale;				/** buffer scale of m_native */
+	int m_pendingWidth;			/** last configured size, applied by the next frame */
+	int m_pendingHeight;
+	bool m_bResizePending;
+	int m_bytesPerPixel;		/** color buffers plus depth, for the ResourceRegistry */
 	struct wl_callback* m_callback;
 
 	struct {
@@ -37,12 +83,39 @@ public:
 	} m_egl;
 
 	struct {
+		GLuint program;
 		GLuint attributePosition;
 		GLuint attributeTexCoord;
 		GLuint uniformRotation;
 		GLuint uniformTexture;
 	} m_gl;
 
+	WindowEGL::FrameStats m_stats;
+	WindowEGL::FrameStats m_lastStats;
+	uint64_t m_lastFrameStart;
+	uint64_t m_frameTime;
+
+	FrameScheduler* m_scheduler;
+	LatencyTracker* m_latency;
+	IdleScheduler* m_idle;
+
+	Renderer* m_renderer;
+	bool m_bGLES3;
+
+	FrameArena* m_arena;
+
+	PerfHUD* m_hud;
+	bool m_bHUDEnabled;
+
+	/** opaque rects of this frame, and the region last set on the surface */
+	bool m_bOpaque;
+	FrameVector<Rect> m_opaqueRects;
+	std::vector<Rect> m_opaqueRegion;
+	bool m_bOpaqueRegionSet;
+
+	Rect m_clip;
+	bool m_bClip;
+
 protected:
 	WindowEGL *m_window;
 };
@@ -54,10 +127,10 @@ static const wl_callback_listener configureListener  = {
 	&WindowEGLImpl::_ConfigureHandler
 };
 
-WindowEGL::WindowEGL(Display* display, int width, int height)
+WindowEGL::WindowEGL(Display* display, int width, int height, bool bOpaque)
 : Window(display, width, height)
 {
-	m_pImpl = new WindowEGLImpl(this);
+	m_pImpl = new WindowEGLImpl(this, bOpaque);
 
 	Resize(width, height);
 }
@@ -67,6 +140,160 @@ WindowEGL::~WindowEGL()
 	delete m_pImpl;
 }
 
+void
+WindowEGL::OnConfigure(int width, int height)
+{
+	/** a configure storm between two frames costs one resize */
+	m_pImpl->m_pendingWidth = width;
+	m_pImpl->m_pendingHeight = height;
+	m_pImpl->m_bResizePending = true;
+}
+
+
+void
+WindowEGL::SetHUDEnabled(bool enabled)
+{
+	m_pImpl->m_bHUDEnabled = enabled;
+}
+
+bool
+WindowEGL::IsHUDEnabled()
+{
+	return m_pImpl->m_bHUDEnabled;
+}
+
+void
+WindowEGL::OnInputEvent(InputType type, uint32_t time)
+{
+	m_pImpl->m_latency->AddEvent(type, time);
+}
+
+LatencyTracker*
+WindowEGL::GetLatencyTracker()
+{
+	return m_pImpl->m_latency;
+}
+
+uint64_t
+WindowEGL::GetFrameTimeNs()
+{
+	return m_pImpl->m_frameTime;
+}
+
+const WindowEGL::FrameStats&
+WindowEGL::GetFrameStats()
+{
+	return m_pImpl->m_lastStats;
+}
+
+void
+WindowEGL::CountDrawCall(unsigned int count)
+{
+	m_pImpl->m_stats.drawCalls += count;
+}
+
+int
+WindowEGL::GetPixelWidth()
+{
+	return GetWidth() * m_pImpl->m_scale;
+}
+
+int
+WindowEGL::GetPixelHeight()
+{
+	return GetHeight() * m_pImpl->m_scale;
+}
+
+bool
+WindowEGL::IsOffscreen()
+{
+	return m_pImpl->m_bOffscreen;
+}
+
+void
+WindowEGL::RenderFrame()
+{
+	if (!m_pImpl->m_bOffscreen) {
+		fprintf(stderr, "[WLToolKit] ERR: RenderFrame() is for offscreen windows, on screen frames follow the compositor\n");
+		return;
+	}
+
+	m_pImpl->DrawFrame();
+}
+
+bool
+WindowEGL::ReadPixels(void* pixels, int stride, RenderTarget::PixelFormat format)
+{
+	if (!m_pImpl->m_target)
+		return false;
+
+	return m_pImpl->m_target->ReadPixels(pixels, stride, format);
+}
+
+RenderTarget*
+WindowEGL::GetRenderTarget()
+{
+	return m_pImpl->m_target;
+}
+
+Renderer*
+WindowEGL::GetRenderer()
+{
+	return m_pImpl->m_renderer;
+}
+
+bool
+WindowEGL::IsGLES3()
+{
+	return m_pImpl->m_bGLES3;
+}
+
+FrameArena*
+WindowEGL::GetFrameArena()
+{
+	return m_pImpl->m_arena;
+}
+
+IdleScheduler*
+WindowEGL::GetIdleScheduler()
+{
+	return m_pImpl->m_idle;
+}
+
+void
+WindowEGL::AddOpaqueRect(int x, int y, int width, int height)
+{
+	m_pImpl->AddOpaqueRect(x, y, width, height);
+}
+
+void
+WindowEGL::SetClipRect(int x, int y, int width, int height)
+{
+	WindowEGLImpl::Rect clip = { x, y, width, height };
+
+	m_pImpl->m_clip = clip;
+	m_pImpl->m_bClip = true;
+
+	/** GL counts rows from the bottom, in pixels */
+	int scale = m_pImpl->m_scale;
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(x * scale, (GetHeight() - (y + height)) * scale, width * scale, height * scale);
+}
+
+void
+WindowEGL::ResetClipRect()
+{
+	m_pImpl->m_bClip = false;
+
+	glDisable(GL_SCISSOR_TEST);
+}
+
+GLuint
+WindowEGL::GetProgram()
+{
+	return m_pImpl->m_gl.program;
+}
 
 GLuint
 WindowEGL::GetVertexAttribute()
@@ -92,25 +319,67 @@ WindowEGL::GetTextureUniform()
 	return m_pImpl->m_gl.uniformTexture;
 }
 
-WindowEGLImpl::WindowEGLImpl(WindowEGL* window)
-: m_window(window), m_callback(NULL)
+WindowEGLImpl::WindowEGLImpl(WindowEGL* window, bool bOpaque)
+: m_native(NULL), m_eglSurface(EGL_NO_SURFACE), m_bOffscreen(window->GetDisplay()->IsHeadless()), m_target(NULL), m_scale(1), m_pendingWidth(0), m_pendingHeight(0), m_bResizePending(false),
+  m_bytesPerPixel(8), m_callback(NULL), m_lastFrameStart(0), m_frameTime(0), m_scheduler(NULL), m_latency(NULL), m_idle(new IdleScheduler),
+  m_renderer(NULL), m_bGLES3(false), m_arena(new FrameArena),
+  m_hud(NULL), m_bHUDEnabled(false),
+  m_bOpaque(bOpaque), m_opaqueRects(m_arena), m_bOpaqueRegionSet(false), m_bClip(false),
+  m_window(window)
 {
 	assert(m_window);
 
+	memset(&m_stats, 0, sizeof(m_stats));
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+	memset(&m_clip, 0, sizeof(m_clip));
+	memset(&m_egl, 0, sizeof(m_egl));
+
+	const char* hud = getenv("WLTK_HUD");
+	m_bHUDEnabled = hud && (hud[0] != '\0') && (hud[0] != '0');
+
+	/** comparing against the last region must not allocate per frame */
+	m_opaqueRegion.reserve(MAX_OPAQUE_RECTS);
+
 	bool ret;
 
-	ret = InitEGL();
-	assert(ret);
+	{
+		StartupTrace::Scope scope("EGL init");
+		ret = InitEGL();
+		assert(ret);
+	}
+
+	{
+		StartupTrace::Scope scope("EGL surface");
+		ret = CreateSurface();
+		assert(ret);
+	}
+
+	{
+		StartupTrace::Scope scope("GL init");
+		ret = InitGL();
+		assert(ret);
+	}
+
+	GLTrace::EnableDebugOutput(m_window->GetDisplay()->GetCapabilities());
 
-	ret = CreateSurface();
-	assert(ret);
+	m_latency = new LatencyTracker;
 
-	ret = InitGL();
-	assert(ret);
+	/** offscreen frames are drawn when asked, not paced by a compositor */
+	if (!m_bOffscreen) {
+		m_scheduler = new FrameScheduler(m_window->GetDisplay(), &WindowEGLImpl::_RenderHandler, this);
+		m_scheduler->SetPresentCallback(&WindowEGLImpl::_PresentHandler, this);
+	}
 }
 
 WindowEGLImpl::~WindowEGLImpl()
 {
+	delete m_scheduler;
+	delete m_latency;
+	delete m_idle;
+	delete m_hud;
+	delete m_renderer;
+	delete m_arena;
+
 	DestroySurface();
 	DeinitEGL();
 }
@@ -124,17 +393,210 @@ WindowEGLImpl::OnRedraw(struct wl_callback* callback, uint32_t time)
 	if (callback)
 		wl_callback_destroy(callback);
 
-	glViewport(0, 0, m_window->GetWidth(), m_window->GetHeight());
+	/** a frame callback means the previous swap reached the screen */
+	if (callback && !StartupTrace::IsFinished())
+		StartupTrace::Finish();
+
+	if (callback)
+		m_scheduler->OnFrameCallback();
+
+	/** calls DrawFrame() now, or from a timer just before the predicted deadline */
+	m_scheduler->Schedule();
+
+	/** the wait for the timer is slack of the previous frame */
+	if (m_scheduler->IsWaiting())
+		m_lastStats.idleNs += m_idle->Run(m_scheduler->GetNextFrameNs());
+}
+
+void
+WindowEGLImpl::DrawFrame()
+{
+	if (m_scheduler)
+		m_scheduler->BeginFrame();
+
+	/** drops the slot of the frame swapped kNumFrames ago */
+	m_arena->BeginFrame();
+	m_renderer->BeginFrame();
+
+	/** size and scale take effect with this frame's buffer, committed together by the swap */
+	ResizeSurface();
+
+	if (m_bClip)
+		m_window->ResetClipRect();
 
-	glClearColor(0.0, 0.0, 0.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT);
+	GLTrace::BeginFrame();
 
+	/** no-ops once startup tracing has finished */
+	int renderPhase = StartupTrace::BeginPhase("first render");
+
+	uint64_t start = Clock::NowNs();
+
+	m_stats.frame++;
+	m_stats.drawCalls = 0;
+	m_stats.intervalNs = m_lastFrameStart ? (start - m_lastFrameStart) : 0;
+	m_lastFrameStart = start;
+	m_stats.scheduleDelayNs = m_scheduler ? m_scheduler->GetLastDelayNs() : 0;
+
+	/** animations target the time the frame is shown, when it can be predicted */
+	m_frameTime = m_scheduler ? m_scheduler->GetPredictedPresentNs() : 0;
+	if (!m_frameTime)
+		m_frameTime = start;
+
+	/** Render() may have drawn into targets of its own last time */
+	if (m_target)
+		m_target->Bind();
+
+	glViewport(0, 0, m_window->GetPixelWidth(), m_window->GetPixelHeight());
+
+	/** the clear is left to the first flush, which may find it fully covered */
 	m_window->Render();
 
-	m_callback = wl_surface_frame(m_window->GetWlSurface());
-	wl_callback_add_listener(m_callback, &frameListener, this);
+	m_renderer->Flush();
+	m_stats.drawCalls += m_renderer->TakeDrawCalls();
+	m_stats.overdraw = m_renderer->TakeOverdraw();
+	m_stats.culledSprites = m_renderer->TakeCulled();
+
+	m_stats.renderNs = Clock::NowNs() - start;
+
+	StartupTrace::EndPhase(renderPhase);
+
+	if (m_bHUDEnabled) {
+		if (!m_hud) {
+			m_hud = new PerfHUD;
+			if (!m_hud->Init())
+				fprintf(stderr, "[WLToolKit] ERR: failed to initialize HUD\n");
+		}
+
+		/** the HUD shows the previous frame, swap time of this one is not known yet */
+		m_hud->AddFrame(m_lastStats, Texture::GetTotalMemory());
+		m_hud->Draw(m_window->GetWidth(), m_window->GetHeight());
+	}
+
+	if (m_bOffscreen) {
+		/** nothing is presented, ReadPixels() waits for the GPU when it needs the pixels */
+		m_stats.swapNs = 0;
+
+		m_stats.idleNs = m_idle->Run(start + OFFSCREEN_FRAME_NS);
+	} else {
+		/** double-buffered state, applied by the commit in eglSwapBuffers() */
+		UpdateOpaqueRegion();
+
+		m_callback = wl_surface_frame(m_window->GetWlSurface());
+		wl_callback_add_listener(m_callback, &frameListener, this);
+
+		int swapPhase = StartupTrace::BeginPhase("first swap");
+
+		/** input handled since the last frame is on screen once this commit is */
+		if (m_scheduler->BeginSwap(m_window->GetWlSurface(), m_stats.frame))
+			m_latency->CommitFrame(m_stats.frame);
+		else
+			m_latency->DropPending();
+
+		uint64_t swapStart = Clock::NowNs();
+		eglSwapBuffers(m_egl.dpy, m_eglSurface);
+		m_stats.swapNs = Clock::NowNs() - swapStart;
 
-	eglSwapBuffers(m_egl.dpy, m_eglSurface);
+		m_scheduler->EndFrame();
+
+		m_latency->DumpIfRequested();
+
+		StartupTrace::EndPhase(swapPhase);
+
+		/** idle work only once the frame is out, and only until the next one is due */
+		m_stats.idleNs = m_idle->Run(m_scheduler->GetNextFrameNs());
+	}
+
+	m_lastStats = m_stats;
+
+	GLTrace::EndFrame();
+}
+
+void
+WindowEGLImpl::AddOpaqueRect(int x, int y, int width, int height)
+{
+	/** the whole surface is reported anyway */
+	if (m_bOpaque)
+		return;
+
+	int left = std::max(x, 0);
+	int top = std::max(y, 0);
+	int right = std::min(x + width, m_window->GetWidth());
+	int bottom = std::min(y + height, m_window->GetHeight());
+
+	if (m_bClip) {
+		left = std::max(left, m_clip.x);
+		top = std::max(top, m_clip.y);
+		right = std::min(right, m_clip.x + m_clip.width);
+		bottom = std::min(bottom, m_clip.y + m_clip.height);
+	}
+
+	if ((right <= left) || (bottom <= top))
+		return;
+
+	/** tiles of one texture arrive row by row, join neighbours */
+	if (!m_opaqueRects.Empty()) {
+		Rect& last = m_opaqueRects[m_opaqueRects.Size() - 1];
+
+		if ((last.y == top) && (last.height == bottom - top) && (last.x + last.width == left)) {
+			last.width = right - last.x;
+			return;
+		}
+		if ((last.x == left) && (last.width == right - left) && (last.y + last.height == top)) {
+			last.height = bottom - last.y;
+			return;
+		}
+	}
+
+	Rect rect = { left, top, right - left, bottom - top };
+	m_opaqueRects.PushBack(rect);
+}
+
+static bool
+IsLargerRect(const WindowEGLImpl::Rect& a, const WindowEGLImpl::Rect& b)
+{
+	return a.width * a.height > b.width * b.height;
+}
+
+void
+WindowEGLImpl::UpdateOpaqueRegion()
+{
+	Rect whole = { 0, 0, m_window->GetWidth(), m_window->GetHeight() };
+
+	Rect* rects = &whole;
+	size_t count = 1;
+
+	if (!m_bOpaque) {
+		rects = m_opaqueRects.Data();
+		count = m_opaqueRects.Size();
+
+		if (count > MAX_OPAQUE_RECTS) {
+			std::partial_sort(rects, rects + MAX_OPAQUE_RECTS, rects + count, IsLargerRect);
+			count = MAX_OPAQUE_RECTS;
+		}
+	}
+
+	/** most frames draw the same opaque content, send nothing then */
+	if (m_bOpaqueRegionSet && (count == m_opaqueRegion.size()) &&
+		((count == 0) || (memcmp(rects, &m_opaqueRegion[0], count * sizeof(Rect)) == 0)))
+		return;
+
+	m_opaqueRegion.assign(rects, rects + count);
+	m_bOpaqueRegionSet = true;
+
+	struct wl_region* region = NULL;
+
+	if (count) {
+		region = wl_compositor_create_region(display_get_compositor(m_window->GetDisplay()->GetDisplay()));
+
+		for (size_t i = 0; i < count; i++)
+			wl_region_add(region, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+	}
+
+	/** NULL clears it */
+	wl_surface_set_opaque_region(m_window->GetWlSurface(), region);
+
+	if (region)
+		wl_region_destroy(region);
 }
 
 void
@@ -147,6 +609,26 @@ WindowEGLImpl::_RedrawHandler(void* data, struct wl_callback* callback, uint32_t
 	pImpl->OnRedraw(callback, time);
 }
 
+void
+WindowEGLImpl::_RenderHandler(void* data)
+{
+	assert(data);
+
+	WindowEGLImpl *pImpl = (WindowEGLImpl*)data;
+
+	pImpl->DrawFrame();
+}
+
+void
+WindowEGLImpl::_PresentHandler(void* data, unsigned int frame, uint64_t presentNs)
+{
+	assert(data);
+
+	WindowEGLImpl *pImpl = (WindowEGLImpl*)data;
+
+	pImpl->m_latency->OnPresented(frame, presentNs);
+}
+
 void
 WindowEGLImpl::_ConfigureHandler(void* data, struct wl_callback* callback, uint32_t time)
 {
@@ -163,108 +645,164 @@ WindowEGLImpl::_ConfigureHandler(void* data, struct wl_callback* callback, uint3
 bool
 WindowEGLImpl::InitEGL()
 {
-	static const EGLint ctx_attr[] = {
+	EGLint ctx_attr[] = {
 		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE, EGL_NONE,
 		EGL_NONE
 	};
-	static const EGLint cfg_attr[] = {
+	EGLint cfg_attr[] = {
 		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
 		EGL_RED_SIZE, 1,
 		EGL_GREEN_SIZE, 1,
 		EGL_BLUE_SIZE, 1,
 		EGL_ALPHA_SIZE, 1,
 		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_DEPTH_SIZE, 16,
 		EGL_NONE
 	};
 
-	EGLint major, minor, n;
-	EGLBoolean ret;
+	/** an opaque window has no use for destination alpha */
+	if (m_bOpaque)
+		cfg_attr[9] = 0;
 
-	m_egl.dpy = eglGetDisplay(m_window->GetDisplay()->GetWlDisplay());
-	if (!m_egl.dpy)
-		return false;
+	/** offscreen the framebuffer object has the depth buffer, the pbuffer is a placeholder */
+	if (m_bOffscreen) {
+		cfg_attr[1] = EGL_PBUFFER_BIT;
+		cfg_attr[13] = 0;
+	}
 
-	ret = eglInitialize(m_egl.dpy, &major, &minor);
-	if (ret != EGL_TRUE)
-		return false;	
+	Display* display = m_window->GetDisplay();
 
-	ret = eglBindAPI(EGL_OPENGL_ES_API);
-	if (ret != EGL_TRUE)
+	/** shared by all windows of the Display, terminated with it */
+	m_egl.dpy = display->GetEGLDisplay();
+	if (m_egl.dpy == EGL_NO_DISPLAY)
 		return false;
 
-	ret = eglChooseConfig(m_egl.dpy, cfg_attr, &(m_egl.cfg), 1, &n);
-	if (!ret)
-		return false;
-	if (n != 1)
+	/** the Display bound the API on the thread that created it */
+	if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE)
 		return false;
 
+#if defined(WLTK_HAVE_GLES3) && defined(EGL_OPENGL_ES3_BIT_KHR)
+	/** try an ES3 capable config first, WLTK_GLES=2 or disabling "gles3" forces the GLES2 path */
+	if (!display->GetCapabilities().IsDisabled(Capabilities::kGLES3)) {
+		cfg_attr[11] = EGL_OPENGL_ES3_BIT_KHR;
+
+		if (ChooseConfig(cfg_attr)) {
+			ctx_attr[1] = 3;
+			m_bGLES3 = true;
+		}
+
+		cfg_attr[11] = EGL_OPENGL_ES2_BIT;
+	}
+#endif
+
+	if (!m_bGLES3) {
+		if (!ChooseConfig(cfg_attr))
+			return false;
+	}
+
+#if defined(WLTK_ENABLE_GL_TRACE) && defined(EGL_KHR_create_context)
+	/** a debug context makes KHR_debug report more than just errors */
+	if (display->GetCapabilities().Has(Capabilities::kCreateContext)) {
+		ctx_attr[2] = EGL_CONTEXT_FLAGS_KHR;
+		ctx_attr[3] = EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+	}
+#endif
+
 	m_egl.ctx = eglCreateContext(m_egl.dpy, m_egl.cfg, EGL_NO_CONTEXT, ctx_attr);
+	if (!m_egl.ctx && m_bGLES3) {
+		/** the config claims ES3 but the driver refused the context */
+		fprintf(stderr, "[WLToolKit] ERR: cannot create a GLES3 context, falling back to GLES2\n");
+
+		cfg_attr[11] = EGL_OPENGL_ES2_BIT;
+		ctx_attr[1] = 2;
+		m_bGLES3 = false;
+
+		if (!ChooseConfig(cfg_attr))
+			return false;
+
+		m_egl.ctx = eglCreateContext(m_egl.dpy, m_egl.cfg, EGL_NO_CONTEXT, ctx_attr);
+	}
 	if (!m_egl.ctx)
 		return false;
 
 	return true;
 }
 
-void
-WindowEGLImpl::DeinitEGL()
+bool
+WindowEGLImpl::ChooseConfig(const EGLint* attr)
 {
-	eglTerminate(m_egl.dpy);
-	eglReleaseThread();
-}
+	if (ChooseConfigWith(attr))
+		return true;
 
-static const char *vert_shader_text =
-	"uniform mat4 rotation;\n"
-	"attribute vec4 pos;\n"
-	"attribute vec2 texcoord;\n"
-	"varying vec2 v_texcoord;\n"
-	"void main() {\n"
-	"  gl_Position = rotation * pos;\n"
-	"  v_texcoord = texcoord;\n"
-	"}\n";
+	/** the depth buffer only saves fill rate, do without it */
+	EGLint noDepth[32];
+	int i = 0;
 
-static const char *frag_shader_text =
-	"precision mediump float;\n"
-	"varying vec2 v_texcoord;\n"
-	"uniform sampler2D texture;\n"
-	"void main() {\n"
-	"  gl_FragColor = texture2D(texture, v_texcoord);\n"
-	"}\n";
+	for (; (attr[i] != EGL_NONE) && (i < 30); i += 2) {
+		noDepth[i] = attr[i];
+		noDepth[i + 1] = (attr[i] == EGL_DEPTH_SIZE) ? 0 : attr[i + 1];
+	}
+	noDepth[i] = EGL_NONE;
+
+	return ChooseConfigWith(noDepth);
+}
 
 bool
-WindowEGLImpl::InitGL()
+WindowEGLImpl::ChooseConfigWith(const EGLint* attr)
 {
-	GLuint frag, vert;
-	GLuint program;
-	GLint status;
+	EGLint n;
 
-	frag = CreateShader(frag_shader_text, GL_FRAGMENT_SHADER);
-	vert = CreateShader(vert_shader_text, GL_VERTEX_SHADER);
+	if (!m_bOpaque)
+		return eglChooseConfig(m_egl.dpy, attr, &(m_egl.cfg), 1, &n) && (n == 1);
 
-	program = glCreateProgram();
-	glAttachShader(program, frag);
-	glAttachShader(program, vert);
-	glLinkProgram(program);
+	/** EGL sorts the configs with alpha bits first, look for one without */
+	EGLConfig configs[64];
 
-	glGetProgramiv(program, GL_LINK_STATUS, &status);
-	if (!status) {
-		char log[1000];
-		GLsizei len;
-		glGetProgramInfoLog(program, 1000, &len, log);
-		fprintf(stderr, "Error: linking:\n%*s\n", len, log);
+	if (!eglChooseConfig(m_egl.dpy, attr, configs, 64, &n) || (n < 1))
 		return false;
+
+	m_egl.cfg = configs[0];
+
+	for (EGLint i = 0; i < n; i++) {
+		EGLint alpha;
+
+		if (eglGetConfigAttrib(m_egl.dpy, configs[i], EGL_ALPHA_SIZE, &alpha) && (alpha == 0)) {
+			m_egl.cfg = configs[i];
+			break;
+		}
 	}
 
-	glUseProgram(program);
+	return true;
+}
+
+void
+WindowEGLImpl::DeinitEGL()
+{
+	/** the EGLDisplay belongs to the Display, other windows may still use it */
+	if (m_egl.ctx)
+		eglDestroyContext(m_egl.dpy, m_egl.ctx);
+}
 
-	m_gl.attributePosition = 0;
-	m_gl.attributeTexCoord = 1;
+bool
+WindowEGLImpl::InitGL()
+{
+	/** the first context of the Display fills in the GL half */
+	m_window->GetDisplay()->GetCapabilities().ProbeGL();
 
-	glBindAttribLocation(program, m_gl.attributePosition, "pos");
-	glBindAttribLocation(program, m_gl.attributeTexCoord, "texcoord");
-	glLinkProgram(program);
+	m_renderer = new Renderer(m_arena);
 
-	m_gl.uniformRotation = glGetUniformLocation(program, "rotation");
-	m_gl.uniformTexture  = glGetUniformLocation(program, "texture");
+	if (!m_renderer->Init(m_bGLES3))
+		return false;
+
+	/** Renderer::Init() drops to GLES2 when the ES3 objects cannot be built */
+	m_bGLES3 = m_renderer->IsGLES3();
+
+	m_gl.program = m_renderer->GetProgram();
+	m_gl.attributePosition = m_renderer->GetVertexAttribute();
+	m_gl.attributeTexCoord = m_renderer->GetTexCoordAttribute();
+	m_gl.uniformRotation = m_renderer->GetRotationUniform();
+	m_gl.uniformTexture = m_renderer->GetTextureUniform();
 
 	return true;
 }
@@ -275,9 +813,29 @@ WindowEGLImpl::CreateSurface()
 	struct wl_callback *callback;
 	EGLBoolean ret;
 
-	m_native = wl_egl_window_create(m_window->GetWlSurface(), m_window->GetWidth(), m_window->GetHeight());
+	/** WLTK_BUFFER_SCALE is known now, the outputs only once the surface is shown */
+	m_scale = m_window->GetBufferScale();
+
+	if (m_bOffscreen)
+		return CreateOffscreenSurface();
+
+	m_native = wl_egl_window_create(m_window->GetWlSurface(), m_window->GetPixelWidth(), m_window->GetPixelHeight());
 	m_eglSurface = eglCreateWindowSurface(m_egl.dpy, m_egl.cfg, m_native, NULL);
 
+	if (m_scale != 1)
+		wl_surface_set_buffer_scale(m_window->GetWlSurface(), m_scale);
+
+	/** textures loaded from here on pick the matching assets */
+	Texture::SetAssetScale(m_scale);
+
+	/** the driver does not tell, assume a double buffered RGBA8888 swapchain */
+	EGLint depthSize = 0;
+	eglGetConfigAttrib(m_egl.dpy, m_egl.cfg, EGL_DEPTH_SIZE, &depthSize);
+	m_bytesPerPixel = 4 * 2 + depthSize / 8;
+
+	ResourceRegistry::Track(ResourceRegistry::kSurface, (uintptr_t)m_native,
+		m_window->GetPixelWidth() * m_window->GetPixelHeight() * m_bytesPerPixel, "WindowEGL");
+
 	ret = eglMakeCurrent(m_egl.dpy, m_eglSurface, m_eglSurface, m_egl.ctx);
 	if (ret != EGL_TRUE)
 		return false;
@@ -288,40 +846,113 @@ WindowEGLImpl::CreateSurface()
 	return true;
 }
 
-void
-WindowEGLImpl::DestroySurface()
+bool
+WindowEGLImpl::CreateOffscreenSurface()
 {
-	eglMakeCurrent(m_egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	Texture::SetAssetScale(m_scale);
+
+	/** a context needs some surface to be current on, unless EGL_KHR_surfaceless_context */
+	if (!m_window->GetDisplay()->GetCapabilities().Has(Capabilities::kSurfacelessContext)) {
+		EGLint attr[] = {
+			EGL_WIDTH, 1,
+			EGL_HEIGHT, 1,
+			EGL_NONE
+		};
+
+		m_eglSurface = eglCreatePbufferSurface(m_egl.dpy, m_egl.cfg, attr);
+		if (m_eglSurface == EGL_NO_SURFACE)
+			return false;
+	}
 
-	eglDestroySurface(m_egl.dpy, m_eglSurface);
-	wl_egl_window_destroy(m_native);
+	if (eglMakeCurrent(m_egl.dpy, m_eglSurface, m_eglSurface, m_egl.ctx) != EGL_TRUE)
+		return false;
 
-	if (m_callback)
-		wl_callback_destroy(m_callback);
+	m_target = new RenderTarget;
+
+	/** the Renderer orders opaque runs by depth when the bound framebuffer has it */
+	if (!m_target->Create(m_window->GetPixelWidth(), m_window->GetPixelHeight(), true))
+		return false;
+
+	return true;
 }
 
-GLuint
-WindowEGLImpl::CreateShader(const char *source, GLenum type)
+void
+WindowEGLImpl::ResizeSurface()
 {
-	GLuint shader;
-	GLint status;
+	int scale = m_window->GetBufferScale();
+
+	bool bScaleChanged = (scale != m_scale);
+	bool bSizeChanged = m_bResizePending &&
+		((m_pendingWidth != m_window->GetWidth()) || (m_pendingHeight != m_window->GetHeight()));
+
+	m_bResizePending = false;
 
-	shader = glCreateShader(type);
-	assert(shader != 0);
+	if (!bScaleChanged && !bSizeChanged)
+		return;
 
-	glShaderSource(shader, 1, (const char **) &source, NULL);
-	glCompileShader(shader);
+	if (bSizeChanged) {
+		m_window->m_width = m_pendingWidth;
+		m_window->m_height = m_pendingHeight;
+	}
+
+	m_scale = scale;
+
+	if (m_bOffscreen) {
+		m_target->Resize(m_window->GetPixelWidth(), m_window->GetPixelHeight());
+		m_target->Bind();
 
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	if (!status) {
-		char log[1000];
-		GLsizei len;
-		glGetShaderInfoLog(shader, 1000, &len, log);
-		fprintf(stderr, "Error: compiling %s: %*s\n", ((type == GL_VERTEX_SHADER) ? "vertex" : "fragment"), len, log);
-		exit(1);
+		if (bScaleChanged)
+			Texture::SetAssetScale(scale);
+
+		if (bSizeChanged)
+			m_window->OnResize(m_window->GetWidth(), m_window->GetHeight());
+		return;
 	}
 
-	return shader;
+	/**
+	 * Only the next buffer changes size, surface and context stay. Render at
+	 * what the panel shows, not at what the compositor would upscale.
+	 */
+	wl_egl_window_resize(m_native, m_window->GetPixelWidth(), m_window->GetPixelHeight(), 0, 0);
+
+	if (bScaleChanged) {
+		wl_surface_set_buffer_scale(m_window->GetWlSurface(), scale);
+
+		/** textures already loaded switch on their next Draw() */
+		Texture::SetAssetScale(scale);
+	}
+
+	ResourceRegistry::Resize(ResourceRegistry::kSurface, (uintptr_t)m_native,
+		m_window->GetPixelWidth() * m_window->GetPixelHeight() * m_bytesPerPixel);
+
+	if (bSizeChanged)
+		m_window->OnResize(m_window->GetWidth(), m_window->GetHeight());
+}
+
+void
+WindowEGLImpl::DestroySurface()
+{
+	if (m_bOffscreen) {
+		/** GL objects go while the context is still current */
+		delete m_target;
+		m_target = NULL;
+
+		eglMakeCurrent(m_egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+		if (m_eglSurface != EGL_NO_SURFACE)
+			eglDestroySurface(m_egl.dpy, m_eglSurface);
+		return;
+	}
+
+	eglMakeCurrent(m_egl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	ResourceRegistry::Untrack(ResourceRegistry::kSurface, (uintptr_t)m_native);
+
+	eglDestroySurface(m_egl.dpy, m_eglSurface);
+	wl_egl_window_destroy(m_native);
+
+	if (m_callback)
+		wl_callback_destroy(m_callback);
 }
 
 } // End-of-namespace WLToolKit
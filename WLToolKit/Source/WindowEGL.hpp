@@ -6,25 +6,125 @@ extern "C" {
 }
 
 #include "Window.hpp"
+#include "RenderTarget.hpp"
 
 namespace WLToolKit {
 
 class Display;
+class Renderer;
+class FrameArena;
+class LatencyTracker;
+class IdleScheduler;
 class WindowEGLImpl;
 
 class WindowEGL : public Window {
 public:
-	WindowEGL(Display* display, int width, int height);
+	struct FrameStats {
+		unsigned int frame;
+		unsigned int drawCalls;
+		uint64_t renderNs;		/** frame start to end of Render() */
+		uint64_t swapNs;		/** time blocked in eglSwapBuffers */
+		uint64_t intervalNs;	/** since the previous frame started */
+		uint64_t scheduleDelayNs;	/** render start held back by the FrameScheduler */
+		float overdraw;			/** pixels written per window pixel, see Renderer::TakeOverdraw() */
+		unsigned int culledSprites;
+		uint64_t idleNs;		/** IdleScheduler tasks run before the next frame */
+	};
+
+	/**
+	 * bOpaque promises that nothing behind the window ever shows through it:
+	 * an EGL config without alpha is preferred and the whole surface is
+	 * reported as opaque.
+	 */
+	WindowEGL(Display* display, int width, int height, bool bOpaque = false);
 	virtual ~WindowEGL();
 
+	/**
+	 * On a headless Display the window is offscreen: it renders into a
+	 * RenderTarget of GetPixelWidth() x GetPixelHeight(), and only when
+	 * RenderFrame() is called, which runs one frame with the same Render()
+	 * contract. No compositor and no GPU are needed (Mesa llvmpipe).
+	 */
+	bool IsOffscreen();
+	void RenderFrame();
+
+	/** Last offscreen frame, top row first; false for on screen windows */
+	bool ReadPixels(void* pixels, int stride, RenderTarget::PixelFormat format);
+
+	/** NULL for on screen windows */
+	RenderTarget* GetRenderTarget();
+
 	virtual void Render() {}
 
+	/**
+	 * Configure events are coalesced: the last size seen before a frame is
+	 * applied at its start with wl_egl_window_resize, keeping the EGL surface
+	 * and context, then OnResize() runs before Render().
+	 */
+	virtual void OnConfigure(int width, int height);
+
+	/** Feeds the latency tracker; overrides must call WindowEGL::OnInputEvent() */
+	virtual void OnInputEvent(InputType type, uint32_t time);
+
+	/** Input-to-present latency, filled from wp_presentation feedback */
+	LatencyTracker* GetLatencyTracker();
+
+	/** Performance HUD, also enabled by WLTK_HUD=1 */
+	void SetHUDEnabled(bool enabled);
+	bool IsHUDEnabled();
+
+	/**
+	 * Time base for animations: the predicted presentation time of the frame
+	 * being rendered when wp_presentation is available, its start otherwise.
+	 */
+	uint64_t GetFrameTimeNs();
+
+	/** Stats of the last completed frame */
+	const FrameStats& GetFrameStats();
+	void CountDrawCall(unsigned int count = 1);
+
+	/**
+	 * Size of the EGL surface: the window size times the buffer scale. All
+	 * drawing APIs take window units, GL calls made directly need pixels.
+	 */
+	int GetPixelWidth();
+	int GetPixelHeight();
+
+	/** Sprite batcher, flushed after Render() */
+	Renderer* GetRenderer();
+	bool IsGLES3();
+
+	/** Transient storage, reset at the start of every frame */
+	FrameArena* GetFrameArena();
+
+	/**
+	 * Work for the time between this window's frames, run after the swap
+	 * and while the next render start is held back. Offscreen windows give
+	 * it what RenderFrame() leaves of a 60 Hz frame.
+	 */
+	IdleScheduler* GetIdleScheduler();
+
+	/**
+	 * Window pixels covered by opaque content this frame, Texture reports its
+	 * opaque draws. The union becomes the wl_surface opaque region, updated
+	 * only when it changes, so the compositor can skip blending it and cull
+	 * what is below.
+	 */
+	void AddOpaqueRect(int x, int y, int width, int height);
+
+	/** Scissors GL drawing and the opaque rects, flush the Renderer first */
+	void SetClipRect(int x, int y, int width, int height);
+	void ResetClipRect();
+
+	GLuint GetProgram();
 	GLuint GetVertexAttribute();
 	GLuint GetTexCoordAttribute();
 	GLuint GetRotationUniform();
 	GLuint GetTextureUniform();
 
 protected:
+	friend class WindowEGLImpl;
+
 	Display* m_display;
 	WindowEGLImpl* m_pImpl;
 }; // End-of-class WindowEGL
@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include <cairo.h>
+
+#include "Source/WLToolKit.hpp"
+
+using namespace WLToolKit;
+
+/**
+ * Renders the home screen scene (background + icons) for a fixed number of
+ * frames and exits. With a GL trace build (-DWLTK_ENABLE_GL_TRACE) the
+ * per-frame GL call budgets are enforced and the exit status is non-zero
+ * when any frame exceeded them.
+ *
+ * Frames after the warmup must not allocate from the C++ heap, all
+ * transient render data comes from the window's FrameArena. Any operator new
+ * between the end of the warmup and the last frame fails the run.
+ *
+ * --offscreen renders on a headless Display, without a compositor, and
+ * --snapshot writes the last frame there as a PNG. Offscreen runs also
+ * check that a half-alpha tint on the opaque background blends over the
+ * clear and hides nothing below it, and that a TiledTexture whose atlas
+ * pages are far too small for the window still draws every visible tile.
+ *
+ *   bench [--frames N] [--warmup N] [--icons N] [--draw-budget N] [--call-budget NAME=N]
+ *         [--offscreen] [--snapshot PATH]
+ */
+
+#define MAX_ICONS	256
+
+/** every C++ allocation of the process, the toolkit library included */
+static unsigned long s_heapAllocations = 0;
+
+void *
+operator new(size_t size)
+{
+	s_heapAllocations++;
+
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void
+operator delete(void *p) throw()
+{
+	free(p);
+}
+
+class BenchWindow : public WindowEGL {
+public:
+	BenchWindow(Display *display, int width, int height, int frames, int warmup, int icons);
+	virtual ~BenchWindow();
+
+	enum Scene {
+		kSceneHome,			/** background and icons, the benchmark */
+		kSceneBackground,	/** the background alone */
+		kSceneFaded,		/** an icon under the background at half alpha */
+		kSceneTiled			/** the tiled texture set with SetTiled() */
+	};
+
+	virtual void Render();
+
+	void SetScene(Scene scene) { m_scene = scene; }
+	Texture *GetIcon() { return m_icon; }
+
+	void SetTiled(TiledTexture *tiled, int x, int y) { m_tiled = tiled; m_tiledX = x; m_tiledY = y; }
+
+	/** operator new calls from the first steady-state frame to the last one */
+	unsigned long GetSteadyStateAllocations();
+
+protected:
+	Texture *m_bg;
+	Texture *m_icon;
+
+	TiledTexture *m_tiled;
+	int m_tiledX;
+	int m_tiledY;
+
+	int m_frames;
+	int m_warmup;
+	int m_icons;
+	int m_frame;
+	Scene m_scene;
+
+	unsigned long m_allocationsAtWarmup;
+	unsigned long m_allocationsAtEnd;
+};
+
+static bool
+SetCallBudget(const char *arg)
+{
+	const char *eq = strchr(arg, '=');
+	if (!eq)
+		return false;
+
+	for (int i = 0; i < GLTrace::kNumCalls; i++) {
+		const char *name = GLTrace::GetCallName((GLTrace::Call)i);
+
+		if ((strncmp(name, arg, eq - arg) == 0) && (name[eq - arg] == '\0')) {
+			GLTrace::SetBudget((GLTrace::Call)i, atoi(eq + 1));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+WriteSnapshot(WindowEGL *window, const char *path)
+{
+	int width = window->GetPixelWidth();
+	int height = window->GetPixelHeight();
+	int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+
+	std::vector<unsigned char> pixels((size_t)stride * height);
+
+	if (!window->ReadPixels(&pixels[0], stride, RenderTarget::kBGRA))
+		return false;
+
+	cairo_surface_t *surface = cairo_image_surface_create_for_data(&pixels[0], CAIRO_FORMAT_ARGB32, width, height, stride);
+	cairo_status_t status = cairo_surface_write_to_png(surface, path);
+	cairo_surface_destroy(surface);
+
+	return status == CAIRO_STATUS_SUCCESS;
+}
+
+/** renders scene offscreen and reads it back, top row first */
+static bool
+RenderScene(BenchWindow *window, BenchWindow::Scene scene, std::vector<unsigned char> *pixels)
+{
+	pixels->resize((size_t)window->GetPixelWidth() * window->GetPixelHeight() * 4);
+
+	window->SetScene(scene);
+	window->RenderFrame();
+
+	return window->ReadPixels(&(*pixels)[0], window->GetPixelWidth() * 4, RenderTarget::kRGBA);
+}
+
+/**
+ * An opaque texture tinted to half alpha must blend: outside the icon below
+ * it the frame is the background at half brightness over the black clear,
+ * and the icon is not culled.
+ */
+static bool
+CheckFade(BenchWindow *window)
+{
+	std::vector<unsigned char> solid;
+	std::vector<unsigned char> faded;
+
+	if (!RenderScene(window, BenchWindow::kSceneBackground, &solid))
+		return false;
+	if (!RenderScene(window, BenchWindow::kSceneFaded, &faded))
+		return false;
+
+	unsigned int culled = window->GetFrameStats().culledSprites;
+	if (culled) {
+		fprintf(stderr, "bench: fade check: %u sprites culled under a translucent background\n", culled);
+		return false;
+	}
+
+	int width = window->GetPixelWidth();
+	int height = window->GetPixelHeight();
+	int scale = width / window->GetWidth();
+	int iconRight = window->GetIcon()->GetWidth() * scale;
+	int iconBottom = window->GetIcon()->GetHeight() * scale;
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			if ((x < iconRight) && (y < iconBottom))
+				continue;
+
+			size_t i = ((size_t)y * width + x) * 4;
+
+			for (int c = 0; c < 3; c++) {
+				int expected = (solid[i + c] * 128 + 127) / 255;
+
+				if (abs(faded[i + c] - expected) > 2) {
+					fprintf(stderr, "bench: fade check: pixel %d,%d is %d, expected %d\n", x, y, faded[i + c], expected);
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Atlas pages of 256 pixels hold 9 tiles of 64, the window shows over a
+ * hundred: all of them must be drawn, from the right place, on several
+ * pages. The image is a generated gradient larger than the window.
+ */
+static bool
+CheckTiles(BenchWindow *window)
+{
+	int imageWidth = window->GetWidth() + 200;
+	int imageHeight = window->GetHeight() + 200;
+	int offsetX = -37;
+	int offsetY = -53;
+
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, imageWidth, imageHeight);
+	unsigned char *data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+
+	for (int y = 0; y < imageHeight; y++) {
+		uint32_t *row = (uint32_t*)(data + (size_t)y * stride);
+
+		for (int x = 0; x < imageWidth; x++)
+			row[x] = 0xff0000ff | ((x * 255 / (imageWidth - 1)) << 16) | ((y * 255 / (imageHeight - 1)) << 8);
+	}
+
+	cairo_surface_mark_dirty(surface);
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/wltk-bench-tiles-%d.png", (int)getpid());
+
+	cairo_status_t status = cairo_surface_write_to_png(surface, path);
+	cairo_surface_destroy(surface);
+
+	if (status != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "bench: tile check: cannot write %s\n", path);
+		return false;
+	}
+
+	TiledTexture tiled;
+	tiled.SetTileSize(64);
+	tiled.SetMaxAtlasSize(256);
+	tiled.SetFormat(TextureFormat::kRGBA8888);
+
+	bool bLoaded = tiled.Load(path);
+	unlink(path);
+
+	if (!bLoaded)
+		return false;
+
+	std::vector<unsigned char> pixels;
+
+	window->SetTiled(&tiled, offsetX, offsetY);
+	bool bRendered = RenderScene(window, BenchWindow::kSceneTiled, &pixels);
+	window->SetTiled(NULL, 0, 0);
+
+	if (!bRendered)
+		return false;
+
+	if (tiled.GetAtlasPages() < 2) {
+		fprintf(stderr, "bench: tile check: %d atlas page, the check needs several\n", tiled.GetAtlasPages());
+		return false;
+	}
+
+	int width = window->GetPixelWidth();
+	int height = window->GetPixelHeight();
+	int scale = width / window->GetWidth();
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int imageX = x / scale - offsetX;
+			int imageY = y / scale - offsetY;
+			int expected[3] = { imageX * 255 / (imageWidth - 1), imageY * 255 / (imageHeight - 1), 0xff };
+
+			const unsigned char *pixel = &pixels[((size_t)y * width + x) * 4];
+
+			for (int c = 0; c < 3; c++) {
+				if (abs(pixel[c] - expected[c]) > 2) {
+					fprintf(stderr, "bench: tile check: pixel %d,%d is %d,%d,%d, expected %d,%d,%d\n", x, y,
+						pixel[0], pixel[1], pixel[2], expected[0], expected[1], expected[2]);
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+int
+main(int argc, char** argv)
+{
+	int frames = 600;
+	int warmup = 60;
+	int icons = 4;
+	bool bOffscreen = false;
+	const char *snapshot = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--offscreen") == 0)
+			bOffscreen = true;
+	}
+
+	Display *display = bOffscreen ? new Display() : new Display(&argc, argv);
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+			frames = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "--warmup") == 0) && (i + 1 < argc))
+			warmup = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "--icons") == 0) && (i + 1 < argc))
+			icons = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "--draw-budget") == 0) && (i + 1 < argc))
+			GLTrace::SetDrawCallBudget(atoi(argv[++i]));
+		else if ((strcmp(argv[i], "--call-budget") == 0) && (i + 1 < argc)) {
+			if (!SetCallBudget(argv[++i]))
+				fprintf(stderr, "bench: unknown GL call budget '%s'\n", argv[i]);
+		}
+		else if ((strcmp(argv[i], "--snapshot") == 0) && (i + 1 < argc))
+			snapshot = argv[++i];
+	}
+
+	if (frames < 1) {
+		fprintf(stderr, "bench: --frames must be at least 1\n");
+		delete display;
+		return 1;
+	}
+
+	if (icons < 0)
+		icons = 0;
+	if (icons > MAX_ICONS)
+		icons = MAX_ICONS;
+	if (warmup < 0)
+		warmup = 0;
+	if (warmup >= frames)
+		warmup = frames - 1;
+
+	if (!GLTrace::IsCompiledIn())
+		fprintf(stderr, "bench: built without WLTK_ENABLE_GL_TRACE, GL budgets are not checked\n");
+
+	BenchWindow *window = new BenchWindow(display, 800, 480, frames, warmup, icons);
+
+	if (bOffscreen) {
+		for (int i = 0; i < frames; i++)
+			window->RenderFrame();
+	} else {
+		display->Run();
+	}
+
+	int ret = 0;
+
+	if (snapshot) {
+		if (!bOffscreen) {
+			fprintf(stderr, "bench: --snapshot needs --offscreen\n");
+		} else if (!WriteSnapshot(window, snapshot)) {
+			fprintf(stderr, "bench: cannot write %s\n", snapshot);
+			ret = 1;
+		}
+	}
+
+	if (bOffscreen && !CheckFade(window))
+		ret = 1;
+
+	if (bOffscreen && !CheckTiles(window))
+		ret = 1;
+
+	window->GetFrameArena()->Dump(stderr);
+	unsigned long allocations = window->GetSteadyStateAllocations();
+
+	delete window;
+	delete display;
+
+	unsigned int overruns = GLTrace::GetBudgetOverruns();
+	if (overruns) {
+		fprintf(stderr, "bench: %u of %d frames exceeded the GL call budget\n", overruns, frames);
+		ret = 1;
+	}
+
+	if (allocations) {
+		fprintf(stderr, "bench: %lu heap allocations in %d steady-state frames\n", allocations, frames - warmup);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+BenchWindow::BenchWindow(Display* display, int width, int height, int frames, int warmup, int icons)
+: WindowEGL(display, width, height), m_tiled(NULL), m_tiledX(0), m_tiledY(0),
+  m_frames(frames), m_warmup(warmup), m_icons(icons), m_frame(0), m_scene(kSceneHome),
+  m_allocationsAtWarmup(0), m_allocationsAtEnd(0)
+{
+	m_bg = new Texture("bg.png");
+	m_icon = new Texture("icon.png");
+}
+
+BenchWindow::~BenchWindow()
+{
+	delete m_icon;
+	delete m_bg;
+}
+
+void
+BenchWindow::Render()
+{
+	if (m_scene == kSceneBackground) {
+		m_bg->Draw(this, 0, 0);
+		return;
+	}
+
+	if (m_scene == kSceneTiled) {
+		m_tiled->Draw(this, m_tiledX, m_tiledY);
+		return;
+	}
+
+	if (m_scene == kSceneFaded) {
+		m_icon->Draw(this, 0, 0);
+		m_bg->Draw(this, 0, 0, 1.0f, 0x80ffffff);
+		return;
+	}
+
+	m_bg->Draw(this, 0, 0);
+
+	/** at least one, windows narrower than an icon slot stack them */
+	int columns = std::max(GetWidth() / 100, 1);
+
+	for (int i = 0; i < m_icons; i++)
+		m_icon->Draw(this, 10 + (i % columns) * 100, 10 + (i / columns) * 100);
+
+	if (m_frame == m_warmup)
+		m_allocationsAtWarmup = s_heapAllocations;
+
+	if (++m_frame == m_frames) {
+		m_allocationsAtEnd = s_heapAllocations;
+		GetDisplay()->Exit();
+	}
+}
+
+unsigned long
+BenchWindow::GetSteadyStateAllocations()
+{
+	return m_allocationsAtEnd - m_allocationsAtWarmup;
+}
@@ -184,6 +184,10 @@ egl_window_set_shader(struct egl_window *self, const char *vertex, const char *f
 	glAttachShader(program, vert);
 	glLinkProgram(program);
 
+	/* アタッチ中のシェーダは削除予約されるだけなので、後の再リンクにも使える */
+	glDeleteShader(frag);
+	glDeleteShader(vert);
+
 	glGetProgramiv(program, GL_LINK_STATUS, &status);
 	if (!status) {
 		char log[1000];
@@ -58,7 +58,7 @@ struct surface {
 	int width, height, stride, format;
 };
 
-struct surface *surface;
+GLuint texture;
 GLuint program;
 GLuint pos, texcoord, rotation_uniform, texture_uniform;
 
@@ -85,21 +85,10 @@ static void redraw_handler(void *arg)
 		0, 0, 1, 0,
 		0, 0, 0, 1
 	};
-	GLuint texture;
-	struct surface *surface;
 
-	glGenTextures(1, &texture);
+	/* テクスチャはmain()で一度だけ作成する */
 	glBindTexture(GL_TEXTURE_2D, texture);
 
-	surface = load_surface("test.png");
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->width, surface->height,
-		0, GL_RGBA, GL_UNSIGNED_BYTE, surface->data);
-
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 	glUniformMatrix4fv(rotation_uniform, 1, GL_FALSE, (GLfloat *) rotation);
 
 	glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, verts);
@@ -120,6 +109,7 @@ main(int argc, char **argv)
 {
 	struct display *display;
 	struct egl_window *egl_window;
+	struct surface *surface;
 
 	display = display_create(&argc, argv);
 	assert(display);
@@ -127,8 +117,6 @@ main(int argc, char **argv)
 	egl_window = egl_window_create(display, 800, 480);
 	assert(egl_window);
 
-	surface = load_surface("test.png");
-
 	egl_window_set_redraw_handler(egl_window, &redraw_handler, NULL);
 	program = egl_window_set_shader(egl_window, vert_shader_text, frag_shader_text);
 
@@ -142,11 +130,28 @@ main(int argc, char **argv)
 	rotation_uniform = glGetUniformLocation(program, "rotation");
 	texture_uniform  = glGetUniformLocation(program, "texture");
 
+	/* 描画のたびにPNGをデコードしないよう、ここで一度だけアップロードする */
+	surface = load_surface("test.png");
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->width, surface->height,
+		0, GL_RGBA, GL_UNSIGNED_BYTE, surface->data);
+
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	release_surface(surface);
+
 	window_schedule_resize(egl_window->window, 800, 480);
 
 	display_run(display);
 
-	release_surface(surface);
+	glDeleteTextures(1, &texture);
+	glDeleteProgram(program);
 
 	egl_window_destroy(egl_window);
 
@@ -164,7 +169,7 @@ struct surface *load_surface(char *path)
 	s = (struct surface *)malloc(sizeof *s);
 	memset(s, 0, sizeof *s);
 
-	s->cairo_surface = cairo_image_surface_create_from_png("test.png");
+	s->cairo_surface = cairo_image_surface_create_from_png(path);
 	s->width = cairo_image_surface_get_width(s->cairo_surface);
 	s->height = cairo_image_surface_get_height(s->cairo_surface);
 	s->stride = cairo_image_surface_get_stride(s->cairo_surface);
@@ -196,6 +201,7 @@ void release_surface(struct surface *s)
 {
 	cairo_surface_destroy(s->cairo_surface);
 
+	free(s->data);
 	free(s);
 }
 